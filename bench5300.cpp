@@ -0,0 +1,606 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+//
+// bench5300 - throughput benchmarks for the storage engine.
+// Usage: ./bench5300 dbenvpath benchmark [rows]
+
+#include "db_cxx.h"
+#include "heap_storage.h"
+#include "buffer_pool.h"
+#include "btree.h"
+#include "hash_index.h"
+#include "filter_kernels.h"
+#include "thread_pool.h"
+#include "transaction.h"
+#include "executor.h"
+#include "vector_executor.h"
+#include "hash_join.h"
+#include "external_sort.h"
+#include "hash_aggregate.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+DbEnv *_DB_ENV;
+BufferPool *_BUFFER_POOL;
+TransactionManager *_TXN_MANAGER;
+
+// rows are inserted in batches of this many
+const uint BATCH_ROWS = 10000;
+
+// Seconds elapsed since start
+static double since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Fill table with rows of the _test_data_cpp shape: (a INT, b TEXT)
+static void load(HeapTable &table, uint rows) {
+  ValueDicts batch;
+  for (uint i = 0; i < rows; i++) {
+    ValueDict row;
+    row["a"] = Value((int32_t) i);
+    row["b"] = Value("row number " + to_string(i));
+    batch.push_back(row);
+    if (batch.size() == BATCH_ROWS || i + 1 == rows) {
+      delete table.insert_batch(&batch);
+      batch.clear();
+    }
+  }
+}
+
+// Count rows through a full cursor scan
+static uint scan(HeapTable &table) {
+  HandleCursor *rows = table.cursor();
+  Handle handle;
+  uint count = 0;
+  while (rows->next(handle))
+    count++;
+  delete rows;
+  return count;
+}
+
+// Insert and scan throughput for each block size a table can be created with
+static void bench_block_sizes(uint rows) {
+  ColumnNames column_names = {"a", "b"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+
+  cout << setw(10) << "block" << setw(16) << "insert rows/s" << setw(16) << "scan rows/s" << endl;
+  for (uint block_sz: {4096u, 8192u, 16384u, 65536u}) {
+    HeapTable table("_bench_block_" + to_string(block_sz), column_names, column_attributes, block_sz);
+    table.create();
+
+    auto start = chrono::steady_clock::now();
+    load(table, rows);
+    double insert_secs = since(start);
+
+    // close so the scan starts from the file rather than from our frames
+    table.close();
+    table.open();
+    start = chrono::steady_clock::now();
+    uint count = scan(table);
+    double scan_secs = since(start);
+    if (count != rows)
+      cerr << "scan found " << count << " rows, expected " << rows << endl;
+
+    cout << setw(10) << block_sz << setw(16) << (uint) (rows / insert_secs)
+         << setw(16) << (uint) (rows / scan_secs) << endl;
+    table.drop();
+  }
+}
+
+// Loading rows one insert() at a time versus insert_batch() in batches of BATCH_ROWS,
+// the same ValueDicts both ways (built before the clock starts)
+static void bench_insert(uint rows) {
+  ColumnNames column_names = {"a", "b"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+  ValueDicts all;
+  for (uint i = 0; i < rows; i++) {
+    ValueDict row;
+    row["a"] = Value((int32_t) i);
+    row["b"] = Value("row number " + to_string(i));
+    all.push_back(row);
+  }
+
+  cout << setw(14) << "method" << setw(16) << "insert rows/s" << setw(10) << "speedup" << endl;
+  double one_at_a_time = 0;
+  for (string method: {"insert", "insert_batch"}) {
+    HeapTable table("_bench_insert", column_names, column_attributes);
+    table.create();
+    auto start = chrono::steady_clock::now();
+    if (method == "insert") {
+      for (auto const& row: all)
+        table.insert(&row);
+    } else {
+      for (uint i = 0; i < rows; i += BATCH_ROWS) {
+        ValueDicts batch(all.begin() + i, all.begin() + min(rows, i + BATCH_ROWS));
+        delete table.insert_batch(&batch);
+      }
+    }
+    // the rows count as loaded once they are in the file, not just in our frames
+    table.close();
+    double secs = since(start);
+    if (method == "insert")
+      one_at_a_time = secs;
+    table.open();
+    uint count = scan(table);
+    if (count != rows)
+      cerr << method << " loaded " << count << " rows, expected " << rows << endl;
+
+    cout << setw(14) << method << setw(16) << (u_int64_t) (rows / secs)
+         << setw(10) << setprecision(3) << one_at_a_time / secs << endl;
+    table.drop();
+  }
+}
+
+// INT filter over one full page: record at a time through the codec versus each
+// filter kernel this CPU supports. rows is the number of record tests per variant.
+static void bench_filter(uint rows) {
+  ColumnNames column_names = {"a", "b"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+  RowCodec codec(column_names, column_attributes);
+
+  vector<char> bytes(DbBlock::BLOCK_SZ);
+  Dbt block(bytes.data(), (u_int32_t) bytes.size());
+  SlottedPage page(block, 1, true);
+  char record[DbBlock::BLOCK_SZ];
+  for (int32_t i = 0; ; i++) {
+    Row row(2);
+    string b = "r" + to_string(i);
+    row.set_int(0, i);
+    row.set_text(1, b.data(), (u_int32_t) b.size());
+    Dbt data(record, codec.encode(row, record, sizeof(record)));
+    if (page.free_space() < data.get_size())
+      break;
+    page.add(&data);
+  }
+  u_int32_t num_records = page.get_num_records();
+  uint passes = rows / num_records + 1;
+  int32_t value = (int32_t) num_records / 2;  // about half the records qualify
+  vector<u_int64_t> bitmap((num_records + 63) / 64);
+
+  cout << num_records << " records/page, a < " << value << endl;
+  cout << setw(16) << "kernel" << setw(16) << "rows/s" << setw(10) << "hits" << endl;
+
+  auto start = chrono::steady_clock::now();
+  uint hits = 0;
+  for (uint pass = 0; pass < passes; pass++) {
+    hits = 0;
+    RecordView view;
+    for (RecordID id = 1; id <= num_records; id++)
+      if (page.view(id, view) && codec.get_int(view, 0) < value)
+        hits++;
+  }
+  double secs = since(start);
+  cout << setw(16) << "record-at-a-time" << setw(16) << (u_int64_t) (passes * num_records / secs) << setw(10) << hits << endl;
+
+  for (string isa: {"scalar", "sse4.2", "avx2"}) {
+    IntFilterKernel kernel = int_filter_kernel(isa);
+    if (kernel == nullptr) {
+      cout << setw(16) << isa << setw(16) << "unsupported" << endl;
+      continue;
+    }
+    start = chrono::steady_clock::now();
+    for (uint pass = 0; pass < passes; pass++) {
+      fill(bitmap.begin(), bitmap.end(), ~(u_int64_t) 0);
+      kernel((const char *) page.get_data(), num_records, codec.get_offset(0), Comparison::LT, value, bitmap.data());
+    }
+    secs = since(start);
+    hits = 0;
+    for (auto word: bitmap)
+      hits += __builtin_popcountll(word);
+    cout << setw(16) << isa << setw(16) << (u_int64_t) (passes * num_records / secs) << setw(10) << hits << endl;
+  }
+}
+
+// Parallel filtered scan of a table held entirely in the buffer pool, for 1, 2, 4, ...
+// worker threads up to the number of hardware threads.
+static void bench_parallel(uint rows) {
+  ColumnNames column_names = {"a", "b"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+
+  // enough frames for the whole table, so the scans measure CPU rather than reads
+  BufferPool *file_pool = _BUFFER_POOL;
+  BufferPool cached(rows / 100 + 64);
+  _BUFFER_POOL = &cached;
+  {
+    HeapTable table("_bench_parallel", column_names, column_attributes);
+    table.create();
+    load(table, rows);
+    Comparisons where = {Comparison("a", Comparison::LT, Value((int32_t) rows / 10))};
+    delete table.select(&where);  // warm the pool
+
+    uint max_threads = thread::hardware_concurrency();
+    cout << setw(10) << "threads" << setw(16) << "scan rows/s" << setw(10) << "speedup" << endl;
+    double one = 0;
+    for (uint threads = 1; threads <= max(1u, max_threads); threads *= 2) {
+      ThreadPool pool(threads);
+      auto start = chrono::steady_clock::now();
+      Handles *handles = table.select(&where, pool, false);
+      double secs = since(start);
+      if (handles->size() != rows / 10)
+        cerr << "scan found " << handles->size() << " rows, expected " << rows / 10 << endl;
+      delete handles;
+      if (threads == 1)
+        one = secs;
+      cout << setw(10) << threads << setw(16) << (u_int64_t) (rows / secs) << setw(10) << setprecision(3) << one / secs << endl;
+    }
+    table.drop();
+  }
+  _BUFFER_POOL = file_pool;
+}
+
+// SELECT COUNT(*), MAX(a) FROM t WHERE a < rows / 2 over a table held in the buffer
+// pool: a tuple at a time through a cursor, through the row executor, and on column
+// vectors (filtering in a VectorFilter, then with the filter pushed into the scan).
+static void bench_vector(uint rows) {
+  ColumnNames column_names = {"a", "b"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+
+  BufferPool *file_pool = _BUFFER_POOL;
+  BufferPool cached(rows / 100 + 64);
+  _BUFFER_POOL = &cached;
+  {
+    HeapTable table("_bench_vector", column_names, column_attributes);
+    table.create();
+    load(table, rows);
+    int32_t value = (int32_t) rows / 2;
+    scan(table);  // warm the pool
+
+    cout << setw(18) << "engine" << setw(16) << "rows/s" << setw(10) << "speedup" << setw(10) << "count"
+         << setw(10) << "max" << endl;
+    double tuple_secs = 0;
+    auto report = [&](const string &engine, double secs, int32_t count, int32_t max) {
+      if (tuple_secs == 0)
+        tuple_secs = secs;
+      cout << setw(18) << engine << setw(16) << (u_int64_t) (rows / secs) << setw(10) << setprecision(3)
+           << tuple_secs / secs << setw(10) << count << setw(10) << max << endl;
+    };
+
+    // tuple at a time: a handle per row, each row decoded and tested on its own
+    auto start = chrono::steady_clock::now();
+    int32_t count = 0, max = INT32_MIN;
+    HeapTableCursor *cursor = table.cursor();
+    Handle handle;
+    Row row;
+    while (cursor->next(handle)) {
+      table.project(handle, row);
+      if (row[0].n < value) {
+        count++;
+        max = std::max(max, row[0].n);
+      }
+    }
+    delete cursor;
+    report("tuple-at-a-time", since(start), count, max);
+
+    // row executor: batches of Rows through a Filter expression
+    start = chrono::steady_clock::now();
+    count = 0;
+    max = INT32_MIN;
+    QueryOperator *plan = new Filter(new TableScan(table),
+                                     Expression::compare(Comparison::LT, Expression::column(0, ColumnAttribute::INT),
+                                                         Expression::constant(Value(value))));
+    RowBatch batch;
+    plan->open();
+    while (plan->next(batch)) {
+      for (uint i = 0; i < batch.size(); i++)
+        max = std::max(max, batch[i][0].n);
+      count += batch.size();
+    }
+    plan->close();
+    delete plan;
+    report("row batches", since(start), count, max);
+
+    // vectorized: only column a is decoded
+    for (bool pushed: {false, true}) {
+      start = chrono::steady_clock::now();
+      VectorOperator *input;
+      if (pushed)
+        input = new VectorScan(table, {0}, {Comparison("a", Comparison::LT, Value(value))});
+      else
+        input = new VectorFilter(new VectorScan(table, {0}), {VectorComparison(0, Comparison::LT, Value(value))});
+      VectorAggregate aggregate(input, {{VectorAggregate::COUNT, -1}, {VectorAggregate::MAX, 0}}, {"count", "max"});
+      ColumnBatch result;
+      aggregate.open();
+      aggregate.next(result);
+      aggregate.close();
+      report(pushed ? "vector, pushed" : "vector", since(start), result.column(0).ints[0], result.column(1).ints[0]);
+    }
+    table.drop();
+  }
+  _BUFFER_POOL = file_pool;
+}
+
+// Join two tables of rows rows each on a = a: all in memory, then with a budget
+// small enough that both sides go through the spill partitions.
+static void bench_join(uint rows) {
+  ColumnNames column_names = {"a", "b"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+  HeapTable left("_bench_join_left", column_names, column_attributes);
+  HeapTable right("_bench_join_right", column_names, column_attributes);
+  left.create();
+  right.create();
+  load(left, rows);
+  load(right, rows);
+
+  cout << setw(12) << "budget" << setw(12) << "partitions" << setw(16) << "rows/s" << setw(12) << "matches" << endl;
+  for (size_t budget: {HashJoin::MEMORY_BUDGET * 16, (size_t) 1024 * 1024}) {
+    auto start = chrono::steady_clock::now();
+    HashJoin join(new TableScan(left), new TableScan(right), {0}, {0}, false, budget);
+    RowBatch batch;
+    u_int64_t matches = 0;
+    join.open();
+    while (join.next(batch))
+      matches += batch.size();
+    uint partitions = join.get_partitions();
+    join.close();
+    double secs = since(start);
+    cout << setw(12) << budget << setw(12) << partitions << setw(16) << (u_int64_t) (2.0 * rows / secs)
+         << setw(12) << matches << endl;
+  }
+  left.drop();
+  right.drop();
+}
+
+// ORDER BY an INT column (descending) and a TEXT column, in memory and with a budget small
+// enough that the sort writes runs and merges them
+static void bench_sort(uint rows) {
+  ColumnNames column_names = {"a", "b"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+  HeapTable table("_bench_sort", column_names, column_attributes);
+  table.create();
+  load(table, rows);
+
+  cout << setw(8) << "key" << setw(12) << "budget" << setw(8) << "runs" << setw(14) << "spilled" << setw(16) << "rows/s"
+       << endl;
+  for (uint column: {0, 1}) {
+    for (size_t budget: {ExternalSort::MEMORY_BUDGET * 16, (size_t) 4 * 1024 * 1024}) {
+      auto start = chrono::steady_clock::now();
+      ExternalSort sort(new TableScan(table), SortKeys{{column, column == 0}}, budget);
+      RowBatch batch;
+      u_int64_t count = 0;
+      sort.open();
+      while (sort.next(batch))
+        count += batch.size();
+      uint runs = sort.get_runs();
+      u_int64_t spilled = sort.get_spill_bytes();
+      sort.close();
+      double secs = since(start);
+      if (count != rows)
+        cerr << "sorted " << count << " rows, expected " << rows << endl;
+      cout << setw(8) << column_names[column] << setw(12) << budget << setw(8) << runs << setw(14) << spilled
+           << setw(16) << (u_int64_t) (rows / secs) << endl;
+    }
+  }
+  table.drop();
+}
+
+// ORDER BY a DESC LIMIT n for growing n: a TopN holding n rows versus sorting them all
+static void bench_topn(uint rows) {
+  ColumnNames column_names = {"a", "b"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+  HeapTable table("_bench_topn", column_names, column_attributes);
+  table.create();
+  load(table, rows);
+
+  cout << setw(10) << "limit" << setw(16) << "top n rows/s" << setw(16) << "sort rows/s" << endl;
+  for (u_int64_t limit: {1, 10, 100, 10000}) {
+    double secs[2];
+    for (uint use_sort = 0; use_sort < 2; use_sort++) {
+      auto start = chrono::steady_clock::now();
+      QueryOperator *plan = new TableScan(table);
+      if (use_sort)
+        plan = new Limit(new ExternalSort(plan, SortKeys{{0, true}}), limit);
+      else
+        plan = new Limit(new TopN(plan, SortKeys{{0, true}}, limit), limit);
+      RowBatch batch;
+      u_int64_t count = 0;
+      plan->open();
+      while (plan->next(batch))
+        count += batch.size();
+      plan->close();
+      delete plan;
+      secs[use_sort] = since(start);
+      if (count != min<u_int64_t>(limit, rows))
+        cerr << "got " << count << " rows, expected " << min<u_int64_t>(limit, rows) << endl;
+    }
+    cout << setw(10) << limit << setw(16) << (u_int64_t) (rows / secs[0]) << setw(16) << (u_int64_t) (rows / secs[1])
+         << endl;
+  }
+  table.drop();
+}
+
+// SELECT g, COUNT(*), SUM(v) FROM t GROUP BY g for few and for many groups, with more
+// and more workers, and then with a budget small enough that the groups spill
+static void bench_group(uint rows) {
+  ColumnNames column_names = {"g", "v"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::INT)};
+  HashAggregate::Aggregates aggregates = {{VectorAggregate::COUNT, -1}, {VectorAggregate::SUM, 1}};
+  ColumnNames names = {"g", "count", "sum"};
+  uint max_threads = max(1u, thread::hardware_concurrency());
+
+  cout << setw(10) << "groups" << setw(10) << "threads" << setw(12) << "budget" << setw(12) << "partitions"
+       << setw(16) << "rows/s" << endl;
+  for (uint num_groups: {16u, rows / 10}) {
+    HeapTable table("_bench_group", column_names, column_attributes);
+    table.create();
+    ValueDicts batch;
+    for (uint i = 0; i < rows; i++) {
+      ValueDict row;
+      row["g"] = Value((int32_t) ((i * 7919u) % num_groups));
+      row["v"] = Value((int32_t) (i % 100));
+      batch.push_back(row);
+      if (batch.size() == BATCH_ROWS || i + 1 == rows) {
+        delete table.insert_batch(&batch);
+        batch.clear();
+      }
+    }
+
+    auto run = [&](uint threads, size_t budget) {
+      auto start = chrono::steady_clock::now();
+      HashAggregate aggregate(table, Comparisons(), {0}, aggregates, names, threads, budget);
+      RowBatch out;
+      u_int64_t groups = 0;
+      aggregate.open();
+      while (aggregate.next(out))
+        groups += out.size();
+      uint partitions = aggregate.get_partitions();
+      aggregate.close();
+      double secs = since(start);
+      if (groups != num_groups)
+        cerr << "found " << groups << " groups, expected " << num_groups << endl;
+      cout << setw(10) << num_groups << setw(10) << threads << setw(12) << budget << setw(12) << partitions
+           << setw(16) << (u_int64_t) (rows / secs) << endl;
+    };
+    for (uint threads = 1; threads <= max_threads; threads *= 2)
+      run(threads, HashAggregate::MEMORY_BUDGET);
+    run(max_threads, 1024 * 1024);
+    table.drop();
+  }
+}
+
+// Equality select(where) on a unique INT column: full scan, B+tree, then hash index.
+// Blocks per lookup are buffer pool gets (hits plus misses) per select.
+static void bench_lookup(uint rows) {
+  ColumnNames column_names = {"a", "b"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+  HeapTable table("_bench_lookup", column_names, column_attributes);
+  table.create();
+  load(table, rows);
+  BTreeIndex btree(table, "btree", ColumnNames{"a"}, true);
+  btree.create();
+  HashIndex hash(table, "hash", ColumnNames{"a"}, true);
+  hash.create();
+  cout << "hash index: " << hash.get_num_buckets() << " buckets, b+tree height " << btree.get_height() << endl;
+
+  cout << setw(10) << "access" << setw(16) << "lookups/s" << setw(16) << "blocks/lookup" << endl;
+  for (string access: {"scan", "btree", "hash"}) {
+    if (access == "btree")
+      table.add_index(&btree);
+    if (access == "hash")
+      table.add_index(&hash);
+    uint lookups = access == "scan" ? 20 : 100000;
+    u_int64_t gets = _BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses();
+    auto start = chrono::steady_clock::now();
+    for (uint i = 0; i < lookups; i++) {
+      ValueDict where;
+      where["a"] = Value((int32_t) ((i * 7919u) % rows));
+      Handles *handles = table.select(&where);
+      if (handles->size() != 1)
+        cerr << access << " found " << handles->size() << " rows, expected 1" << endl;
+      delete handles;
+    }
+    double secs = since(start);
+    gets = _BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses() - gets;
+    cout << setw(10) << access << setw(16) << (u_int64_t) (lookups / secs)
+         << setw(16) << setprecision(3) << (double) gets / lookups << endl;
+  }
+  table.remove_index(&hash);
+  table.remove_index(&btree);
+  hash.drop();
+  btree.drop();
+  table.drop();
+}
+
+// Single-row insert transactions from 1, 4, and 16 threads (each with its own table),
+// syncing each commit versus group commit with and without a commit delay.
+// rows is the number of commits per run.
+static void bench_commit(uint rows) {
+  ColumnNames column_names = {"a", "b"};
+  ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+  struct Mode {
+    string name;
+    chrono::microseconds commit_delay;
+    uint max_batch;
+  };
+  vector<Mode> modes = {{"sync", chrono::microseconds(0), 0},
+                        {"group", chrono::microseconds(0), 64},
+                        {"group+200us", chrono::microseconds(200), 64}};
+
+  cout << setw(14) << "mode" << setw(10) << "threads" << setw(16) << "commits/s" << setw(16) << "commits/flush" << endl;
+  for (auto const& mode: modes) {
+    for (uint threads: {1u, 4u, 16u}) {
+      TransactionManager manager(*_DB_ENV, mode.commit_delay, mode.max_batch);
+      _TXN_MANAGER = &manager;
+      vector<thread> committers;
+      auto start = chrono::steady_clock::now();
+      for (uint t = 0; t < threads; t++) {
+        committers.push_back(thread([&, t] {
+          HeapTable table("_bench_commit_" + to_string(t), column_names, column_attributes);
+          table.create();
+          Row row(2);
+          for (uint i = t; i < rows; i += threads) {
+            string b = "row number " + to_string(i);
+            row.set_int(0, (int32_t) i);
+            row.set_text(1, b.data(), (u_int32_t) b.size());
+            manager.begin();
+            table.insert(row);
+            manager.commit();
+          }
+          table.drop();
+        }));
+      }
+      for (auto &committer: committers)
+        committer.join();
+      double secs = since(start);
+      cout << setw(14) << mode.name << setw(10) << threads << setw(16) << (u_int64_t) (rows / secs)
+           << setw(16) << setprecision(3) << (double) manager.get_commits() / manager.get_flushes() << endl;
+      _TXN_MANAGER = nullptr;
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3 && argc != 4) {
+    cerr << "Usage: ./bench5300 dbenvpath benchmark [rows]" << endl;
+    cerr << "benchmarks: blocksize insert filter parallel vector join sort topn group lookup commit" << endl;
+    return 1;
+  }
+  string benchmark = argv[2];
+  uint rows = argc == 4 ? (uint) atoi(argv[3]) : 1000000;
+
+  DbEnv env(0U);
+  env.set_message_stream(&cout);
+  env.set_error_stream(&cerr);
+  // only the commit benchmark pays for logging
+  u_int32_t txn_flags = benchmark == "commit" ? TransactionManager::ENV_FLAGS : 0;
+  env.open(argv[1], DB_CREATE | DB_INIT_MPOOL | DB_THREAD | txn_flags, 0);
+  _DB_ENV = &env;
+  BufferPool buffer_pool;
+  _BUFFER_POOL = &buffer_pool;
+
+  if (benchmark == "blocksize") {
+    bench_block_sizes(rows);
+  } else if (benchmark == "insert") {
+    bench_insert(rows);
+  } else if (benchmark == "filter") {
+    bench_filter(rows);
+  } else if (benchmark == "parallel") {
+    bench_parallel(rows);
+  } else if (benchmark == "vector") {
+    bench_vector(rows);
+  } else if (benchmark == "join") {
+    bench_join(rows);
+  } else if (benchmark == "sort") {
+    bench_sort(rows);
+  } else if (benchmark == "topn") {
+    bench_topn(rows);
+  } else if (benchmark == "group") {
+    bench_group(rows);
+  } else if (benchmark == "lookup") {
+    bench_lookup(rows);
+  } else if (benchmark == "commit") {
+    bench_commit(rows);
+  } else {
+    cerr << "unknown benchmark " << benchmark << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,500 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "btree.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// BTREE NODE code
+//
+// Node record:
+//      u8 leaf, u8 key columns, u32 link, u32 count, then count entries of
+//      [u32 child (interior only)] u32 block id, u16 record id, key
+// Key: see RowCodec::encode_key.
+
+static const u_int32_t NODE_HEADER_SZ = 1 + 1 + 4 + 4;
+static const u_int32_t HANDLE_SZ = 4 + 2;
+
+template<typename T>
+static void put_at(char *&at, T n) {
+  memcpy(at, &n, sizeof(n));
+  at += sizeof(n);
+}
+
+template<typename T>
+static T get_at(const char *&at) {
+  T n;
+  memcpy(&n, at, sizeof(n));
+  at += sizeof(n);
+  return n;
+}
+
+int BTreeNode::compare(const KeyValue &a, const KeyValue &b) {
+  for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+    if (a[i].data_type == ColumnAttribute::DataType::INT) {
+      if (a[i].n != b[i].n)
+        return a[i].n < b[i].n ? -1 : 1;
+    } else {
+      int cmp = a[i].s.compare(b[i].s);
+      if (cmp != 0)
+        return cmp;
+    }
+  }
+  return (int) a.size() - (int) b.size();
+}
+
+int BTreeNode::compare(const KeyValue &a_key, Handle a_handle, const KeyValue &b_key, Handle b_handle) {
+  int cmp = compare(a_key, b_key);
+  if (cmp != 0)
+    return cmp;
+  return a_handle < b_handle ? -1 : (b_handle < a_handle ? 1 : 0);
+}
+
+// number of boundaries at or below (key, handle)
+uint BTreeNode::child_index(const KeyValue &key, Handle handle) const {
+  uint low = 0;
+  uint high = (uint) this->entries.size();
+  while (low < high) {
+    uint mid = (low + high) / 2;
+    if (compare(this->entries[mid].key, this->entries[mid].handle, key, handle) <= 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+u_int32_t BTreeNode::encoded_size() const {
+  u_int32_t size = NODE_HEADER_SZ;
+  for (auto const& entry: this->entries)
+    size += (this->leaf ? 0 : 4) + HANDLE_SZ + RowCodec::key_size(entry.key);
+  return size;
+}
+
+void BTreeNode::encode(char *bytes) const {
+  char *at = bytes;
+  put_at<u_int8_t>(at, this->leaf ? 1 : 0);
+  put_at<u_int8_t>(at, (u_int8_t) (this->entries.empty() ? 0 : this->entries[0].key.size()));
+  put_at<u_int32_t>(at, this->link);
+  put_at<u_int32_t>(at, (u_int32_t) this->entries.size());
+  for (auto const& entry: this->entries) {
+    if (!this->leaf)
+      put_at<u_int32_t>(at, entry.child);
+    put_at<u_int32_t>(at, entry.handle.first);
+    put_at<u_int16_t>(at, entry.handle.second);
+    RowCodec::encode_key(entry.key, at);
+  }
+}
+
+void BTreeNode::decode(const RecordView &record) {
+  const char *at = record.data;
+  this->leaf = get_at<u_int8_t>(at) != 0;
+  u_int8_t num_columns = get_at<u_int8_t>(at);
+  this->link = get_at<u_int32_t>(at);
+  u_int32_t count = get_at<u_int32_t>(at);
+  this->entries.clear();
+  this->entries.resize(count);
+  for (auto &entry: this->entries) {
+    entry.child = this->leaf ? 0 : get_at<u_int32_t>(at);
+    entry.handle.first = get_at<u_int32_t>(at);
+    entry.handle.second = get_at<u_int16_t>(at);
+    RowCodec::decode_key(at, num_columns, entry.key);
+  }
+}
+
+
+// BTREE INDEX code
+
+BTreeIndex::BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique)
+        : DbIndex(relation, name, key_columns, unique), file(relation.get_table_name() + "-" + name), closed(true), root(0), height(0), generation(0)
+{
+  if (key_columns.empty() || key_columns.size() > DbIndex::MAX_COMPOSITE) {
+    throw DbRelationError("index " + name + " needs 1 to 32 key columns");
+  }
+}
+
+BTreeIndex::~BTreeIndex() {
+  close();
+}
+
+void BTreeIndex::create() {
+  this->file.create();  // makes block 1, which holds the tree's stats
+  this->closed = false;
+  BTreeNode leaf(true, new_block());
+  save(leaf);
+  this->root = leaf.block_id;
+  this->height = 1;
+  save_stat();
+
+  // index the rows already in the relation
+  Handles *handles = this->relation.select();
+  try
+    {
+      for (auto const& handle: *handles)
+        insert(handle);
+    }
+  catch(...)
+    {
+      delete handles;
+      throw;
+    }
+  delete handles;
+}
+
+void BTreeIndex::drop() {
+  this->file.drop();
+  this->closed = true;
+}
+
+void BTreeIndex::open() {
+  if (!this->closed && this->generation == this->file.get_generation())
+    return;
+  if (this->closed)
+    this->file.open();
+  SlottedPage *block = this->file.get(STAT);
+  RecordView record;
+  if (!block->view(1, record) || record.size < 2 * sizeof(u_int32_t)) {
+    this->file.release(block);
+    throw DbRelationError("index " + this->name + " has no root");
+  }
+  u_int32_t stat[2];
+  memcpy(stat, record.data, sizeof(stat));
+  this->file.release(block);
+  this->root = stat[0];
+  this->height = stat[1];
+  this->generation = this->file.get_generation();
+  this->closed = false;
+}
+
+void BTreeIndex::close() {
+  if (this->closed)
+    return;
+  this->file.close();
+  this->closed = true;
+}
+
+Handles* BTreeIndex::lookup(const ValueDict *key_values) {
+  return range(key_values, key_values);
+}
+
+Handles* BTreeIndex::range(const ValueDict *min_key, const ValueDict *max_key) {
+  open();
+  KeyValue min_value;
+  KeyValue max_value;
+  if (min_key != nullptr)
+    min_value = tkey(min_key);
+  if (max_key != nullptr)
+    max_value = tkey(max_key);
+
+  // (key, 0:0) is below every real entry with that key, so this finds the first one
+  BlockID leaf_id = find_leaf(min_key == nullptr ? nullptr : &min_value, Handle(0, 0));
+  Handles *handles = new Handles();
+  BTreeNode leaf;
+  while (leaf_id != 0) {
+    load(leaf_id, leaf);
+    for (auto const& entry: leaf.entries) {
+      if (min_key != nullptr && BTreeNode::compare(entry.key, min_value) < 0)
+        continue;
+      if (max_key != nullptr && BTreeNode::compare(entry.key, max_value) > 0)
+        return handles;
+      handles->push_back(entry.handle);
+    }
+    leaf_id = leaf.link;
+  }
+  return handles;
+}
+
+void BTreeIndex::insert(Handle handle) {
+  open();
+  BTreeNode::Entry entry;
+  entry.key = tkey(handle);
+  entry.handle = handle;
+  entry.child = 0;
+  // so that every node can always hold a few entries
+  if (RowCodec::key_size(entry.key) > node_capacity() / 4)
+    throw DbRelationError("key too long for index " + this->name);
+  if (this->unique && has_key(entry.key))
+    throw DbRelationError("duplicate key for unique index " + this->name);
+
+  BTreeNode::Entry split;
+  if (insert(this->root, this->height, entry, split)) {
+    // the root split: grow the tree by one level
+    BTreeNode new_root(false, new_block());
+    new_root.link = this->root;
+    new_root.entries.push_back(split);
+    save(new_root);
+    this->root = new_root.block_id;
+    this->height++;
+    save_stat();
+  }
+}
+
+void BTreeIndex::del(Handle handle) {
+  open();
+  KeyValue key = tkey(handle);
+  BTreeNode leaf;
+  load(find_leaf(&key, handle), leaf);
+  for (auto entry = leaf.entries.begin(); entry != leaf.entries.end(); entry++) {
+    if (entry->handle == handle && BTreeNode::compare(entry->key, key) == 0) {
+      leaf.entries.erase(entry);
+      save(leaf);
+      return;
+    }
+  }
+}
+
+bool BTreeIndex::has_key(const KeyValue &key) {
+  BlockID leaf_id = find_leaf(&key, Handle(0, 0));
+  BTreeNode leaf;
+  while (leaf_id != 0) {
+    load(leaf_id, leaf);
+    for (auto const& entry: leaf.entries) {
+      int cmp = BTreeNode::compare(entry.key, key);
+      if (cmp >= 0)
+        return cmp == 0;
+    }
+    leaf_id = leaf.link;
+  }
+  return false;
+}
+
+// key values in key column order, from a dictionary that has at least those columns
+KeyValue BTreeIndex::tkey(const ValueDict *key_values) const {
+  KeyValue key;
+  for (auto const& column_name: this->key_columns) {
+    ValueDict::const_iterator value = key_values->find(column_name);
+    if (value == key_values->end())
+      throw DbRelationError("no value for key column " + column_name + " of index " + this->name);
+    key.push_back(value->second);
+  }
+  return key;
+}
+
+KeyValue BTreeIndex::tkey(Handle handle) {
+  ValueDict *row = this->relation.project(handle, &this->key_columns);
+  KeyValue key;
+  try
+    {
+      key = tkey(row);
+    }
+  catch(...)
+    {
+      delete row;
+      throw;
+    }
+  delete row;
+  return key;
+}
+
+// Add entry below block_id (a node at level, 1 being the leaves). If that node has to
+// split, split is set to the boundary entry for the new right-hand node and true returned.
+bool BTreeIndex::insert(BlockID block_id, uint level, const BTreeNode::Entry &entry, BTreeNode::Entry &split) {
+  BTreeNode node;
+  load(block_id, node);
+  if (level == 1) {
+    uint at = node.child_index(entry.key, entry.handle);
+    node.entries.insert(node.entries.begin() + at, entry);
+  } else {
+    uint at = node.child_index(entry.key, entry.handle);
+    BTreeNode::Entry child_split;
+    if (!insert(node.child_at(at), level - 1, entry, child_split))
+      return false;
+    node.entries.insert(node.entries.begin() + at, child_split);
+  }
+
+  if (node.encoded_size() <= node_capacity()) {
+    save(node);
+    return false;
+  }
+
+  // split about the middle of the node's bytes
+  u_int32_t half = node.encoded_size() / 2;
+  BTreeNode left(node.leaf, node.block_id);
+  left.link = node.link;
+  size_t middle = 0;
+  while (middle + 1 < node.entries.size() && left.encoded_size() < half) {
+    left.entries.push_back(node.entries[middle]);
+    middle++;
+  }
+
+  BTreeNode right(node.leaf, new_block());
+  if (node.leaf) {
+    right.entries.assign(node.entries.begin() + middle, node.entries.end());
+    right.link = node.link;
+    left.link = right.block_id;
+    split = right.entries.front();
+  } else {
+    // the middle boundary moves up; its child becomes the right node's leftmost
+    right.link = node.entries[middle].child;
+    right.entries.assign(node.entries.begin() + middle + 1, node.entries.end());
+    split = node.entries[middle];
+  }
+  split.child = right.block_id;
+  save(right);
+  save(left);
+  return true;
+}
+
+// leaf where (key, handle) belongs; the leftmost leaf if key is nullptr
+BlockID BTreeIndex::find_leaf(const KeyValue *key, Handle handle) {
+  BlockID block_id = this->root;
+  BTreeNode node;
+  for (uint level = this->height; level > 1; level--) {
+    load(block_id, node);
+    block_id = key == nullptr ? node.link : node.child_at(node.child_index(*key, handle));
+  }
+  return block_id;
+}
+
+void BTreeIndex::load(BlockID block_id, BTreeNode &node) {
+  SlottedPage *block = this->file.get(block_id);
+  RecordView record;
+  if (!block->view(1, record)) {
+    this->file.release(block);
+    throw DbRelationError("index " + this->name + " is missing node " + std::to_string(block_id));
+  }
+  node.block_id = block_id;
+  node.decode(record);
+  this->file.release(block);
+}
+
+void BTreeIndex::save(const BTreeNode &node) {
+  std::vector<char> bytes(node.encoded_size());
+  node.encode(bytes.data());
+  Dbt data(bytes.data(), (u_int32_t) bytes.size());
+  SlottedPage *block = this->file.get(node.block_id);
+  try
+    {
+      RecordView record;
+      if (block->view(1, record))
+        block->put(1, data);
+      else
+        block->add(&data);
+    }
+  catch(...)
+    {
+      this->file.release(block);
+      throw;
+    }
+  this->file.put(block);
+  this->file.release(block);
+}
+
+BlockID BTreeIndex::new_block() {
+  SlottedPage *block = this->file.get_new();
+  BlockID block_id = block->get_block_id();
+  this->file.release(block);
+  return block_id;
+}
+
+void BTreeIndex::save_stat() {
+  u_int32_t stat[2] = {this->root, this->height};
+  Dbt data(stat, sizeof(stat));
+  SlottedPage *block = this->file.get(STAT);
+  RecordView record;
+  if (block->view(1, record))
+    block->put(1, data);
+  else
+    block->add(&data);
+  this->file.put(block);
+  this->file.release(block);
+}
+
+// room for one record in an otherwise empty SlottedPage (its header plus one slot)
+u_int32_t BTreeIndex::node_capacity() {
+  return this->file.get_block_size() - 16;
+}
+
+
+// test function -- returns true if all tests pass
+bool test_btree() {
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_test_btree_cpp", column_names, column_attributes);
+    table.create();
+    ValueDicts rows;
+    for (int i = 0; i < 5000; i++) {
+        ValueDict row;
+        row["a"] = Value(i);
+        row["b"] = Value("b" + std::to_string(i % 100));
+        rows.push_back(row);
+    }
+    delete table.insert_batch(&rows);
+
+    BTreeIndex index(table, "fooindex", ColumnNames{"a"}, true);
+    index.create();
+    table.add_index(&index);
+    std::cout << "create index ok, height " << index.get_height() << std::endl;
+    if (index.get_height() < 2)
+        return false;
+
+    ValueDict key;
+    for (int i = 0; i < 5000; i += 7) {
+        key["a"] = Value(i);
+        Handles *handles = index.lookup(&key);
+        bool ok = handles->size() == 1;
+        if (ok) {
+            ValueDict *row = table.project((*handles)[0]);
+            ok = (*row)["a"].n == i;
+            delete row;
+        }
+        delete handles;
+        if (!ok)
+            return false;
+    }
+    key["a"] = Value(6000);
+    Handles *handles = index.lookup(&key);
+    bool missing = handles->empty();
+    delete handles;
+    if (!missing)
+        return false;
+    std::cout << "lookup ok" << std::endl;
+
+    ValueDict low, high;
+    low["a"] = Value(100);
+    high["a"] = Value(199);
+    handles = index.range(&low, &high);
+    bool in_range = handles->size() == 100;
+    delete handles;
+    if (!in_range)
+        return false;
+    std::cout << "range ok" << std::endl;
+
+    // the index follows the table
+    ValueDict row;
+    row["a"] = Value(-1);
+    row["b"] = Value("new");
+    Handle added = table.insert(&row);
+    try {
+        table.insert(&row);
+        return false;
+    } catch (DbRelationError const&) {
+    }
+    key["a"] = Value(-1);
+    handles = index.lookup(&key);
+    bool follows = handles->size() == 1 && (*handles)[0] == added;
+    delete handles;
+    ValueDict change;
+    change["a"] = Value(-2);
+    table.update(added, &change);
+    handles = index.lookup(&key);
+    follows = follows && handles->empty();
+    delete handles;
+    table.del(added);
+    key["a"] = Value(-2);
+    handles = index.lookup(&key);
+    follows = follows && handles->empty();
+    delete handles;
+    Handles *all = table.select();
+    follows = follows && all->size() == 5000;
+    delete all;
+    if (!follows)
+        return false;
+    std::cout << "insert/update/del ok" << std::endl;
+
+    table.remove_index(&index);
+    index.drop();
+    table.drop();
+    return true;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file btree.h - B+tree implementation of DbIndex.
+ * BTreeNode
+ * BTreeIndex
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "heap_storage.h"
+
+/**
+ * @class BTreeNode - one B+tree node, decoded from the single record in its block
+ *
+ * Entries are kept in (key, handle) order, so duplicate keys in a non-unique index
+ * still have one place each and can be found again for del().
+ *      Leaf:     entries are the index entries; link is the next leaf to the right (0 at the end).
+ *      Interior: link is the leftmost child; each entry is a boundary and the child
+ *                holding the entries at or above it (below the next boundary).
+ */
+class BTreeNode {
+public:
+    struct Entry {
+        KeyValue key;
+        Handle handle;
+        BlockID child;  // interior nodes only
+    };
+
+    bool leaf;
+    BlockID block_id;
+    BlockID link;
+    std::vector<Entry> entries;
+
+    BTreeNode(bool leaf = true, BlockID block_id = 0) : leaf(leaf), block_id(block_id), link(0) {}
+
+    /**
+     * Order of two keys, column by column: negative, zero, or positive.
+     */
+    static int compare(const KeyValue &a, const KeyValue &b);
+
+    /**
+     * Order of two entries: by key, then by handle.
+     */
+    static int compare(const KeyValue &a_key, Handle a_handle, const KeyValue &b_key, Handle b_handle);
+
+    /**
+     * Position of the child (0 for link, i for entries[i-1].child) whose range holds (key, handle).
+     */
+    uint child_index(const KeyValue &key, Handle handle) const;
+
+    BlockID child_at(uint index) const { return index == 0 ? link : entries[index - 1].child; }
+
+    u_int32_t encoded_size() const;
+
+    void encode(char *bytes) const;
+
+    void decode(const RecordView &record);
+};
+
+
+/**
+ * @class BTreeIndex - B+tree index on a DbRelation, stored in its own HeapFile
+ *
+ * Each node lives alone in one block of the file, as that block's only record, and
+ * goes through the buffer pool like any other block. Block 1 holds the root's block
+ * id and the tree's height (1 when the root is a leaf). A lookup therefore reads one
+ * block per level. Nodes split when their encoding no longer fits in a block;
+ * deletes just remove the entry (nodes are not merged). If a rollback touches the
+ * file, the root and height are read again.
+ *
+ * Methods:
+ * 	create()
+ * 	drop()
+ * 	open()
+ * 	close()
+ * 	lookup(key_values)
+ * 	range(min_key, max_key)
+ * 	insert(handle)
+ * 	del(handle)
+ */
+class BTreeIndex : public DbIndex {
+public:
+    BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique);
+
+    virtual ~BTreeIndex();
+
+    BTreeIndex(const BTreeIndex &other) = delete;
+
+    BTreeIndex(BTreeIndex &&temp) = delete;
+
+    BTreeIndex &operator=(const BTreeIndex &other) = delete;
+
+    BTreeIndex &operator=(BTreeIndex &&temp) = delete;
+
+    virtual void create();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual Handles *lookup(const ValueDict *key_values);
+
+    virtual Handles *range(const ValueDict *min_key, const ValueDict *max_key);
+
+    virtual void insert(Handle handle);
+
+    virtual void del(Handle handle);
+
+    virtual uint get_height() const { return height; }
+
+protected:
+    static const BlockID STAT = 1;
+
+    HeapFile file;
+    bool closed;
+    BlockID root;
+    uint height;
+    u_int32_t generation;   // file's generation when root and height were read
+
+    virtual bool has_key(const KeyValue &key);
+
+    virtual KeyValue tkey(const ValueDict *key_values) const;
+
+    virtual KeyValue tkey(Handle handle);
+
+    virtual bool insert(BlockID block_id, uint level, const BTreeNode::Entry &entry, BTreeNode::Entry &split);
+
+    virtual BlockID find_leaf(const KeyValue *key, Handle handle);
+
+    virtual void load(BlockID block_id, BTreeNode &node);
+
+    virtual void save(const BTreeNode &node);
+
+    virtual BlockID new_block();
+
+    virtual void save_stat();
+
+    virtual u_int32_t node_capacity();
+};
+
+bool test_btree();
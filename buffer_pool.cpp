@@ -0,0 +1,307 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "buffer_pool.h"
+#include "transaction.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+BufferPool::BufferPool(uint num_frames): frames(num_frames), clock_hand(0), hits(0), misses(0), evictions(0), writes(0)
+{
+  if (num_frames == 0) {
+    throw BufferPoolError("buffer pool needs at least one frame");
+  }
+  for (auto &frame: this->frames) {
+    frame.file = nullptr;
+    frame.block_id = 0;
+    frame.bytes = new char[DbBlock::BLOCK_SZ];
+    frame.capacity = DbBlock::BLOCK_SZ;
+    frame.page = nullptr;
+    frame.pin_count = 0;
+    frame.dirty = false;
+    frame.referenced = false;
+    frame.txn = nullptr;
+    frame.stale = false;
+  }
+}
+
+BufferPool::~BufferPool() {
+  flush_all();
+  for (uint i = 0; i < this->frames.size(); i++) {
+    clear(i);
+    delete[] this->frames[i].bytes;
+  }
+}
+
+SlottedPage* BufferPool::fetch(HeapFile *file, BlockID block_id) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  auto found = this->lookup.find(FrameKey(file, block_id));
+  if (found != this->lookup.end()) {
+    Frame &frame = this->frames[found->second];
+    this->hits++;
+    // changes made outside any transaction go out before a transaction can take the frame
+    if (frame.dirty && frame.txn == nullptr && TransactionManager::current() != nullptr) {
+      write_back(frame);
+    }
+    frame.pin_count++;
+    frame.referenced = true;
+    return frame.page;
+  }
+  this->misses++;
+  return pin(victim(), file, block_id, false);
+}
+
+SlottedPage* BufferPool::fetch_new(HeapFile *file, BlockID block_id) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return pin(victim(), file, block_id, true);
+}
+
+void BufferPool::unpin(DbBlock *block) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  auto found = this->frame_of.find(block);
+  if (found == this->frame_of.end()) {
+    return;  // frame was discarded out from under the caller (e.g., file dropped)
+  }
+  Frame &frame = this->frames[found->second];
+  if (frame.pin_count > 0) {
+    frame.pin_count--;
+  }
+  if (frame.pin_count == 0 && frame.stale) {
+    clear(found->second);
+  }
+}
+
+void BufferPool::mark_dirty(DbBlock *block) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  auto found = this->frame_of.find(block);
+  if (found == this->frame_of.end()) {
+    throw BufferPoolError("block is not in the buffer pool");
+  }
+  Frame &frame = this->frames[found->second];
+  if (frame.stale) {
+    return;  // its transaction rolled back, taking the block's changes with it
+  }
+  frame.dirty = true;
+  if (frame.txn == nullptr)
+    frame.txn = TransactionManager::current();
+}
+
+bool BufferPool::claim(HeapFile *file) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  DbTxn *txn = TransactionManager::current();
+  auto found = this->writers.find(file);
+  if (found != this->writers.end())
+    return found->second == txn;
+  if (txn != nullptr)
+    this->writers[file] = txn;
+  return true;
+}
+
+void BufferPool::flush(HeapFile *file) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  for (auto &frame: this->frames) {
+    if (frame.file == file && frame.dirty) {
+      write_back(frame);
+    }
+  }
+}
+
+void BufferPool::discard(HeapFile *file) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  for (uint i = 0; i < this->frames.size(); i++) {
+    if (this->frames[i].file == file) {
+      clear(i);
+    }
+  }
+  this->writers.erase(file);
+  for (auto &blocks: this->evicted) {
+    blocks.second.erase(std::remove_if(blocks.second.begin(), blocks.second.end(),
+                                       [file](const FrameKey &key) { return key.first == file; }),
+                        blocks.second.end());
+  }
+}
+
+void BufferPool::flush_all() {
+  std::lock_guard<std::mutex> guard(this->lock);
+  for (auto &frame: this->frames) {
+    if (frame.file != nullptr && frame.dirty) {
+      write_back(frame);
+    }
+  }
+}
+
+void BufferPool::flush_transaction(DbTxn *txn) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  for (auto &frame: this->frames) {
+    if (frame.file != nullptr && frame.txn == txn && frame.dirty) {
+      write_back(frame);
+    }
+  }
+  for (auto &frame: this->frames) {
+    if (frame.txn == txn) {
+      frame.txn = nullptr;
+    }
+  }
+  this->evicted.erase(txn);
+  release_claims(txn);
+}
+
+std::vector<BufferPool::FrameKey> BufferPool::discard_transaction(DbTxn *txn) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  // blocks written under txn to make room: a frame read back in since has its changes too
+  std::unordered_set<FrameKey, FrameKeyHash> evicted;
+  auto found = this->evicted.find(txn);
+  if (found != this->evicted.end()) {
+    evicted.insert(found->second.begin(), found->second.end());
+    this->evicted.erase(found);
+  }
+  std::vector<FrameKey> blocks(evicted.begin(), evicted.end());
+  for (uint i = 0; i < this->frames.size(); i++) {
+    Frame &frame = this->frames[i];
+    if (frame.file == nullptr || frame.stale) {
+      continue;
+    }
+    FrameKey key(frame.file, frame.block_id);
+    bool was_evicted = evicted.count(key) > 0;
+    if (frame.txn == txn || was_evicted) {
+      if (!was_evicted) {
+        blocks.push_back(key);
+      }
+      forget(i);
+    }
+  }
+  release_claims(txn);
+  return blocks;
+}
+
+// txn is done: the files it claimed are free to change again
+void BufferPool::release_claims(DbTxn *txn) {
+  for (auto claimed = this->writers.begin(); claimed != this->writers.end();) {
+    if (claimed->second == txn)
+      claimed = this->writers.erase(claimed);
+    else
+      ++claimed;
+  }
+}
+
+// CLOCK: sweep at most twice around the frames -- the first pass may only be
+// clearing reference bits -- and take the first free or unreferenced unpinned frame.
+// Frames belonging to open transactions are passed over unless nothing else is free;
+// then the next unpinned one is written under its transaction, which remembers the block.
+uint BufferPool::victim() {
+  uint num_frames = this->frames.size();
+  for (uint sweep = 0; sweep < 2 * num_frames; sweep++) {
+    uint frame_num = this->clock_hand;
+    Frame &frame = this->frames[frame_num];
+    this->clock_hand = (this->clock_hand + 1) % num_frames;
+
+    if (frame.file == nullptr) {
+      return frame_num;
+    }
+    if (frame.pin_count > 0 || frame.txn != nullptr) {
+      continue;
+    }
+    if (frame.referenced) {
+      frame.referenced = false;
+      continue;
+    }
+    if (frame.dirty) {
+      write_back(frame);
+    }
+    clear(frame_num);
+    this->evictions++;
+    return frame_num;
+  }
+  for (uint sweep = 0; sweep < num_frames; sweep++) {
+    uint frame_num = this->clock_hand;
+    Frame &frame = this->frames[frame_num];
+    this->clock_hand = (this->clock_hand + 1) % num_frames;
+
+    if (frame.pin_count > 0) {
+      continue;
+    }
+    if (frame.dirty) {
+      write_back(frame);
+    }
+    if (frame.txn != nullptr) {
+      this->evicted[frame.txn].push_back(FrameKey(frame.file, frame.block_id));
+    }
+    clear(frame_num);
+    this->evictions++;
+    return frame_num;
+  }
+  throw BufferPoolError("all buffer pool frames are pinned");
+}
+
+void BufferPool::write_back(Frame &frame) {
+  frame.file->write(frame.page, frame.txn);
+  frame.dirty = false;
+  this->writes++;
+}
+
+void BufferPool::clear(uint frame_num) {
+  Frame &frame = this->frames[frame_num];
+  if (frame.file == nullptr) {
+    return;
+  }
+  // a forgotten frame's block may have been read into another frame since
+  auto found = this->lookup.find(FrameKey(frame.file, frame.block_id));
+  if (found != this->lookup.end() && found->second == frame_num) {
+    this->lookup.erase(found);
+  }
+  this->frame_of.erase(frame.page);
+  delete frame.page;
+  frame.page = nullptr;
+  frame.file = nullptr;
+  frame.block_id = 0;
+  frame.pin_count = 0;
+  frame.dirty = false;
+  frame.referenced = false;
+  frame.txn = nullptr;
+  frame.stale = false;
+}
+
+// Clear a frame, or if it is still pinned, hide it from fetch and leave clearing it to the last unpin
+void BufferPool::forget(uint frame_num) {
+  Frame &frame = this->frames[frame_num];
+  if (frame.pin_count == 0) {
+    clear(frame_num);
+    return;
+  }
+  auto found = this->lookup.find(FrameKey(frame.file, frame.block_id));
+  if (found != this->lookup.end() && found->second == frame_num) {
+    this->lookup.erase(found);
+  }
+  frame.dirty = false;
+  frame.txn = nullptr;
+  frame.stale = true;
+}
+
+SlottedPage* BufferPool::pin(uint frame_num, HeapFile *file, BlockID block_id, bool is_new) {
+  Frame &frame = this->frames[frame_num];
+  u_int32_t block_sz = file->get_block_size();
+  if (frame.capacity < block_sz) {
+    delete[] frame.bytes;
+    frame.bytes = new char[block_sz];
+    frame.capacity = block_sz;
+  }
+  Dbt data(frame.bytes, block_sz);
+  if (is_new) {
+    std::memset(frame.bytes, 0, block_sz);
+  } else {
+    file->read(block_id, data);
+  }
+
+  frame.file = file;
+  frame.block_id = block_id;
+  frame.page = new SlottedPage(data, block_id, is_new);
+  frame.pin_count = 1;
+  frame.dirty = false;
+  frame.referenced = true;
+  frame.txn = nullptr;
+  frame.stale = false;
+  this->lookup[FrameKey(file, block_id)] = frame_num;
+  this->frame_of[frame.page] = frame_num;
+  return frame.page;
+}
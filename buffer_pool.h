@@ -0,0 +1,231 @@
+/**
+ * @file buffer_pool.h - Engine-level buffer manager for heap file blocks.
+ * BufferPool
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "heap_storage.h"
+
+/**
+ * @class BufferPoolError - thrown when no frame can be freed for a block
+ */
+class BufferPoolError : public std::runtime_error {
+public:
+    explicit BufferPoolError(std::string s) : runtime_error(s) {}
+};
+
+/**
+ * @class BufferPool - fixed set of block frames shared by all HeapFiles
+ *
+ * HeapFile::get() and get_new() hand out pages that live in one of our frames and are
+ * pinned until HeapFile::release(). HeapFile::put() just marks the frame dirty; the
+ * block is written back to Berkeley DB lazily, when the frame is chosen for eviction
+ * or the file is flushed/closed. Victims are chosen with the CLOCK (second-chance)
+ * policy, skipping pinned frames.
+ *
+ * Under a transaction (see TransactionManager), a frame changed while the transaction
+ * is open belongs to it until it commits or rolls back, and is then either written
+ * under the transaction or thrown away. Such frames are evicted only when no other
+ * frame will do: the block is written under the transaction (Berkeley DB undoes it if
+ * the transaction aborts) and remembered, so a rollback can forget any copy read back
+ * in since and bring the file's free-space map back into line. A frame changed outside any
+ * transaction is written back before a transaction fetches it, so a rollback can't
+ * take those changes with it. So that no one else's changes land in a transaction's
+ * frames, a writer claims the file first: once an open transaction has claimed a
+ * file, no other transaction (or statement outside one) may change it until that
+ * transaction commits or rolls back.
+ *
+ * All methods are safe to call from several threads at once (one lock guards the
+ * frame table, held across a miss's read), so concurrent readers such as a parallel
+ * scan can share the pool. A pinned page's contents are not locked: concurrent
+ * changes to the same block are up to the caller.
+ *
+ * Methods:
+ * 	fetch(file, block_id)
+ * 	fetch_new(file, block_id)
+ * 	unpin(block)
+ * 	mark_dirty(block)
+ * 	claim(file)
+ * 	flush(file)
+ * 	discard(file)
+ * 	flush_all()
+ * 	flush_transaction(txn)
+ * 	discard_transaction(txn)
+ * Accessors for sizing the pool:
+ * 	get_num_frames()
+ * 	get_hits()
+ * 	get_misses()
+ * 	get_evictions()
+ * 	get_writes()
+ */
+class BufferPool {
+public:
+    typedef std::pair<HeapFile *, BlockID> FrameKey;
+
+    /**
+     * number of frames used when none is specified
+     */
+    static const uint DEFAULT_FRAMES = 256;
+
+    BufferPool(uint num_frames = DEFAULT_FRAMES);
+
+    virtual ~BufferPool();
+
+    BufferPool(const BufferPool &other) = delete;
+
+    BufferPool(BufferPool &&temp) = delete;
+
+    BufferPool &operator=(const BufferPool &other) = delete;
+
+    BufferPool &operator=(BufferPool &&temp) = delete;
+
+    /**
+     * Pin a block of file in a frame, reading it from the file on a miss.
+     * @param file      file the block belongs to
+     * @param block_id  which block
+     * @returns         the pinned page (owned by the pool, see unpin)
+     * @throws          BufferPoolError if every frame is pinned
+     */
+    virtual SlottedPage *fetch(HeapFile *file, BlockID block_id);
+
+    /**
+     * Pin a frame for a block that has just been added to file, initialized as an empty page.
+     * @param file      file the block belongs to
+     * @param block_id  which block
+     * @returns         the pinned page (clean: the caller writes it or marks it dirty)
+     * @throws          BufferPoolError if every frame is pinned
+     */
+    virtual SlottedPage *fetch_new(HeapFile *file, BlockID block_id);
+
+    /**
+     * Drop one pin on a page returned by fetch or fetch_new.
+     * @param block  the page
+     */
+    virtual void unpin(DbBlock *block);
+
+    /**
+     * Note that a pinned page has been changed and must be written back before eviction.
+     * If this thread has a transaction open, the frame now belongs to it.
+     * @param block  the page
+     */
+    virtual void mark_dirty(DbBlock *block);
+
+    /**
+     * Before changing any of file's blocks: make sure no other open transaction has
+     * changes to it pending, and if this thread has a transaction open, claim the file
+     * for it until it commits or rolls back.
+     * @param file  the file about to be changed
+     * @returns     false if another open transaction has claimed file
+     */
+    virtual bool claim(HeapFile *file);
+
+    /**
+     * Write back all of file's dirty frames.
+     */
+    virtual void flush(HeapFile *file);
+
+    /**
+     * Forget all of file's frames without writing them (e.g., file is being dropped).
+     * Any pins still held on them are abandoned.
+     */
+    virtual void discard(HeapFile *file);
+
+    /**
+     * Write back every dirty frame.
+     */
+    virtual void flush_all();
+
+    /**
+     * Write every frame belonging to txn under txn, then release them to the pool.
+     * If a write fails the frames still belong to txn, ready for discard_transaction.
+     */
+    virtual void flush_transaction(DbTxn *txn);
+
+    /**
+     * Forget every frame belonging to txn without writing it, and any frame read back in
+     * of a block evicted under txn. A frame someone still has pinned is only hidden from
+     * fetch, and freed when the last pin is dropped.
+     * @returns  the blocks forgotten (those evicted under txn included)
+     */
+    virtual std::vector<FrameKey> discard_transaction(DbTxn *txn);
+
+    virtual uint get_num_frames() const { return (uint) frames.size(); }
+
+    virtual u_int64_t get_hits() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return hits;
+    }
+
+    virtual u_int64_t get_misses() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return misses;
+    }
+
+    virtual u_int64_t get_evictions() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return evictions;
+    }
+
+    virtual u_int64_t get_writes() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return writes;
+    }
+
+protected:
+
+    struct FrameKeyHash {
+        size_t operator()(const FrameKey &key) const {
+            return std::hash<HeapFile *>()(key.first) ^ (std::hash<BlockID>()(key.second) * 31);
+        }
+    };
+
+    struct Frame {
+        HeapFile *file;         // nullptr when the frame is free
+        BlockID block_id;
+        char *bytes;
+        u_int32_t capacity;     // bytes allocated, grown for files with larger blocks
+        SlottedPage *page;
+        uint pin_count;
+        bool dirty;
+        bool referenced;        // CLOCK's second-chance bit
+        DbTxn *txn;             // open transaction the frame belongs to, if any
+        bool stale;             // forgotten while pinned: cleared at the last unpin
+    };
+
+    mutable std::mutex lock;
+    std::vector<Frame> frames;
+    std::unordered_map<FrameKey, uint, FrameKeyHash> lookup;
+    std::unordered_map<DbBlock *, uint> frame_of;
+    std::unordered_map<HeapFile *, DbTxn *> writers;   // files claimed by open transactions
+    std::unordered_map<DbTxn *, std::vector<FrameKey>> evicted;  // blocks written under open transactions
+    uint clock_hand;
+    u_int64_t hits;
+    u_int64_t misses;
+    u_int64_t evictions;
+    u_int64_t writes;
+
+    virtual uint victim();
+
+    virtual void write_back(Frame &frame);
+
+    virtual void clear(uint frame_num);
+
+    virtual void forget(uint frame_num);
+
+    virtual void release_claims(DbTxn *txn);
+
+    virtual SlottedPage *pin(uint frame_num, HeapFile *file, BlockID block_id, bool is_new);
+};
+
+/**
+ * Global buffer pool used by every HeapFile (set up alongside _DB_ENV).
+ */
+extern BufferPool *_BUFFER_POOL;
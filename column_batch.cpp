@@ -0,0 +1,66 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "column_batch.h"
+#include <cstring>
+
+void ColumnBatch::take_columns(ColumnBatch &from, const std::vector<uint> &columns) {
+  this->columns.resize(columns.size());
+  std::vector<bool> taken(from.columns.size(), false);
+  for (uint i = 0; i < columns.size(); i++) {
+    uint column = columns[i];
+    if (taken[column]) {
+      // asked for twice: copy it from where it went the first time
+      for (uint j = 0; j < i; j++)
+        if (columns[j] == column) {
+          this->columns[i] = this->columns[j];
+          break;
+        }
+    } else {
+      ColumnVector &to = this->columns[i];
+      ColumnVector &out = from.columns[column];
+      to.data_type = out.data_type;
+      to.ints.swap(out.ints);
+      to.ends.swap(out.ends);
+      to.bytes.swap(out.bytes);
+      taken[column] = true;
+    }
+  }
+  this->count = from.count;
+  this->selective = from.selective;
+  this->selection.swap(from.selection);
+  from.clear();
+}
+
+ColumnDecoder::ColumnDecoder(const RowCodec &codec, const std::vector<uint> &columns)
+        : codec(codec), columns(columns)
+{
+  for (auto const& column: columns) {
+    if (column >= codec.num_columns())
+      throw DbRelationError("no such column to decode");
+    this->column_attributes.push_back(ColumnAttribute(codec.get_data_type(column)));
+  }
+}
+
+void ColumnDecoder::decode(const std::vector<RecordView> &records, ColumnBatch &batch) const {
+  size_t n = records.size();
+  for (uint i = 0; i < this->columns.size(); i++) {
+    uint column = this->columns[i];
+    ColumnVector &out = batch.column(i);
+    if (this->codec.get_data_type(column) == ColumnAttribute::INT) {
+      // same offset in every record: one tight copy loop per column
+      u_int32_t offset = this->codec.get_offset(column);
+      size_t base = out.ints.size();
+      out.ints.resize(base + n);
+      int32_t *to = out.ints.data() + base;
+      for (size_t r = 0; r < n; r++)
+        std::memcpy(to + r, records[r].data + offset, sizeof(int32_t));
+    } else {
+      for (size_t r = 0; r < n; r++) {
+        RecordView text = this->codec.get_text(records[r], column);
+        out.append_text(text.data, text.size);
+      }
+    }
+  }
+  batch.add_rows((uint) n);
+}
@@ -0,0 +1,213 @@
+/**
+ * @file column_batch.h - Rows held a column at a time, for vectorized execution.
+ * ColumnVector
+ * ColumnBatch
+ * ColumnDecoder
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "row_codec.h"
+
+/**
+ * @class ColumnVector - one column's values for a run of rows
+ *
+ * An INT column is a plain int32 array; a TEXT column is all of its values' bytes
+ * back to back plus an array of where each value ends (so value i is bytes
+ * ends[i-1] up to ends[i]). Loops over a column touch nothing but the array.
+ * The arrays are kept when the vector is cleared, so refilling reuses them.
+ */
+class ColumnVector {
+public:
+    ColumnAttribute::DataType data_type;
+    std::vector<int32_t> ints;      // INT values
+    std::vector<u_int32_t> ends;    // TEXT: end of each value in bytes
+    std::vector<char> bytes;        // TEXT: the values
+
+    ColumnVector(ColumnAttribute::DataType data_type = ColumnAttribute::INT) : data_type(data_type) {}
+
+    uint size() const { return (uint) (data_type == ColumnAttribute::INT ? ints.size() : ends.size()); }
+
+    void clear() {
+        ints.clear();
+        ends.clear();
+        bytes.clear();
+    }
+
+    void append_int(int32_t n) { ints.push_back(n); }
+
+    void append_text(const char *data, u_int32_t size) {
+        bytes.insert(bytes.end(), data, data + size);
+        ends.push_back((u_int32_t) bytes.size());
+    }
+
+    /**
+     * Value i of a TEXT column, borrowed from the vector.
+     */
+    RecordView get_text(uint i) const {
+        u_int32_t start = i == 0 ? 0 : ends[i - 1];
+        return RecordView(bytes.data() + start, ends[i] - start);
+    }
+
+    /**
+     * Append value i of another vector of the same type.
+     */
+    void append(const ColumnVector &other, uint i) {
+        if (data_type == ColumnAttribute::INT) {
+            ints.push_back(other.ints[i]);
+        } else {
+            RecordView text = other.get_text(i);
+            append_text(text.data, text.size);
+        }
+    }
+};
+
+/**
+ * @class ColumnBatch - about CAPACITY rows, as one ColumnVector per column
+ *
+ * A filter doesn't move any values: it leaves a selection vector, the positions
+ * of the rows still in the batch, in order. Without one, every row is in.
+ *
+ * Methods:
+ * 	reset(column_attributes)
+ * 	clear()
+ * 	size()
+ * 	num_columns()
+ * 	column(i)
+ * 	add_rows(n)
+ * 	num_selected()
+ * 	selected(i)
+ * 	is_selective()
+ * 	get_selection()
+ * 	set_selection(selection)
+ * 	take_columns(from, columns)
+ */
+class ColumnBatch {
+public:
+    /**
+     * rows a producer aims to put in a batch
+     */
+    static const uint CAPACITY = 1024;
+
+    ColumnBatch() : count(0), selective(false) {}
+
+    virtual ~ColumnBatch() {}
+
+    /**
+     * Empty the batch and give it one column of each type.
+     */
+    void reset(const ColumnAttributes &column_attributes) {
+        columns.resize(column_attributes.size());
+        for (uint i = 0; i < columns.size(); i++) {
+            ColumnAttribute attribute = column_attributes[i];
+            columns[i].data_type = attribute.get_data_type();
+        }
+        clear();
+    }
+
+    /**
+     * Empty the batch, keeping its columns.
+     */
+    void clear() {
+        for (auto &column: columns)
+            column.clear();
+        count = 0;
+        selective = false;
+        selection.clear();
+    }
+
+    /**
+     * Rows held (selected or not).
+     */
+    uint size() const { return count; }
+
+    uint num_columns() const { return (uint) columns.size(); }
+
+    ColumnVector &column(uint i) { return columns[i]; }
+
+    const ColumnVector &column(uint i) const { return columns[i]; }
+
+    /**
+     * Count n more rows, once every column has had n values appended.
+     */
+    void add_rows(uint n) { count += n; }
+
+    uint num_selected() const { return selective ? (uint) selection.size() : count; }
+
+    bool empty() const { return num_selected() == 0; }
+
+    /**
+     * Position of the i-th selected row.
+     */
+    uint selected(uint i) const { return selective ? selection[i] : i; }
+
+    bool is_selective() const { return selective; }
+
+    const std::vector<u_int32_t> &get_selection() const { return selection; }
+
+    /**
+     * Keep only the rows at these positions (ascending); swapped in, so selection gets the old one.
+     */
+    void set_selection(std::vector<u_int32_t> &selection) {
+        this->selection.swap(selection);
+        selective = true;
+    }
+
+    /**
+     * Become from's rows (selection and all) with just some of its columns, in the
+     * order given. The vectors are swapped out of from rather than copied, leaving
+     * from empty.
+     * @param from     the batch to take from
+     * @param columns  ordinals of from's columns to take
+     */
+    void take_columns(ColumnBatch &from, const std::vector<uint> &columns);
+
+protected:
+    std::vector<ColumnVector> columns;
+    uint count;
+    bool selective;
+    std::vector<u_int32_t> selection;
+};
+
+/**
+ * @class ColumnDecoder - turns a table's records into columns
+ *
+ * Compiled from the table's RowCodec and the columns wanted. Records are decoded a
+ * column at a time: for an INT column that is one load from the same offset in
+ * each record, straight into the column's array.
+ *
+ * Methods:
+ * 	decode(records, batch)
+ * 	get_columns()
+ * 	get_column_attributes()
+ */
+class ColumnDecoder {
+public:
+    /**
+     * @param codec    the table's codec (must outlive the decoder)
+     * @param columns  ordinals of the columns wanted, in the order wanted
+     */
+    ColumnDecoder(const RowCodec &codec, const std::vector<uint> &columns);
+
+    virtual ~ColumnDecoder() {}
+
+    /**
+     * Append the wanted columns of some records to a batch.
+     * @param records  encoded records
+     * @param batch    gets records.size() more rows (its columns as get_column_attributes())
+     */
+    virtual void decode(const std::vector<RecordView> &records, ColumnBatch &batch) const;
+
+    virtual const std::vector<uint> &get_columns() const { return columns; }
+
+    virtual const ColumnAttributes &get_column_attributes() const { return column_attributes; }
+
+protected:
+    const RowCodec &codec;
+    std::vector<uint> columns;
+    ColumnAttributes column_attributes;
+};
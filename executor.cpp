@@ -0,0 +1,391 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "executor.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// EXPRESSION code
+
+Expression::Expression(Kind kind, ColumnAttribute::DataType data_type, Expression *left, Expression *right)
+        : kind(kind), data_type(data_type), op(Comparison::EQ), ordinal(0), left(left), right(right)
+{}
+
+Expression::~Expression() {
+  delete this->left;
+  delete this->right;
+}
+
+Expression *Expression::column(uint ordinal, ColumnAttribute::DataType data_type) {
+  Expression *expression = new Expression(COLUMN, data_type);
+  expression->ordinal = ordinal;
+  return expression;
+}
+
+Expression *Expression::constant(const Value &value) {
+  Expression *expression = new Expression(CONSTANT, value.data_type);
+  expression->value.data_type = value.data_type;
+  if (value.data_type == ColumnAttribute::INT) {
+    expression->value.n = value.n;
+  } else {
+    expression->text = value.s;
+    expression->value.size = (u_int32_t) expression->text.size();
+    expression->value.text = expression->text.data();
+  }
+  return expression;
+}
+
+Expression *Expression::compare(Comparison::Op op, Expression *left, Expression *right) {
+  if (left->data_type != right->data_type) {
+    delete left;
+    delete right;
+    throw DbRelationError("cannot compare INT with TEXT");
+  }
+  Expression *expression = new Expression(COMPARE, ColumnAttribute::INT, left, right);
+  expression->op = op;
+  return expression;
+}
+
+Expression *Expression::unary(Kind kind, Expression *operand) {
+  if (operand->data_type != ColumnAttribute::INT) {
+    delete operand;
+    throw DbRelationError(kind == NOT ? "NOT needs a condition" : "cannot negate TEXT");
+  }
+  return new Expression(kind, ColumnAttribute::INT, operand);
+}
+
+Expression *Expression::binary(Kind kind, Expression *left, Expression *right) {
+  if (left->data_type != ColumnAttribute::INT || right->data_type != ColumnAttribute::INT) {
+    delete left;
+    delete right;
+    throw DbRelationError(kind == AND || kind == OR ? "AND and OR need conditions" : "arithmetic needs INTs");
+  }
+  return new Expression(kind, ColumnAttribute::INT, left, right);
+}
+
+static Field int_field(int32_t n) {
+  Field field;
+  field.n = n;
+  return field;
+}
+
+Field Expression::evaluate(const Row &row) const {
+  switch (this->kind) {
+    case COLUMN:
+      return row[this->ordinal];
+    case CONSTANT:
+      return this->value;
+    case AND:
+      return int_field(this->left->test(row) && this->right->test(row));
+    case OR:
+      return int_field(this->left->test(row) || this->right->test(row));
+    case NOT:
+      return int_field(!this->left->test(row));
+    case NEGATE:
+      return int_field((int32_t) (0u - (u_int32_t) this->left->evaluate(row).n));
+    case COMPARE: {
+      Field a = this->left->evaluate(row);
+      Field b = this->right->evaluate(row);
+      int cmp;
+      if (this->left->data_type == ColumnAttribute::INT) {
+        cmp = a.n < b.n ? -1 : (a.n > b.n ? 1 : 0);
+      } else {
+        cmp = std::memcmp(a.text, b.text, std::min(a.size, b.size));
+        if (cmp == 0)
+          cmp = a.size < b.size ? -1 : (a.size > b.size ? 1 : 0);
+      }
+      switch (this->op) {
+        case Comparison::EQ: return int_field(cmp == 0);
+        case Comparison::NE: return int_field(cmp != 0);
+        case Comparison::LT: return int_field(cmp < 0);
+        case Comparison::LE: return int_field(cmp <= 0);
+        case Comparison::GT: return int_field(cmp > 0);
+        case Comparison::GE: return int_field(cmp >= 0);
+      }
+      return int_field(0);
+    }
+    default: {
+      // arithmetic wraps like the unsigned ints underneath rather than being undefined
+      u_int32_t a = (u_int32_t) this->left->evaluate(row).n;
+      u_int32_t b = (u_int32_t) this->right->evaluate(row).n;
+      switch (this->kind) {
+        case ADD:
+          return int_field((int32_t) (a + b));
+        case SUBTRACT:
+          return int_field((int32_t) (a - b));
+        case MULTIPLY:
+          return int_field((int32_t) (a * b));
+        default:
+          if (b == 0)
+            throw DbRelationError("division by zero");
+          if ((int32_t) b == -1)  // INT32_MIN / -1 would trap
+            return int_field(this->kind == DIVIDE ? (int32_t) (0u - a) : 0);
+          return int_field(this->kind == DIVIDE ? (int32_t) a / (int32_t) b : (int32_t) a % (int32_t) b);
+      }
+    }
+  }
+}
+
+
+// ROW ARENA code
+
+// TEXT is copied into chunks of this many bytes
+static const size_t TEXT_CHUNK = 64 * 1024;
+
+size_t RowArena::add(const Row &row) {
+  size_t i = this->size();
+  for (uint column = 0; column < this->width; column++) {
+    Field field = row[column];
+    if (field.data_type == ColumnAttribute::TEXT && field.size > 0) {
+      if (field.size > this->text_free) {
+        size_t size = std::max(TEXT_CHUNK, (size_t) field.size);
+        this->text_chunks.emplace_back(new char[size]);
+        this->text_next = this->text_chunks.back().get();
+        this->text_free = size;
+        this->bytes += size;
+      }
+      std::memcpy(this->text_next, field.text, field.size);
+      field.text = this->text_next;
+      this->text_next += field.size;
+      this->text_free -= field.size;
+    }
+    this->fields.push_back(field);
+  }
+  this->bytes += this->width * sizeof(Field);
+  return i;
+}
+
+void RowArena::clear() {
+  this->fields.clear();
+  this->text_chunks.clear();
+  this->text_next = nullptr;
+  this->text_free = 0;
+  this->bytes = 0;
+}
+
+
+// TABLE SCAN code
+
+TableScan::TableScan(HeapTable &table, const Comparisons &where)
+        : QueryOperator(table.get_column_names(), table.get_column_attributes()), table(table), where(where),
+          filter(nullptr), block_id(1), last(0), batch_rows(RowBatch::CAPACITY)
+{}
+
+TableScan::~TableScan() {
+  close();
+}
+
+void TableScan::open() {
+  close();
+  this->last = this->table.get_num_blocks();
+  if (!this->where.empty())
+    this->filter = this->table.compile(this->where);
+  this->block_id = 1;
+}
+
+bool TableScan::next(RowBatch &batch) {
+  batch.clear();
+  while (batch.size() < this->batch_rows && this->block_id <= this->last)
+    this->table.scan_block(this->block_id++, this->filter, batch);
+  return !batch.empty();
+}
+
+void TableScan::close() {
+  delete this->filter;
+  this->filter = nullptr;
+  this->block_id = this->last + 1;
+}
+
+void TableScan::set_row_goal(u_int64_t rows) {
+  this->batch_rows = (uint) std::max<u_int64_t>(1, std::min<u_int64_t>(rows, RowBatch::CAPACITY));
+}
+
+
+// FILTER code
+
+Filter::Filter(QueryOperator *input, Expression *condition)
+        : QueryOperator(input->get_column_names(), input->get_column_attributes()), input(input), condition(condition)
+{}
+
+Filter::~Filter() {
+  delete this->condition;
+  delete this->input;
+}
+
+bool Filter::next(RowBatch &batch) {
+  while (this->input->next(batch)) {
+    uint kept = 0;
+    for (uint i = 0; i < batch.size(); i++) {
+      if (this->condition->test(batch[i])) {
+        if (kept != i)
+          batch[kept].swap(batch[i]);
+        kept++;
+      }
+    }
+    batch.truncate(kept);
+    if (kept > 0)
+      return true;
+  }
+  return false;
+}
+
+
+// PROJECT code
+
+static ColumnAttributes types_of(const std::vector<Expression *> &expressions) {
+  ColumnAttributes column_attributes;
+  for (auto const& expression: expressions)
+    column_attributes.push_back(ColumnAttribute(expression->get_data_type()));
+  return column_attributes;
+}
+
+Project::Project(QueryOperator *input, const std::vector<Expression *> &expressions, const ColumnNames &names)
+        : QueryOperator(names, types_of(expressions)), input(input), expressions(expressions)
+{}
+
+Project::~Project() {
+  for (auto const& expression: this->expressions)
+    delete expression;
+  delete this->input;
+}
+
+bool Project::next(RowBatch &batch) {
+  batch.clear();
+  if (!this->input->next(this->input_rows))
+    return false;
+  uint num_columns = (uint) this->expressions.size();
+  for (uint i = 0; i < this->input_rows.size(); i++) {
+    const Row &in = this->input_rows[i];
+    Row &out = batch.add();
+    out.resize(num_columns);
+    for (uint column = 0; column < num_columns; column++)
+      out[column] = this->expressions[column]->evaluate(in);  // TEXT still points into input_rows
+  }
+  return true;
+}
+
+
+// LIMIT code
+
+Limit::Limit(QueryOperator *input, u_int64_t limit, u_int64_t offset)
+        : QueryOperator(input->get_column_names(), input->get_column_attributes()), input(input), limit(limit),
+          offset(offset), to_skip(offset), to_go(limit)
+{
+  set_row_goal(limit);
+}
+
+void Limit::set_row_goal(u_int64_t rows) {
+  this->input->set_row_goal(this->offset + std::min(rows, this->limit));
+}
+
+void Limit::open() {
+  this->to_skip = this->offset;
+  this->to_go = this->limit;
+  this->input->open();
+}
+
+bool Limit::next(RowBatch &batch) {
+  batch.clear();
+  while (this->to_go > 0 && this->input->next(batch)) {
+    uint skip = (uint) std::min<u_int64_t>(this->to_skip, batch.size());
+    if (skip > 0) {
+      for (uint i = skip; i < batch.size(); i++)
+        batch[i - skip].swap(batch[i]);
+      batch.truncate(batch.size() - skip);
+      this->to_skip -= skip;
+    }
+    batch.truncate((uint) std::min<u_int64_t>(this->to_go, batch.size()));
+    this->to_go -= batch.size();
+    if (!batch.empty())
+      return true;
+  }
+  batch.clear();
+  return false;
+}
+
+
+// test function -- returns true if all tests pass
+bool test_executor() {
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_test_executor", column_names, column_attributes);
+    table.create();
+    ValueDicts rows;
+    for (int i = 0; i < 3000; i++) {
+        ValueDict row;
+        row["a"] = Value(i);
+        row["b"] = Value(i % 2 == 0 ? "even" : "odd");
+        rows.push_back(row);
+    }
+    delete table.insert_batch(&rows);
+
+    bool ok = true;
+    RowBatch batch;
+    TableScan scan(table, {Comparison("a", Comparison::GE, Value(100))});
+    uint count = 0;
+    scan.open();
+    while (scan.next(batch)) {
+        for (uint i = 0; i < batch.size(); i++)
+            ok = ok && batch[i][0].n == (int32_t) (100 + count + i);
+        count += batch.size();
+    }
+    scan.close();
+    if (!ok || count != 2900)
+        return false;
+    std::cout << "scan ok" << std::endl;
+
+    // with a row goal, a batch is a block, not RowBatch::CAPACITY rows, but every row still comes
+    scan.set_row_goal(5);
+    scan.open();
+    count = 0;
+    while (scan.next(batch)) {
+        ok = ok && batch.size() < RowBatch::CAPACITY;
+        count += batch.size();
+    }
+    scan.close();
+    if (!ok || count != 2900)
+        return false;
+    std::cout << "row goal ok" << std::endl;
+
+    // SELECT b, a * 2 FROM _test_executor WHERE a >= 100 AND a % 7 = 0 AND b <> 'odd' LIMIT 10 OFFSET 5
+    Expression *condition = Expression::binary(Expression::AND,
+            Expression::compare(Comparison::EQ,
+                                Expression::binary(Expression::MODULO, Expression::column(0, ColumnAttribute::INT),
+                                                   Expression::constant(Value(7))),
+                                Expression::constant(Value(0))),
+            Expression::compare(Comparison::NE, Expression::column(1, ColumnAttribute::TEXT),
+                                Expression::constant(Value("odd"))));
+    QueryOperator *plan = new Filter(new TableScan(table, {Comparison("a", Comparison::GE, Value(100))}), condition);
+    std::vector<Expression *> expressions = {Expression::column(1, ColumnAttribute::TEXT),
+                                             Expression::binary(Expression::MULTIPLY,
+                                                                Expression::column(0, ColumnAttribute::INT),
+                                                                Expression::constant(Value(2)))};
+    plan = new Limit(new Project(plan, expressions, {"b", "a2"}), 10, 5);
+    std::vector<int32_t> found;
+    plan->open();
+    while (plan->next(batch)) {
+        for (uint i = 0; i < batch.size(); i++) {
+            ok = ok && batch[i].value(0).s == "even";
+            found.push_back(batch[i][1].n);
+        }
+    }
+    plan->close();
+    delete plan;
+    // multiples of 14 from 112: the 6th to the 15th
+    for (uint i = 0; i < found.size(); i++)
+        ok = ok && found[i] == (int32_t) (2 * 14 * (8 + 5 + i));
+    if (!ok || found.size() != 10)
+        return false;
+    std::cout << "filter, project, limit ok" << std::endl;
+
+    try {
+        delete Expression::compare(Comparison::EQ, Expression::column(0, ColumnAttribute::INT),
+                                   Expression::constant(Value("x")));
+        return false;
+    } catch (DbRelationError const&) {
+    }
+    std::cout << "type check ok" << std::endl;
+    table.drop();
+    return true;
+}
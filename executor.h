@@ -0,0 +1,374 @@
+/**
+ * @file executor.h - Physical query operators, pulled a batch of rows at a time.
+ * Expression
+ * RowArena
+ * QueryOperator
+ * TableScan: QueryOperator
+ * Filter: QueryOperator
+ * Project: QueryOperator
+ * Limit: QueryOperator
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "storage_engine.h"
+#include "heap_storage.h"
+#include "predicate.h"
+
+/**
+ * @class Expression - a scalar expression compiled against an operator's columns
+ *
+ * Column references are resolved to ordinals when the expression is built, so
+ * evaluating it on a Row is a walk of the tree with no lookups by name and no
+ * allocation: the result is a Field, whose TEXT (if any) points into the Row or
+ * into the expression's own constant. Comparisons, AND, OR, and NOT give an INT 0
+ * or 1. Types are checked as the tree is built.
+ *
+ * Methods:
+ * 	column(ordinal, data_type)
+ * 	constant(value)
+ * 	compare(op, left, right)
+ * 	unary(kind, operand)
+ * 	binary(kind, left, right)
+ * 	evaluate(row)
+ * 	test(row)
+ * Accessors:
+ * 	get_kind()
+ * 	get_data_type()
+ * 	get_column()
+ */
+class Expression {
+public:
+    enum Kind {
+        COLUMN, CONSTANT, COMPARE, AND, OR, NOT, ADD, SUBTRACT, MULTIPLY, DIVIDE, MODULO, NEGATE
+    };
+
+    static Expression *column(uint ordinal, ColumnAttribute::DataType data_type);
+
+    static Expression *constant(const Value &value);
+
+    /**
+     * left op right; takes ownership of both (deleting them if it throws)
+     * @throws  DbRelationError if they aren't of the same type
+     */
+    static Expression *compare(Comparison::Op op, Expression *left, Expression *right);
+
+    /**
+     * NOT or NEGATE; takes ownership of operand
+     * @throws  DbRelationError if operand isn't an INT
+     */
+    static Expression *unary(Kind kind, Expression *operand);
+
+    /**
+     * AND, OR, or arithmetic; takes ownership of both
+     * @throws  DbRelationError if either isn't an INT
+     */
+    static Expression *binary(Kind kind, Expression *left, Expression *right);
+
+    virtual ~Expression();
+
+    Expression(const Expression &other) = delete;
+
+    Expression(Expression &&temp) = delete;
+
+    Expression &operator=(const Expression &other) = delete;
+
+    Expression &operator=(Expression &&temp) = delete;
+
+    /**
+     * The expression's value for a row.
+     * @throws  DbRelationError on division by zero
+     */
+    virtual Field evaluate(const Row &row) const;
+
+    /**
+     * True if the expression (an INT) is non-zero for a row.
+     */
+    virtual bool test(const Row &row) const { return evaluate(row).n != 0; }
+
+    virtual Kind get_kind() const { return kind; }
+
+    virtual ColumnAttribute::DataType get_data_type() const { return data_type; }
+
+    /**
+     * Ordinal of a COLUMN expression.
+     */
+    virtual uint get_column() const { return ordinal; }
+
+protected:
+    Kind kind;
+    ColumnAttribute::DataType data_type;
+    Comparison::Op op;      // COMPARE
+    uint ordinal;           // COLUMN
+    Field value;            // CONSTANT (a TEXT points into text)
+    std::string text;
+    Expression *left;
+    Expression *right;
+
+    Expression(Kind kind, ColumnAttribute::DataType data_type, Expression *left = nullptr, Expression *right = nullptr);
+};
+
+
+/**
+ * @class RowArena - rows an operator holds on to (a join's build side, a sort's run)
+ *
+ * The rows' Fields go in one flat array and their TEXT is copied into 64KB chunks,
+ * so keeping a row costs no allocation of its own. TEXT stays put as rows are
+ * added; a row's Fields may move until the last one is in.
+ *
+ * Methods:
+ * 	set_width(width)
+ * 	add(row)
+ * 	operator[](i)
+ * 	size()
+ * 	get_bytes()
+ * 	clear()
+ */
+class RowArena {
+public:
+    RowArena(uint width = 0) : width(width), text_next(nullptr), text_free(0), bytes(0) {}
+
+    virtual ~RowArena() {}
+
+    RowArena(const RowArena &other) = delete;
+
+    RowArena(RowArena &&temp) = delete;
+
+    RowArena &operator=(const RowArena &other) = delete;
+
+    RowArena &operator=(RowArena &&temp) = delete;
+
+    /**
+     * Columns per row (set before adding any).
+     */
+    virtual void set_width(uint width) { this->width = width; }
+
+    /**
+     * Copy a row in.
+     * @returns  its row number
+     */
+    virtual size_t add(const Row &row);
+
+    /**
+     * Row i's Fields (width of them).
+     */
+    const Field *operator[](size_t i) const { return &fields[i * width]; }
+
+    size_t size() const { return width == 0 ? 0 : fields.size() / width; }
+
+    /**
+     * Memory held, in bytes.
+     */
+    size_t get_bytes() const { return bytes; }
+
+    virtual void clear();
+
+protected:
+    uint width;
+    std::vector<Field> fields;
+    std::vector<std::unique_ptr<char[]>> text_chunks;
+    char *text_next;        // free space in the last chunk
+    size_t text_free;
+    size_t bytes;
+};
+
+
+/**
+ * @class QueryOperator - one node of a physical query plan (Volcano-style iterator)
+ *
+ * A plan is a tree of operators; each pulls rows from its inputs and hands them up
+ * to its consumer. Rows move a RowBatch at a time rather than one per call, so the
+ * virtual calls and bookkeeping are paid once per batch. An operator owns its inputs.
+ *
+ * Rows an operator puts in a batch are only good until its next call to next():
+ * TEXT in them may point into the operator's own buffers. A consumer that keeps
+ * rows longer must copy them (copying a Row copies its TEXT).
+ *
+ * Methods:
+ * 	open()
+ * 	next(batch)
+ * 	close()
+ * 	set_row_goal(rows)
+ * Accessors:
+ * 	get_column_names()
+ * 	get_column_attributes()
+ */
+class QueryOperator {
+public:
+    QueryOperator(ColumnNames column_names, ColumnAttributes column_attributes)
+            : column_names(column_names), column_attributes(column_attributes) {}
+
+    virtual ~QueryOperator() {}
+
+    QueryOperator(const QueryOperator &other) = delete;
+
+    QueryOperator(QueryOperator &&temp) = delete;
+
+    QueryOperator &operator=(const QueryOperator &other) = delete;
+
+    QueryOperator &operator=(QueryOperator &&temp) = delete;
+
+    /**
+     * Get ready to produce rows (opening inputs).
+     */
+    virtual void open() = 0;
+
+    /**
+     * Produce the next rows.
+     * @param batch  cleared, then filled with at least one row
+     * @returns      false (with batch empty) once there are no more rows
+     */
+    virtual bool next(RowBatch &batch) = 0;
+
+    /**
+     * Release whatever open() took (closing inputs). Safe to call early.
+     */
+    virtual void close() = 0;
+
+    /**
+     * The consumer will likely stop after about this many rows; size batches to match.
+     * Operators that must read all their input first ignore it.
+     */
+    virtual void set_row_goal(u_int64_t rows) {}
+
+    virtual const ColumnNames &get_column_names() const { return column_names; }
+
+    virtual const ColumnAttributes &get_column_attributes() const { return column_attributes; }
+
+protected:
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+};
+
+
+/**
+ * @class TableScan - every row of a HeapTable that passes a where clause
+ *
+ * Reads the table's blocks in order. The where clause (simple column-vs-constant
+ * terms) is applied by the table's RowFilter against the records in place, so rows
+ * that don't qualify are never decoded. A batch is filled a block at a time, up to
+ * about RowBatch::CAPACITY rows or the row goal, whichever is less.
+ */
+class TableScan : public QueryOperator {
+public:
+    /**
+     * @param table  table to read (must outlive the scan)
+     * @param where  terms that must all hold
+     */
+    TableScan(HeapTable &table, const Comparisons &where = Comparisons());
+
+    virtual ~TableScan();
+
+    virtual void open();
+
+    virtual bool next(RowBatch &batch);
+
+    virtual void close();
+
+    virtual void set_row_goal(u_int64_t rows);
+
+protected:
+    HeapTable &table;
+    Comparisons where;
+    RowFilter *filter;
+    BlockID block_id;
+    BlockID last;
+    uint batch_rows;
+};
+
+/**
+ * @class Filter - the input's rows for which a condition holds
+ *
+ * Failing rows are squeezed out of the input's batch in place.
+ */
+class Filter : public QueryOperator {
+public:
+    /**
+     * @param input      rows to filter (owned)
+     * @param condition  compiled against input's columns (owned)
+     */
+    Filter(QueryOperator *input, Expression *condition);
+
+    virtual ~Filter();
+
+    virtual void open() { input->open(); }
+
+    virtual bool next(RowBatch &batch);
+
+    virtual void close() { input->close(); }
+
+    virtual void set_row_goal(u_int64_t rows) { input->set_row_goal(rows); }
+
+protected:
+    QueryOperator *input;
+    Expression *condition;
+};
+
+/**
+ * @class Project - one output column per expression over the input's rows
+ */
+class Project : public QueryOperator {
+public:
+    /**
+     * @param input        rows to project (owned)
+     * @param expressions  compiled against input's columns (owned)
+     * @param names        one per expression
+     */
+    Project(QueryOperator *input, const std::vector<Expression *> &expressions, const ColumnNames &names);
+
+    virtual ~Project();
+
+    virtual void open() { input->open(); }
+
+    virtual bool next(RowBatch &batch);
+
+    virtual void close() { input->close(); }
+
+    virtual void set_row_goal(u_int64_t rows) { input->set_row_goal(rows); }
+
+protected:
+    QueryOperator *input;
+    std::vector<Expression *> expressions;
+    RowBatch input_rows;
+};
+
+/**
+ * @class Limit - at most limit of the input's rows, after skipping offset of them
+ *
+ * Once limit rows have gone up, the input is not asked for any more, so the
+ * work below stops there. The input's row goal is offset + limit, so it doesn't
+ * read a full batch ahead for a handful of rows.
+ */
+class Limit : public QueryOperator {
+public:
+    /**
+     * @param input   rows to take from (owned)
+     * @param limit   most rows to produce
+     * @param offset  rows to skip first
+     */
+    Limit(QueryOperator *input, u_int64_t limit, u_int64_t offset = 0);
+
+    virtual ~Limit() { delete input; }
+
+    virtual void open();
+
+    virtual bool next(RowBatch &batch);
+
+    virtual void close() { input->close(); }
+
+    virtual void set_row_goal(u_int64_t rows);
+
+protected:
+    QueryOperator *input;
+    u_int64_t limit;
+    u_int64_t offset;
+    u_int64_t to_skip;
+    u_int64_t to_go;
+};
+
+bool test_executor();
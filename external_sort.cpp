@@ -0,0 +1,509 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "external_sort.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include "transaction.h"
+
+// numbers run files so concurrent sorts don't collide
+static std::atomic<u_int32_t> next_run_id(0);
+
+// totals for the stats command
+static std::atomic<u_int64_t> total_sorts(0);
+static std::atomic<u_int64_t> total_runs(0);
+static std::atomic<u_int64_t> total_spill_bytes(0);
+
+static ColumnNames run_column_names(uint width) {
+  ColumnNames column_names;
+  for (uint column = 0; column < width; column++)
+    column_names.push_back("c" + std::to_string(column));
+  return column_names;
+}
+
+// SORT ORDER code
+
+SortOrder::SortOrder(const SortKeys &keys, const ColumnAttributes &column_attributes) : keys(keys), exact(true) {
+  uint prefix_used = 0;
+  for (auto const& key: this->keys) {
+    ColumnAttribute attribute = column_attributes[key.column];
+    if (attribute.get_data_type() != ColumnAttribute::INT)
+      this->exact = false;
+    prefix_used += sizeof(int32_t);
+  }
+  if (prefix_used > PREFIX_BYTES)
+    this->exact = false;
+}
+
+// Key bytes in an order memcmp agrees with: INTs big-endian with the sign bit flipped,
+// TEXT as is, zero-padded (a TEXT key ends the prefix), and everything inverted for DESC
+void SortOrder::normalize(const Field *row, unsigned char *prefix) const {
+  std::memset(prefix, 0, PREFIX_BYTES);
+  uint at = 0;
+  for (auto const& key: this->keys) {
+    if (at == PREFIX_BYTES)
+      break;
+    const Field &field = row[key.column];
+    uint start = at;
+    if (field.data_type == ColumnAttribute::INT) {
+      u_int32_t u = (u_int32_t) field.n ^ 0x80000000u;
+      for (int shift = 24; shift >= 0 && at < PREFIX_BYTES; shift -= 8)
+        prefix[at++] = (unsigned char) (u >> shift);
+    } else {
+      if (field.size > 0)
+        std::memcpy(prefix + at, field.text, std::min((uint) field.size, PREFIX_BYTES - at));
+      at = PREFIX_BYTES;
+    }
+    if (key.descending)
+      for (uint i = start; i < at; i++)
+        prefix[i] = (unsigned char) ~prefix[i];
+    if (field.data_type != ColumnAttribute::INT)
+      break;
+  }
+}
+
+// Full key comparison, for ties on the prefix: <0, 0, or >0
+int SortOrder::compare(const Field *a, const Field *b) const {
+  for (auto const& key: this->keys) {
+    const Field &x = a[key.column];
+    const Field &y = b[key.column];
+    int c;
+    if (x.data_type == ColumnAttribute::INT) {
+      c = x.n < y.n ? -1 : x.n > y.n ? 1 : 0;
+    } else {
+      c = std::memcmp(x.text, y.text, std::min(x.size, y.size));
+      if (c == 0)
+        c = x.size < y.size ? -1 : x.size > y.size ? 1 : 0;
+    }
+    if (c != 0)
+      return key.descending ? -c : c;
+  }
+  return 0;
+}
+
+
+// EXTERNAL SORT code
+
+ExternalSort::ExternalSort(QueryOperator *input, const SortKeys &keys, size_t memory_budget)
+        : QueryOperator(input->get_column_names(), input->get_column_attributes()),
+          input(input), order(keys, input->get_column_attributes()), memory_budget(memory_budget),
+          codec(run_column_names((uint) input->get_column_attributes().size()), input->get_column_attributes()),
+          rows((uint) input->get_column_attributes().size()), emitted(0), load_winner(false), spill_bytes(0)
+{}
+
+ExternalSort::~ExternalSort() {
+  close();
+  delete this->input;
+}
+
+void ExternalSort::open() {
+  close();
+  this->spill_bytes = 0;
+  NoTransaction outside;
+  RowBatch batch;
+  Entry entry;
+  this->input->open();
+  while (this->input->next(batch)) {
+    for (uint i = 0; i < batch.size(); i++) {
+      entry.row = (u_int32_t) this->rows.add(batch[i]);
+      this->order.normalize(this->rows[entry.row], entry.prefix);
+      this->entries.push_back(entry);
+      if (this->rows.get_bytes() + this->entries.size() * sizeof(Entry) > this->memory_budget)
+        this->write_run();
+    }
+  }
+  this->input->close();
+  total_sorts++;
+
+  if (this->runs.empty()) {
+    this->sort();
+    this->emitted = 0;
+    return;
+  }
+  if (!this->entries.empty())
+    this->write_run();
+  total_runs += this->runs.size();
+  total_spill_bytes += this->spill_bytes;
+
+  for (auto const& run: this->runs) {
+    run->block_id = 1;
+    run->bytes.resize(run->file->get_block_size());
+    this->load(run);
+  }
+  // every slot starts as the sentinel k, which beats any run; replaying each run pushes it out
+  uint k = (uint) this->runs.size();
+  this->tree.assign(k, k);
+  for (uint run = k; run-- > 0;)
+    this->replay(run);
+  this->load_winner = false;
+}
+
+bool ExternalSort::next(RowBatch &batch) {
+  batch.clear();
+  if (this->runs.empty()) {
+    uint width = (uint) this->column_attributes.size();
+    while (this->emitted < this->entries.size() && !batch.full()) {
+      const Field *from = this->rows[this->entries[this->emitted++].row];
+      Row &out = batch.add();
+      out.resize(width);
+      for (uint column = 0; column < width; column++)
+        out[column] = from[column];
+    }
+    return !batch.empty();
+  }
+
+  if (this->load_winner) {
+    this->load(this->runs[this->tree[0]]);
+    this->replay(this->tree[0]);
+    this->load_winner = false;
+  }
+  while (!this->runs[this->tree[0]]->done) {
+    uint winner = this->tree[0];
+    Run *run = this->runs[winner];
+    Row &out = batch.add();
+    out.swap(run->rows[run->at]);  // its TEXT points into run->bytes, which stays put for now
+    if (++run->at < run->rows.size()) {
+      this->order.normalize(&run->rows[run->at][0], run->prefix);
+      this->replay(winner);
+    } else {
+      // the block is used up: read the next one once this batch has gone out
+      this->load_winner = true;
+      return true;
+    }
+    if (batch.full())
+      return true;
+  }
+  return !batch.empty();
+}
+
+void ExternalSort::close() {
+  this->input->close();
+  this->drop_runs();
+  this->rows.clear();
+  this->entries.clear();
+  this->tree.clear();
+  this->emitted = 0;
+  this->load_winner = false;
+}
+
+u_int64_t ExternalSort::get_total_sorts() {
+  return total_sorts;
+}
+
+u_int64_t ExternalSort::get_total_runs() {
+  return total_runs;
+}
+
+u_int64_t ExternalSort::get_total_spill_bytes() {
+  return total_spill_bytes;
+}
+
+// Sort the entries in memory; ties go by row number, so the sort is stable
+void ExternalSort::sort() {
+  std::sort(this->entries.begin(), this->entries.end(), [this](const Entry &a, const Entry &b) {
+      int c = this->order.compare(a.prefix, this->rows[a.row], b.prefix, this->rows[b.row]);
+      return c != 0 ? c < 0 : a.row < b.row;
+  });
+}
+
+// Over budget (or done with a spilled input): sort what is in memory and write it out as a run
+void ExternalSort::write_run() {
+  this->sort();
+  Run *run = new Run();
+  run->file = new HeapFile("_sort_" + std::to_string(next_run_id++) + "_run");
+  run->block_id = 1;
+  run->at = 0;
+  run->done = false;
+  try
+    {
+      run->file->create();
+    }
+  catch(...)
+    {
+      delete run->file;
+      delete run;
+      throw;
+    }
+  this->runs.push_back(run);
+
+  uint width = (uint) this->column_attributes.size();
+  std::vector<char> bytes(run->file->get_block_size());
+  Row row(width);
+  SlottedPage *block = run->file->get(1);
+  try
+    {
+      for (auto const& entry: this->entries) {
+        const Field *from = this->rows[entry.row];
+        for (uint column = 0; column < width; column++)
+          row[column] = from[column];
+        Dbt data(bytes.data(), this->codec.encode(row, bytes.data(), (u_int32_t) bytes.size()));
+        try
+          {
+            block->add(&data);
+          }
+        catch(DbBlockNoRoomError const&)
+          {
+            run->file->put(block);
+            run->file->release(block);
+            block = nullptr;
+            block = run->file->get_new();
+            block->add(&data);  // still no room: too big for any block
+          }
+      }
+    }
+  catch(DbBlockNoRoomError const&)
+    {
+      if (block != nullptr)
+        run->file->release(block);
+      throw DbRelationError("row too big to fit in a block");
+    }
+  catch(...)
+    {
+      if (block != nullptr)
+        run->file->release(block);
+      throw;
+    }
+  run->file->put(block);
+  run->file->release(block);
+  this->spill_bytes += (u_int64_t) run->file->get_last_block_id() * run->file->get_block_size();
+
+  this->rows.clear();
+  this->entries.clear();
+}
+
+// Read a run's next block into its rows, copying the records out so the block can go
+void ExternalSort::load(Run *run) {
+  run->rows.clear();
+  run->at = 0;
+  while (run->rows.empty()) {
+    if (run->block_id > run->file->get_last_block_id()) {
+      run->done = true;
+      return;
+    }
+    SlottedPage *block = run->file->get(run->block_id++);
+    u_int32_t at = 0;
+    RecordView record;
+    for (RecordID id = 1; block->view(id, record); id++) {
+      std::memcpy(run->bytes.data() + at, record.data, record.size);
+      this->codec.decode(RecordView(run->bytes.data() + at, record.size), run->rows.add());
+      at += record.size;
+    }
+    run->file->release(block);
+  }
+  this->order.normalize(&run->rows[0][0], run->prefix);
+}
+
+// Does run a's head come before run b's? k (one past the last run) is the sentinel that
+// beats everything; a finished run loses to everything else; ties go to the earlier run.
+bool ExternalSort::beats(uint a, uint b) const {
+  uint k = (uint) this->runs.size();
+  if (a == k || b == k)
+    return a == k && b != k;
+  const Run *x = this->runs[a];
+  const Run *y = this->runs[b];
+  if (x->done || y->done)
+    return !x->done || (y->done && a < b);
+  int c = this->order.compare(x->prefix, &x->rows[x->at][0], y->prefix, &y->rows[y->at][0]);
+  return c != 0 ? c < 0 : a < b;
+}
+
+// Run's head changed: play it up the tree from its leaf, leaving each match's loser behind
+void ExternalSort::replay(uint run) {
+  uint k = (uint) this->runs.size();
+  uint winner = run;
+  for (uint node = (run + k) / 2; node > 0; node /= 2)
+    if (this->beats(this->tree[node], winner))
+      std::swap(this->tree[node], winner);
+  this->tree[0] = winner;
+}
+
+void ExternalSort::drop_runs() {
+  NoTransaction outside;
+  for (auto const& run: this->runs) {
+    run->file->drop();
+    delete run->file;
+    delete run;
+  }
+  this->runs.clear();
+}
+
+
+// TOP N code
+
+TopN::TopN(QueryOperator *input, const SortKeys &keys, u_int64_t limit)
+        : QueryOperator(input->get_column_names(), input->get_column_attributes()),
+          input(input), order(keys, input->get_column_attributes()), limit(limit), bar(), have_bar(false), emitted(0)
+{}
+
+void TopN::open() {
+  close();
+  if (this->limit == 0)
+    return;
+  RowBatch batch;
+  Entry entry;
+  u_int64_t number = 0;
+  this->input->open();
+  while (this->input->next(batch)) {
+    for (uint i = 0; i < batch.size(); i++, number++) {
+      const Row &row = batch[i];
+      this->order.normalize(&row[0], entry.prefix);
+      // a later row that ties with the bar comes after it
+      if (this->have_bar &&
+          this->order.compare(entry.prefix, &row[0], this->bar.prefix, &this->rows[this->bar.slot][0]) >= 0)
+        continue;
+      entry.number = number;
+      if (this->free_slots.empty()) {
+        entry.slot = (uint) this->rows.size();
+        this->rows.push_back(row);
+      } else {
+        entry.slot = this->free_slots.back();
+        this->free_slots.pop_back();
+        this->rows[entry.slot] = row;
+      }
+      this->kept.push_back(entry);
+      if (this->kept.size() >= 2 * this->limit)
+        cut();
+    }
+  }
+  this->input->close();
+  if (this->kept.size() > this->limit)
+    cut();
+  std::sort(this->kept.begin(), this->kept.end(), [this](const Entry &a, const Entry &b) {
+      return this->before(a, b);
+  });
+}
+
+bool TopN::next(RowBatch &batch) {
+  batch.clear();
+  uint width = (uint) this->column_attributes.size();
+  while (this->emitted < this->kept.size() && !batch.full()) {
+    const Row &from = this->rows[this->kept[this->emitted++].slot];
+    Row &out = batch.add();
+    out.resize(width);
+    for (uint column = 0; column < width; column++)
+      out[column] = from[column];  // TEXT still points into rows
+  }
+  return !batch.empty();
+}
+
+void TopN::close() {
+  this->input->close();
+  this->rows.clear();
+  this->free_slots.clear();
+  this->kept.clear();
+  this->have_bar = false;
+  this->emitted = 0;
+}
+
+// Keep just the first limit candidates, and raise the bar to the last of them
+void TopN::cut() {
+  auto last = this->kept.begin() + (std::ptrdiff_t) (this->limit - 1);
+  std::nth_element(this->kept.begin(), last, this->kept.end(), [this](const Entry &a, const Entry &b) {
+      return this->before(a, b);
+  });
+  for (auto dropped = last + 1; dropped != this->kept.end(); dropped++)
+    this->free_slots.push_back(dropped->slot);
+  this->kept.resize((size_t) this->limit);
+  this->bar = this->kept.back();
+  this->have_bar = true;
+}
+
+// Does a come before b in the output? Ties go by input order
+bool TopN::before(const Entry &a, const Entry &b) const {
+  int c = this->order.compare(a.prefix, &this->rows[a.slot][0], b.prefix, &this->rows[b.slot][0]);
+  return c != 0 ? c < 0 : a.number < b.number;
+}
+
+
+// test function -- returns true if all tests pass
+bool test_external_sort() {
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::INT)};
+    HeapTable table("_test_external_sort", column_names, column_attributes);
+    table.create();
+    ValueDicts rows;
+    const int n = 5000;
+    for (int i = 0; i < n; i++) {
+        ValueDict row;
+        int a = (i * 7919) % 100 - 50;
+        row["a"] = Value(a);
+        row["b"] = Value("text number " + std::to_string((i * 31) % 1000));
+        row["c"] = Value(i);
+        rows.push_back(row);
+    }
+    delete table.insert_batch(&rows);
+
+    // sorted rows come out in order, each exactly once, equal keys in input order (by c)
+    auto check = [&](const SortKeys &keys, size_t budget, bool spills) {
+        ExternalSort sort(new TableScan(table), keys, budget);
+        RowBatch batch;
+        Row previous;
+        bool first = true;
+        bool ok = true;
+        int count = 0;
+        int64_t sum = 0;
+        sort.open();
+        while (sort.next(batch)) {
+            for (uint i = 0; i < batch.size(); i++) {
+                const Row &row = batch[i];
+                if (!first) {
+                    int c = 0;
+                    for (auto const& key: keys) {
+                        Value x = previous.value(key.column);
+                        Value y = row.value(key.column);
+                        c = x.data_type == ColumnAttribute::INT ? (x.n < y.n ? -1 : x.n > y.n ? 1 : 0)
+                                                                : x.s.compare(y.s);
+                        if (key.descending)
+                            c = -c;
+                        if (c != 0)
+                            break;
+                    }
+                    ok = ok && (c < 0 || (c == 0 && previous[2].n < row[2].n));
+                }
+                first = false;
+                previous = row;
+                sum += row[2].n;
+                count++;
+            }
+        }
+        ok = ok && (sort.get_runs() > 1) == spills && (sort.get_spill_bytes() > 0) == spills;
+        sort.close();
+        return ok && count == n && sum == (int64_t) (n - 1) * n / 2;
+    };
+    if (!check({{0, false}}, ExternalSort::MEMORY_BUDGET, false) ||
+        !check({{1, true}, {0, false}}, ExternalSort::MEMORY_BUDGET, false))
+        return false;
+    std::cout << "external sort ok" << std::endl;
+    if (!check({{0, true}}, 128 * 1024, true) || !check({{1, false}, {0, true}}, 128 * 1024, true) ||
+        !check({{0, false}, {1, false}, {0, true}, {2, true}}, 128 * 1024, true))
+        return false;
+    std::cout << "external sort spilled ok" << std::endl;
+
+    // a top n is the first n rows of the sort, ties and all
+    auto first_rows = [&](QueryOperator *plan) {
+        std::vector<int> found;
+        RowBatch batch;
+        plan->open();
+        while (plan->next(batch))
+            for (uint i = 0; i < batch.size(); i++)
+                found.push_back(batch[i][2].n);
+        plan->close();
+        delete plan;
+        return found;
+    };
+    for (auto const& keys: {SortKeys{{0, false}}, SortKeys{{1, true}, {0, false}}}) {
+        std::vector<int> sorted = first_rows(new ExternalSort(new TableScan(table), keys));
+        for (u_int64_t limit: {0, 1, 37, 1000, n + 1}) {
+            std::vector<int> top = first_rows(new TopN(new TableScan(table), keys, limit));
+            if (top != std::vector<int>(sorted.begin(), sorted.begin() + std::min<u_int64_t>(limit, n)))
+                return false;
+        }
+    }
+    std::cout << "top n ok" << std::endl;
+
+    table.drop();
+    return true;
+}
@@ -0,0 +1,244 @@
+/**
+ * @file external_sort.h - ORDER BY for inputs bigger than memory.
+ * SortKey
+ * SortOrder
+ * ExternalSort: QueryOperator
+ * TopN: QueryOperator
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <cstring>
+#include <vector>
+#include "storage_engine.h"
+#include "executor.h"
+#include "heap_storage.h"
+#include "row_codec.h"
+
+/**
+ * @class SortKey - one ORDER BY column of a sort's input
+ */
+struct SortKey {
+    uint column;
+    bool descending;
+};
+typedef std::vector<SortKey> SortKeys;
+
+/**
+ * @class SortOrder - compares rows by their sort keys
+ *
+ * normalize() gives the first PREFIX_BYTES of a row's key in a form memcmp puts in
+ * key order: INTs big-endian with the sign bit flipped, TEXT as its bytes (zero-padded,
+ * and ending the prefix), all inverted for DESC. Most comparisons are settled by the
+ * memcmp; only ties on the prefix, when the keys don't fit in it, look at the rows.
+ *
+ * Methods:
+ * 	normalize(row, prefix)
+ * 	compare(a, b)
+ * 	compare(a_prefix, a, b_prefix, b)
+ */
+class SortOrder {
+public:
+    /**
+     * bytes of normalized key
+     */
+    static const uint PREFIX_BYTES = 12;
+
+    /**
+     * @param keys               columns to sort by, most significant first
+     * @param column_attributes  of the rows to be compared
+     */
+    SortOrder(const SortKeys &keys, const ColumnAttributes &column_attributes);
+
+    virtual ~SortOrder() {}
+
+    /**
+     * Write a row's normalized key prefix.
+     */
+    virtual void normalize(const Field *row, unsigned char *prefix) const;
+
+    /**
+     * Full key comparison: <0, 0, or >0.
+     */
+    virtual int compare(const Field *a, const Field *b) const;
+
+    /**
+     * Comparison by prefix, then (if they tie and that's not the end of it) by the rows.
+     */
+    int compare(const unsigned char *a_prefix, const Field *a, const unsigned char *b_prefix, const Field *b) const {
+        int c = std::memcmp(a_prefix, b_prefix, PREFIX_BYTES);
+        return c != 0 || exact ? c : compare(a, b);
+    }
+
+protected:
+    SortKeys keys;
+    bool exact;     // a tie on the prefix is a tie on the keys
+};
+
+/**
+ * @class ExternalSort - the input's rows in key order (stable)
+ *
+ * open() reads the input into a RowArena, with a small array of entries to sort: per
+ * row, its SortOrder prefix and its number, so most comparisons are one memcmp.
+ *
+ * When the arena passes the memory budget, the sorted rows are written out as a run
+ * to a temporary HeapFile, in order, and the arena starts over. If any run was
+ * written, the rest become one too, and next() merges all of them with a loser tree:
+ * each run's head row plays its way up a tree of past losers, so finding the next
+ * row costs one comparison per level. Runs are written a block at a time in order,
+ * outside any open transaction, and dropped by close(). Merged rows are handed up
+ * pointing into their run's current block, so that is only read anew after a batch
+ * went out.
+ *
+ * Methods:
+ * 	open()
+ * 	next(batch)
+ * 	close()
+ * Accessors:
+ * 	get_runs()
+ * 	get_spill_bytes()
+ * 	get_total_sorts()
+ * 	get_total_runs()
+ * 	get_total_spill_bytes()
+ */
+class ExternalSort : public QueryOperator {
+public:
+    /**
+     * bytes of rows sorted in memory before a run is written out
+     */
+    static const size_t MEMORY_BUDGET = 64 * 1024 * 1024;
+
+    /**
+     * @param input          rows to sort (owned)
+     * @param keys           input's columns to sort by, most significant first
+     * @param memory_budget  bytes of rows to hold before writing a run
+     */
+    ExternalSort(QueryOperator *input, const SortKeys &keys, size_t memory_budget = MEMORY_BUDGET);
+
+    virtual ~ExternalSort();
+
+    virtual void open();
+
+    virtual bool next(RowBatch &batch);
+
+    virtual void close();
+
+    /**
+     * Runs the last open() wrote (0 if it sorted in memory).
+     */
+    virtual uint get_runs() const { return (uint) runs.size(); }
+
+    /**
+     * Bytes the last open() wrote to runs.
+     */
+    virtual u_int64_t get_spill_bytes() const { return spill_bytes; }
+
+    /**
+     * Totals over every sort in this process.
+     */
+    static u_int64_t get_total_sorts();
+
+    static u_int64_t get_total_runs();
+
+    static u_int64_t get_total_spill_bytes();
+
+protected:
+    // a row to sort: its normalized key prefix and its number in the arena
+    struct Entry {
+        unsigned char prefix[SortOrder::PREFIX_BYTES];
+        u_int32_t row;
+    };
+
+    // a run being merged: its file, and the rows of the block it is up to (TEXT in bytes)
+    struct Run {
+        HeapFile *file;
+        BlockID block_id;
+        std::vector<char> bytes;
+        RowBatch rows;
+        uint at;
+        unsigned char prefix[SortOrder::PREFIX_BYTES];   // of rows[at]
+        bool done;
+    };
+
+    QueryOperator *input;
+    SortOrder order;
+    size_t memory_budget;
+    RowCodec codec;         // for the runs' records
+    RowArena rows;
+    std::vector<Entry> entries;
+    size_t emitted;         // in-memory: entries handed up so far
+    std::vector<Run *> runs;
+    std::vector<uint> tree; // loser tree over runs: tree[0] the winner, tree[1..] losers
+    bool load_winner;       // winner's block is used up, but the last batch points into it
+    u_int64_t spill_bytes;
+
+    virtual void sort();
+
+    virtual void write_run();
+
+    virtual void load(Run *run);
+
+    virtual bool beats(uint a, uint b) const;
+
+    virtual void replay(uint run);
+
+    virtual void drop_runs();
+};
+
+/**
+ * @class TopN - the first limit of the input's rows in key order (stable), for ORDER BY ... LIMIT
+ *
+ * At most twice limit rows are ever held. Candidates are added until there are that
+ * many, then cut back to the first limit of them (by nth_element), the last of which
+ * becomes the bar: an input row that doesn't come before it is dropped after one
+ * comparison (usually a memcmp of SortOrder prefixes). Each row costs O(1) amortized,
+ * even when every row beats the bar, as for input already in reverse order.
+ */
+class TopN : public QueryOperator {
+public:
+    /**
+     * largest limit worth holding in memory; past this, ExternalSort
+     */
+    static const u_int64_t MAX_ROWS = 100000;
+
+    /**
+     * @param input  rows to sort (owned)
+     * @param keys   input's columns to sort by, most significant first
+     * @param limit  rows to keep
+     */
+    TopN(QueryOperator *input, const SortKeys &keys, u_int64_t limit);
+
+    virtual ~TopN() { delete input; }
+
+    virtual void open();
+
+    virtual bool next(RowBatch &batch);
+
+    virtual void close();
+
+protected:
+    // a row kept: its prefix, its place in the input, and where it is in rows
+    struct Entry {
+        unsigned char prefix[SortOrder::PREFIX_BYTES];
+        u_int64_t number;
+        uint slot;
+    };
+
+    QueryOperator *input;
+    SortOrder order;
+    u_int64_t limit;
+    std::vector<Row> rows;
+    std::vector<uint> free_slots;   // of rows, dropped by a cut
+    std::vector<Entry> kept;
+    Entry bar;                      // the last row kept by the last cut
+    bool have_bar;
+    size_t emitted;
+
+    virtual void cut();
+
+    virtual bool before(const Entry &a, const Entry &b) const;
+};
+
+bool test_external_sort();
@@ -0,0 +1,179 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "filter_kernels.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define X86_KERNELS 1
+#endif
+
+// SlottedPage layout: slot header for record id i is (size, offset) at 8*i
+static const u_int32_t SLOT_SZ = 8;
+static const u_int32_t SLOT_LOC = 4;
+
+static inline u_int32_t load_u32(const char *at) {
+  u_int32_t n;
+  memcpy(&n, at, sizeof(n));
+  return n;
+}
+
+static inline bool holds(int32_t n, Comparison::Op op, int32_t value) {
+  switch (op) {
+    case Comparison::EQ:
+      return n == value;
+    case Comparison::NE:
+      return n != value;
+    case Comparison::LT:
+      return n < value;
+    case Comparison::LE:
+      return n <= value;
+    case Comparison::GT:
+      return n > value;
+    case Comparison::GE:
+      return n >= value;
+  }
+  return false;
+}
+
+// one record at a time; the reference the vector kernels must agree with
+static void filter_int_scalar(const char *page, u_int32_t num_records, u_int32_t offset,
+                              Comparison::Op op, int32_t value, u_int64_t *bitmap) {
+  for (u_int32_t word = 0; word * 64 < num_records; word++) {
+    u_int32_t first = word * 64 + 1;
+    u_int64_t bits = 0;
+    for (u_int32_t id = first; id <= num_records && id < first + 64; id++) {
+      u_int32_t loc = load_u32(page + SLOT_SZ * id + SLOT_LOC);
+      if (loc != 0 && holds((int32_t) load_u32(page + loc + offset), op, value))
+        bits |= (u_int64_t) 1 << (id - first);
+    }
+    bitmap[word] &= bits;
+  }
+}
+
+#ifdef X86_KERNELS
+
+// all ones in the lanes where "x op v" holds (SSE2 only has == and >)
+__attribute__((target("sse4.2")))
+static inline __m128i compare4(__m128i x, __m128i v, Comparison::Op op) {
+  const __m128i ones = _mm_set1_epi32(-1);
+  switch (op) {
+    case Comparison::EQ:
+      return _mm_cmpeq_epi32(x, v);
+    case Comparison::NE:
+      return _mm_xor_si128(_mm_cmpeq_epi32(x, v), ones);
+    case Comparison::LT:
+      return _mm_cmpgt_epi32(v, x);
+    case Comparison::LE:
+      return _mm_xor_si128(_mm_cmpgt_epi32(x, v), ones);
+    case Comparison::GT:
+      return _mm_cmpgt_epi32(x, v);
+    case Comparison::GE:
+      return _mm_xor_si128(_mm_cmpgt_epi32(v, x), ones);
+  }
+  return _mm_setzero_si128();
+}
+
+// no gather before AVX2: load four slots' values by hand, then compare them together
+__attribute__((target("sse4.2")))
+static void filter_int_sse42(const char *page, u_int32_t num_records, u_int32_t offset,
+                             Comparison::Op op, int32_t value, u_int64_t *bitmap) {
+  const __m128i v = _mm_set1_epi32(value);
+  const __m128i zero = _mm_setzero_si128();
+  for (u_int32_t word = 0; word * 64 < num_records; word++) {
+    u_int32_t first = word * 64 + 1;
+    u_int64_t bits = 0;
+    u_int32_t chunk = 0;
+    for (; chunk < 64 && first + chunk + 3 <= num_records; chunk += 4) {
+      const char *slot = page + SLOT_SZ * (first + chunk) + SLOT_LOC;
+      __m128i locs = _mm_set_epi32((int32_t) load_u32(slot + 3 * SLOT_SZ), (int32_t) load_u32(slot + 2 * SLOT_SZ),
+                                   (int32_t) load_u32(slot + SLOT_SZ), (int32_t) load_u32(slot));
+      // a deleted record's offset is 0, which still reads inside the page, so no branches
+      __m128i values = _mm_set_epi32((int32_t) load_u32(page + _mm_extract_epi32(locs, 3) + offset),
+                                     (int32_t) load_u32(page + _mm_extract_epi32(locs, 2) + offset),
+                                     (int32_t) load_u32(page + _mm_extract_epi32(locs, 1) + offset),
+                                     (int32_t) load_u32(page + _mm_cvtsi128_si32(locs) + offset));
+      __m128i hit = _mm_andnot_si128(_mm_cmpeq_epi32(locs, zero), compare4(values, v, op));
+      bits |= (u_int64_t) (u_int32_t) _mm_movemask_ps(_mm_castsi128_ps(hit)) << chunk;
+    }
+    for (u_int32_t id = first + chunk; id <= num_records && id < first + 64; id++) {  // last few slots
+      u_int32_t loc = load_u32(page + SLOT_SZ * id + SLOT_LOC);
+      if (loc != 0 && holds((int32_t) load_u32(page + loc + offset), op, value))
+        bits |= (u_int64_t) 1 << (id - first);
+    }
+    bitmap[word] &= bits;
+  }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i compare8(__m256i x, __m256i v, Comparison::Op op) {
+  const __m256i ones = _mm256_set1_epi32(-1);
+  switch (op) {
+    case Comparison::EQ:
+      return _mm256_cmpeq_epi32(x, v);
+    case Comparison::NE:
+      return _mm256_xor_si256(_mm256_cmpeq_epi32(x, v), ones);
+    case Comparison::LT:
+      return _mm256_cmpgt_epi32(v, x);
+    case Comparison::LE:
+      return _mm256_xor_si256(_mm256_cmpgt_epi32(x, v), ones);
+    case Comparison::GT:
+      return _mm256_cmpgt_epi32(x, v);
+    case Comparison::GE:
+      return _mm256_xor_si256(_mm256_cmpgt_epi32(v, x), ones);
+  }
+  return _mm256_setzero_si256();
+}
+
+// eight slots at a time: gather their record offsets out of the slot headers, then
+// gather the column from each live record and compare
+__attribute__((target("avx2")))
+static void filter_int_avx2(const char *page, u_int32_t num_records, u_int32_t offset,
+                            Comparison::Op op, int32_t value, u_int64_t *bitmap) {
+  const int *base = (const int *) page;
+  const __m256i v = _mm256_set1_epi32(value);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i end = _mm256_set1_epi32((int32_t) num_records + 1);
+  const __m256i slot_loc = _mm256_set1_epi32(SLOT_LOC);
+  const __m256i column = _mm256_set1_epi32((int32_t) offset);
+  for (u_int32_t word = 0; word * 64 < num_records; word++) {
+    u_int32_t first = word * 64 + 1;
+    u_int64_t bits = 0;
+    for (u_int32_t chunk = 0; chunk < 64 && first + chunk <= num_records; chunk += 8) {
+      __m256i ids = _mm256_add_epi32(_mm256_set1_epi32((int32_t) (first + chunk)), lanes);
+      __m256i in_page = _mm256_cmpgt_epi32(end, ids);  // lanes past the last slot read nothing
+      __m256i loc_at = _mm256_add_epi32(_mm256_slli_epi32(ids, 3), slot_loc);
+      __m256i locs = _mm256_mask_i32gather_epi32(zero, base, loc_at, in_page, 1);
+      __m256i live = _mm256_andnot_si256(_mm256_cmpeq_epi32(locs, zero), in_page);
+      __m256i values = _mm256_mask_i32gather_epi32(zero, base, _mm256_add_epi32(locs, column), live, 1);
+      __m256i hit = _mm256_and_si256(compare8(values, v, op), live);
+      bits |= (u_int64_t) (u_int32_t) _mm256_movemask_ps(_mm256_castsi256_ps(hit)) << chunk;
+    }
+    bitmap[word] &= bits;
+  }
+}
+
+#endif
+
+IntFilterKernel int_filter_kernel(const std::string &isa) {
+  if (isa.empty())
+    return int_filter_kernel(int_filter_isa());
+  if (isa == "scalar")
+    return filter_int_scalar;
+#ifdef X86_KERNELS
+  __builtin_cpu_init();
+  if (isa == "avx2" && __builtin_cpu_supports("avx2"))
+    return filter_int_avx2;
+  if (isa == "sse4.2" && __builtin_cpu_supports("sse4.2"))
+    return filter_int_sse42;
+#endif
+  return nullptr;
+}
+
+std::string int_filter_isa() {
+  static const std::string best = int_filter_kernel("avx2") != nullptr ? "avx2" :
+                                  int_filter_kernel("sse4.2") != nullptr ? "sse4.2" : "scalar";
+  return best;
+}
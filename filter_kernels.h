@@ -0,0 +1,44 @@
+/**
+ * @file filter_kernels.h - Vectorized INT column filters over a SlottedPage's slots.
+ * IntFilterKernel
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <string>
+#include "predicate.h"
+
+/**
+ * Signature of a kernel that compares one INT column against a constant for every
+ * slot of a SlottedPage, working directly on the page's bytes:
+ *      for record ids 1..num_records, read the slot header's record offset (0 for a
+ *      deleted record), then the int32 at that offset plus the column's offset, then
+ *      compare it with value.
+ * The result is ANDed into bitmap, one bit per record id (bit id-1, 64 ids per word),
+ * so a conjunction is just one call per term on a bitmap that starts as all ones.
+ * Deleted records always come out as 0.
+ *
+ * @param page         the block's bytes (SlottedPage layout)
+ * @param num_records  number of slots in the page's header
+ * @param offset       the column's offset within every record (RowCodec::get_offset)
+ * @param op           comparison, as in "column op value"
+ * @param value        constant to compare with
+ * @param bitmap       (num_records + 63) / 64 words
+ */
+typedef void (*IntFilterKernel)(const char *page, u_int32_t num_records, u_int32_t offset,
+                                Comparison::Op op, int32_t value, u_int64_t *bitmap);
+
+/**
+ * Look up a filter kernel. They are all built into the engine; which ones can run
+ * is decided on this machine's CPU the first time through.
+ * @param isa  "avx2", "sse4.2" or "scalar"; empty for the best one this CPU supports
+ * @returns    the kernel, or nullptr if isa is unknown or not supported here
+ */
+IntFilterKernel int_filter_kernel(const std::string &isa = "");
+
+/**
+ * Name of the kernel int_filter_kernel() picks by default on this machine.
+ */
+std::string int_filter_isa();
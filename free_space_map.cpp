@@ -0,0 +1,143 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "free_space_map.h"
+#include <algorithm>
+
+FreeSpaceMap::FreeSpaceMap(std::string name): dbfilename(name + ".fsm.db"), unit(DbBlock::BLOCK_SZ / 256), db(nullptr), closed(true), next_fit(1)
+{}
+
+void FreeSpaceMap::create() {
+  db_open(DB_CREATE | DB_EXCL);
+}
+
+void FreeSpaceMap::open() {
+  db_open();
+}
+
+void FreeSpaceMap::close() {
+  if (this->closed) {
+    return;
+  }
+  for (uint page = 0; page < this->page_dirty.size(); page++) {
+    if (this->page_dirty[page]) {
+      db_recno_t recno = page + 1;
+      Dbt key(&recno, sizeof(recno));
+      Dbt data(&this->categories[page * ENTRIES_PER_PAGE], ENTRIES_PER_PAGE);
+      this->db->put(nullptr, &key, &data, 0);
+    }
+  }
+  this->db->close(0);
+  delete this->db;
+  this->db = nullptr;
+  this->closed = true;
+}
+
+void FreeSpaceMap::drop() {
+  close();
+  Db db(_DB_ENV, 0);
+  db.remove(this->dbfilename.c_str(), nullptr, 0);
+}
+
+void FreeSpaceMap::set(BlockID block_id, u_int32_t free_bytes) {
+  u_int8_t category = (u_int8_t) std::min(free_bytes / this->unit, (u_int32_t) 255);
+  uint index = block_id - 1;
+  uint page = index / ENTRIES_PER_PAGE;
+
+  if (index >= this->categories.size()) {
+    this->categories.resize((page + 1) * ENTRIES_PER_PAGE, 0);
+    this->page_max.resize(page + 1, 0);
+    this->page_dirty.resize(page + 1, false);
+  }
+  if (this->categories[index] == category) {
+    return;
+  }
+  this->categories[index] = category;
+  this->page_dirty[page] = true;
+  if (category > this->page_max[page]) {
+    this->page_max[page] = category;
+  }
+}
+
+BlockID FreeSpaceMap::find(u_int32_t size) {
+  u_int32_t needed = std::max((size + this->unit - 1) / this->unit, (u_int32_t) 1);
+  uint num_pages = this->page_max.size();
+  if (needed > 255 || num_pages == 0) {
+    return 0;
+  }
+
+  // next fit: start where we last found room and wrap around once, ending back on
+  // the first page to cover the entries before the starting point
+  BlockID start = this->next_fit;
+  if (start == 0 || start > this->categories.size()) {
+    start = 1;
+  }
+  uint first_page = (start - 1) / ENTRIES_PER_PAGE;
+  for (uint i = 0; i <= num_pages; i++) {
+    uint page = (first_page + i) % num_pages;
+    BlockID from = i == 0 ? start : page * ENTRIES_PER_PAGE + 1;
+    BlockID found;
+    if (this->page_max[page] >= needed && scan_page(page, (u_int8_t) needed, from, found)) {
+      this->next_fit = found;
+      return found;
+    }
+  }
+  return 0;
+}
+
+void FreeSpaceMap::db_open(uint flags) {
+  if (!this->closed) {
+    return;
+  }
+  this->db = new Db(_DB_ENV, 0);
+  try {
+    this->db->set_re_len(ENTRIES_PER_PAGE);
+    this->db->open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags | DB_THREAD, 0644);
+  } catch (DbException const&) {
+    delete this->db;
+    this->db = nullptr;
+    throw;
+  }
+  this->closed = false;
+
+  this->categories.clear();
+  this->page_max.clear();
+  this->page_dirty.clear();
+  this->next_fit = 1;
+
+  Dbc *cursor;
+  this->db->cursor(nullptr, &cursor, 0);
+  db_recno_t recno;
+  Dbt key(&recno, sizeof(recno));
+  key.set_ulen(sizeof(recno));
+  key.set_flags(DB_DBT_USERMEM);
+  std::vector<u_int8_t> page(ENTRIES_PER_PAGE);
+  Dbt data(page.data(), ENTRIES_PER_PAGE);
+  data.set_ulen(ENTRIES_PER_PAGE);
+  data.set_flags(DB_DBT_USERMEM);
+  while (cursor->get(&key, &data, DB_NEXT) != DB_NOTFOUND) {
+    this->categories.insert(this->categories.end(), page.begin(), page.end());
+    this->page_max.push_back(*std::max_element(page.begin(), page.end()));
+    this->page_dirty.push_back(false);
+  }
+  cursor->close();
+}
+
+// Look for a qualifying block in one map page, starting at block from. A scan of the
+// whole page that comes up empty also tightens the page's cached maximum.
+bool FreeSpaceMap::scan_page(uint page, u_int8_t needed, BlockID from, BlockID &found) {
+  uint first = page * ENTRIES_PER_PAGE;
+  uint end = first + ENTRIES_PER_PAGE;
+  u_int8_t max_seen = 0;
+  for (uint index = from - 1; index < end; index++) {
+    if (this->categories[index] >= needed) {
+      found = index + 1;
+      return true;
+    }
+    max_seen = std::max(max_seen, this->categories[index]);
+  }
+  if (from - 1 == first) {
+    this->page_max[page] = max_seen;
+  }
+  return false;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file free_space_map.h - Persistent free-space map for heap files.
+ * FreeSpaceMap
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <vector>
+#include "db_cxx.h"
+#include "storage_engine.h"
+
+/**
+ * @class FreeSpaceMap - how much room each block of a HeapFile has for a new record
+ *
+ * One byte per block holds the block's free space in units of 1/256 of the heap file's
+ * block size (rounded down, so the map never promises more room than there is). The bytes
+ * are kept in their own Berkeley DB RecNo file next to the heap file, ENTRIES_PER_PAGE entries
+ * to a page, and read fully into memory while the map is open; changed pages are
+ * written back on close.
+ *
+ * Lookups skip whole map pages by a cached per-page maximum and resume where the
+ * previous lookup succeeded, so a stream of appends costs O(1) amortized.
+ *
+ * Methods:
+ * 	create()
+ * 	open()
+ * 	close()
+ * 	drop()
+ * 	set_block_size(block_sz)
+ * 	set(block_id, free_bytes)
+ * 	find(size)
+ */
+class FreeSpaceMap {
+public:
+    FreeSpaceMap(std::string name);
+
+    virtual ~FreeSpaceMap() { close(); }
+
+    FreeSpaceMap(const FreeSpaceMap &other) = delete;
+
+    FreeSpaceMap(FreeSpaceMap &&temp) = delete;
+
+    FreeSpaceMap &operator=(const FreeSpaceMap &other) = delete;
+
+    FreeSpaceMap &operator=(FreeSpaceMap &&temp) = delete;
+
+    /**
+     * Create an empty map file (and open it).
+     */
+    virtual void create();
+
+    /**
+     * Open an existing map file and load it.
+     * @throws  DbException if there is no map file
+     */
+    virtual void open();
+
+    /**
+     * Write back changed map pages and close the file.
+     */
+    virtual void close();
+
+    /**
+     * Remove the map file.
+     */
+    virtual void drop();
+
+    /**
+     * Tell the map the heap file's block size, which sets its granularity.
+     * @param block_sz  heap file's block size
+     */
+    virtual void set_block_size(u_int32_t block_sz) { unit = block_sz / 256; }
+
+    /**
+     * Record how much room a block has.
+     * @param block_id    which block
+     * @param free_bytes  largest record the block can currently accept
+     */
+    virtual void set(BlockID block_id, u_int32_t free_bytes);
+
+    /**
+     * Find a block with room for a record.
+     * @param size  record size needed
+     * @returns     a block that should have room, or 0 if the map knows of none
+     */
+    virtual BlockID find(u_int32_t size);
+
+protected:
+    static const uint ENTRIES_PER_PAGE = DbBlock::BLOCK_SZ;
+
+    std::string dbfilename;
+    u_int32_t unit;                     // bytes of free space per category step
+    Db *db;                             // a closed Db handle can't be reopened, so one per open
+    bool closed;
+    std::vector<u_int8_t> categories;   // categories[block_id - 1]
+    std::vector<u_int8_t> page_max;     // upper bound on each map page's categories
+    std::vector<bool> page_dirty;
+    BlockID next_fit;                   // where the last successful find left off
+
+    virtual void db_open(uint flags = 0);
+
+    virtual bool scan_page(uint page, u_int8_t needed, BlockID from, BlockID &found);
+};
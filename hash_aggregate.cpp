@@ -0,0 +1,459 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "hash_aggregate.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <thread>
+#include "hash_join.h"
+#include "thread_pool.h"
+#include "transaction.h"
+
+// slot marker for no group
+static const int32_t NO_GROUP = -1;
+
+// numbers temporary partition tables so concurrent aggregates don't collide
+static std::atomic<u_int32_t> next_aggregate_id(0);
+
+// The group columns' attributes, then an INT per aggregate
+static ColumnAttributes output_attributes(const ColumnAttributes &input, const std::vector<uint> &groups,
+                                          size_t num_aggregates) {
+  ColumnAttributes attributes;
+  for (auto const& column: groups)
+    attributes.push_back(input[column]);
+  attributes.insert(attributes.end(), num_aggregates, ColumnAttribute(ColumnAttribute::INT));
+  return attributes;
+}
+
+// Where each aggregate's accumulators start; returns how many there are in all
+static uint layout(const HashAggregate::Aggregates &aggregates, std::vector<uint> &offsets) {
+  uint width = 0;
+  for (auto const& aggregate: aggregates) {
+    offsets.push_back(width);
+    width += aggregate.function == VectorAggregate::AVG ? 2 : 1;
+  }
+  return width;
+}
+
+HashAggregate::HashAggregate(QueryOperator *input, const std::vector<uint> &groups, const Aggregates &aggregates,
+                             const ColumnNames &names, size_t memory_budget)
+        : QueryOperator(names, output_attributes(input->get_column_attributes(), groups, aggregates.size())),
+          input(input), table(nullptr), groups(groups), aggregates(aggregates), num_workers(1),
+          memory_budget(memory_budget), partition(0), emitted(0), empty_emitted(false), groups_out(0)
+{
+  this->width = layout(this->aggregates, this->offsets);
+  for (uint column = 0; column < this->groups.size(); column++)
+    this->key_columns.push_back(column);
+}
+
+HashAggregate::HashAggregate(HeapTable &table, const Comparisons &where, const std::vector<uint> &groups,
+                             const Aggregates &aggregates, const ColumnNames &names, uint num_workers,
+                             size_t memory_budget)
+        : QueryOperator(names, output_attributes(table.get_column_attributes(), groups, aggregates.size())),
+          input(nullptr), table(&table), where(where), groups(groups), aggregates(aggregates),
+          num_workers(num_workers), memory_budget(memory_budget), partition(0), emitted(0), empty_emitted(false),
+          groups_out(0)
+{
+  this->width = layout(this->aggregates, this->offsets);
+  for (uint column = 0; column < this->groups.size(); column++)
+    this->key_columns.push_back(column);
+  if (this->num_workers == 0)
+    this->num_workers = std::max(1u, std::thread::hardware_concurrency());
+}
+
+HashAggregate::~HashAggregate() {
+  close();
+  delete this->input;
+}
+
+void HashAggregate::open() {
+  close();
+  ColumnAttributes attributes = this->input != nullptr ? this->input->get_column_attributes()
+                                                        : this->table->get_column_attributes();
+  for (auto const& aggregate: this->aggregates) {
+    if (aggregate.column >= 0 && aggregate.function != VectorAggregate::COUNT &&
+        attributes[aggregate.column].get_data_type() != ColumnAttribute::INT)
+      throw DbRelationError("only INT columns can be summed, averaged, or compared");
+  }
+  this->groups_out = 0;
+  this->empty_emitted = false;
+  NoTransaction outside;
+
+  for (uint worker = 0; worker < this->num_workers; worker++)
+    this->partials.emplace_back(new Groups((uint) this->groups.size(), this->width));
+  if (this->input != nullptr) {
+    RowBatch batch;
+    this->input->open();
+    while (this->input->next(batch))
+      this->accumulate(*this->partials[0], batch);
+    this->input->close();
+  } else {
+    std::unique_ptr<RowFilter> filter(this->table->compile(this->where));
+    BlockID last = this->table->get_num_blocks();
+    std::atomic<BlockID> next_morsel(0);
+    if (this->num_workers == 1) {
+      this->scan(*this->partials[0], filter.get(), last, next_morsel);
+    } else {
+      // on the process's pool, not threads of our own each open(); other operators may share it
+      std::vector<std::future<void>> scans;
+      for (uint worker = 0; worker < this->num_workers; worker++) {
+        Groups *mine = this->partials[worker].get();
+        std::shared_ptr<std::packaged_task<void()>> scan(new std::packaged_task<void()>(
+                [this, mine, &filter, last, &next_morsel]() {
+                    this->scan(*mine, filter.get(), last, next_morsel);
+                }));
+        scans.push_back(scan->get_future());
+        ThreadPool::shared().submit([scan]() { (*scan)(); });
+      }
+      // every scan is done before any exception goes up: they use filter and next_morsel
+      for (auto &scan: scans)
+        scan.wait();
+      for (auto &scan: scans)
+        scan.get();
+    }
+  }
+
+  if (this->partitions.empty()) {
+    for (uint worker = 1; worker < this->partials.size(); worker++)
+      this->merge(*this->partials[0], *this->partials[worker]);
+  } else {
+    // some worker spilled: the rest of the groups follow, to be merged a partition at a time
+    for (auto const& partial: this->partials)
+      this->spill(*partial);
+  }
+  this->partials.resize(1);
+  this->emitted = 0;
+  this->partition = 0;
+}
+
+bool HashAggregate::next(RowBatch &batch) {
+  batch.clear();
+  if (this->partials.empty())
+    return false;
+  uint num_groups = (uint) this->groups.size();
+  while (true) {
+    Groups &groups = *this->partials[0];
+    while (this->emitted < groups.size() && !batch.full()) {
+      size_t group = this->emitted++;
+      Row &out = batch.add();
+      out.resize(num_groups + (uint) this->aggregates.size());
+      for (uint column = 0; column < num_groups; column++)
+        out[column] = groups.keys[group][column];
+      const int64_t *values = &groups.values[group * this->width];
+      for (uint a = 0; a < this->aggregates.size(); a++) {
+        uint offset = this->offsets[a];
+        int64_t result = values[offset];
+        if (this->aggregates[a].function == VectorAggregate::AVG)
+          result /= values[offset + 1];
+        if (result < INT_MIN || result > INT_MAX)
+          throw DbRelationError(this->column_names[num_groups + a] + " is out of range for an INT");
+        out.set_int(num_groups + a, (int32_t) result);
+      }
+      this->groups_out++;
+    }
+    if (!batch.empty())
+      return true;  // its TEXT points into the keys, so load the next partition next call
+    if (!this->next_partition())
+      break;
+  }
+
+  // aggregates over no rows at all, with no groups, still make a row
+  if (num_groups == 0 && this->groups_out == 0 && !this->empty_emitted) {
+    Row &out = batch.add();
+    out.resize((uint) this->aggregates.size());
+    for (uint a = 0; a < this->aggregates.size(); a++)
+      out.set_int(a, 0);
+    this->empty_emitted = true;
+    return true;
+  }
+  return false;
+}
+
+void HashAggregate::close() {
+  if (this->input != nullptr)
+    this->input->close();
+  this->drop_partitions();
+  this->partials.clear();
+  this->emitted = 0;
+  this->partition = 0;
+}
+
+void HashAggregate::Groups::clear() {
+  this->keys.clear();
+  this->hashes.clear();
+  this->values.clear();
+  this->slots.clear();
+}
+
+// One worker's share of the table scan: morsels of blocks until there are none left
+void HashAggregate::scan(Groups &mine, const RowFilter *filter, BlockID last, std::atomic<BlockID> &next_morsel) {
+  RowBatch batch;
+  while (true) {
+    BlockID first = next_morsel++ * HeapTable::MORSEL_BLOCKS + 1;
+    if (first > last)
+      return;
+    BlockID end = std::min(last, first + HeapTable::MORSEL_BLOCKS - 1);
+    for (BlockID block_id = first; block_id <= end; block_id++) {
+      batch.clear();
+      this->table->scan_block(block_id, filter, batch);
+      this->accumulate(mine, batch);
+    }
+  }
+}
+
+void HashAggregate::accumulate(Groups &mine, const RowBatch &rows) {
+  for (uint i = 0; i < rows.size(); i++) {
+    const Row &row = rows[i];
+    uint group = this->find(mine, &row[0], this->groups, HashJoin::hash(row, this->groups));
+    int64_t *values = &mine.values[group * this->width];
+    for (uint a = 0; a < this->aggregates.size(); a++) {
+      int64_t *value = values + this->offsets[a];
+      const Aggregate &aggregate = this->aggregates[a];
+      int32_t n = aggregate.column >= 0 ? row[aggregate.column].n : 0;
+      switch (aggregate.function) {
+        case VectorAggregate::COUNT: value[0]++; break;
+        case VectorAggregate::SUM: value[0] += n; break;
+        case VectorAggregate::MIN: value[0] = std::min(value[0], (int64_t) n); break;
+        case VectorAggregate::MAX: value[0] = std::max(value[0], (int64_t) n); break;
+        case VectorAggregate::AVG: value[0] += n; value[1]++; break;
+      }
+    }
+  }
+  if (mine.get_bytes() > this->memory_budget / this->num_workers)
+    this->spill(mine);
+}
+
+// The group whose key is key's columns, added (with fresh accumulators) if there is none yet
+uint HashAggregate::find(Groups &mine, const Field *key, const std::vector<uint> &columns, u_int64_t hash) {
+  if (2 * (mine.size() + 1) > mine.slots.size()) {
+    size_t num_slots = std::max((size_t) 64, 2 * mine.slots.size());
+    mine.slots.assign(num_slots, NO_GROUP);
+    for (size_t group = 0; group < mine.size(); group++) {
+      size_t slot = mine.hashes[group] & (num_slots - 1);
+      while (mine.slots[slot] != NO_GROUP)
+        slot = (slot + 1) & (num_slots - 1);
+      mine.slots[slot] = (int32_t) group;
+    }
+  }
+
+  size_t mask = mine.slots.size() - 1;
+  size_t slot = hash & mask;
+  uint num_groups = (uint) columns.size();
+  for (; mine.slots[slot] != NO_GROUP; slot = (slot + 1) & mask) {
+    uint group = (uint) mine.slots[slot];
+    if (mine.hashes[group] != hash)
+      continue;
+    if (num_groups == 0)
+      return group;
+    const Field *found = mine.keys[group];
+    bool equal = true;
+    for (uint column = 0; column < num_groups && equal; column++) {
+      const Field &a = found[column];
+      const Field &b = key[columns[column]];
+      if (a.data_type == ColumnAttribute::INT)
+        equal = a.n == b.n;
+      else
+        equal = a.size == b.size && (a.size == 0 || std::memcmp(a.text, b.text, a.size) == 0);
+    }
+    if (equal)
+      return group;
+  }
+
+  Row key_row(num_groups);
+  for (uint column = 0; column < num_groups; column++)
+    key_row[column] = key[columns[column]];
+  mine.keys.add(key_row);
+  mine.hashes.push_back(hash);
+  for (auto const& aggregate: this->aggregates) {
+    mine.values.push_back(aggregate.function == VectorAggregate::MIN ? INT64_MAX :
+                          aggregate.function == VectorAggregate::MAX ? INT64_MIN : 0);
+    if (aggregate.function == VectorAggregate::AVG)
+      mine.values.push_back(0);
+  }
+  uint group = (uint) mine.size() - 1;
+  mine.slots[slot] = (int32_t) group;
+  return group;
+}
+
+// Fold one group's accumulators into another's
+void HashAggregate::combine(int64_t *into, const int64_t *from) const {
+  for (uint a = 0; a < this->aggregates.size(); a++) {
+    uint offset = this->offsets[a];
+    switch (this->aggregates[a].function) {
+      case VectorAggregate::MIN: into[offset] = std::min(into[offset], from[offset]); break;
+      case VectorAggregate::MAX: into[offset] = std::max(into[offset], from[offset]); break;
+      case VectorAggregate::AVG: into[offset] += from[offset]; into[offset + 1] += from[offset + 1]; break;
+      default: into[offset] += from[offset]; break;
+    }
+  }
+}
+
+void HashAggregate::merge(Groups &into, const Groups &from) {
+  for (size_t group = 0; group < from.size(); group++) {
+    const Field *key = this->groups.empty() ? nullptr : from.keys[group];
+    uint found = this->find(into, key, this->key_columns, from.hashes[group]);
+    this->combine(&into.values[found * this->width], &from.values[group * this->width]);
+  }
+}
+
+// Over budget (or done, once anyone has spilled): write the groups out, each to the
+// partition its hash picks, as its key followed by its accumulators in two INTs apiece
+void HashAggregate::spill(Groups &mine) {
+  if (mine.size() == 0)
+    return;
+  std::lock_guard<std::mutex> guard(this->spill_lock);
+  uint num_groups = (uint) this->groups.size();
+  if (this->partitions.empty()) {
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    for (uint column = 0; column < num_groups + 2 * this->width; column++) {
+      column_names.push_back("c" + std::to_string(column));
+      column_attributes.push_back(column < num_groups ? this->column_attributes[column]
+                                                      : ColumnAttribute(ColumnAttribute::INT));
+    }
+    std::string prefix = "_hash_aggregate_" + std::to_string(next_aggregate_id++) + "_";
+    for (uint p = 0; p < NUM_PARTITIONS; p++) {
+      HeapTable *table = new HeapTable(prefix + std::to_string(p), column_names, column_attributes);
+      try
+        {
+          table->create();
+        }
+      catch(...)
+        {
+          delete table;
+          throw;
+        }
+      this->partitions.push_back(table);
+    }
+  }
+
+  Row row(num_groups + 2 * this->width);
+  for (size_t group = 0; group < mine.size(); group++) {
+    for (uint column = 0; column < num_groups; column++)
+      row[column] = mine.keys[group][column];
+    for (uint i = 0; i < this->width; i++) {
+      u_int64_t value = (u_int64_t) mine.values[group * this->width + i];
+      row.set_int(num_groups + 2 * i, (int32_t) (u_int32_t) (value >> 32));
+      row.set_int(num_groups + 2 * i + 1, (int32_t) (u_int32_t) value);
+    }
+    this->partitions[(mine.hashes[group] >> 32) % NUM_PARTITIONS]->insert(row);
+  }
+  mine.clear();
+}
+
+// Merge the next partition's groups into partials[0], in place of what it had
+bool HashAggregate::next_partition() {
+  if (this->partition >= this->partitions.size())
+    return false;
+  Groups &groups = *this->partials[0];
+  groups.clear();
+  this->emitted = 0;
+
+  uint num_groups = (uint) this->groups.size();
+  std::vector<int64_t> values(this->width);
+  TableScan scan(*this->partitions[this->partition++]);
+  RowBatch batch;
+  scan.open();
+  while (scan.next(batch)) {
+    for (uint i = 0; i < batch.size(); i++) {
+      const Row &row = batch[i];
+      for (uint v = 0; v < this->width; v++)
+        values[v] = (int64_t) (((u_int64_t) (u_int32_t) row[num_groups + 2 * v].n << 32) |
+                               (u_int32_t) row[num_groups + 2 * v + 1].n);
+      uint group = this->find(groups, &row[0], this->key_columns, HashJoin::hash(row, this->key_columns));
+      this->combine(&groups.values[group * this->width], values.data());
+    }
+  }
+  scan.close();
+  return true;
+}
+
+void HashAggregate::drop_partitions() {
+  NoTransaction outside;
+  for (auto const& table: this->partitions) {
+    table->drop();
+    delete table;
+  }
+  this->partitions.clear();
+}
+
+
+// test function -- returns true if all tests pass
+bool test_hash_aggregate() {
+    ColumnNames column_names = {"k", "t", "v"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::INT)};
+    HeapTable table("_test_hash_aggregate", column_names, column_attributes);
+    table.create();
+    ValueDicts rows;
+    const int n = 6000, num_keys = 1500;
+    for (int i = 0; i < n; i++) {
+        ValueDict row;
+        row["k"] = Value(i % num_keys);
+        row["t"] = Value("group " + std::to_string(i % num_keys));
+        row["v"] = Value(i - n / 2);
+        rows.push_back(row);
+    }
+    delete table.insert_batch(&rows);
+
+    // group k (and t) has the rows v = k - n/2 + j*num_keys, j = 0..3
+    HashAggregate::Aggregates aggregates = {{VectorAggregate::COUNT, -1}, {VectorAggregate::SUM, 2},
+                                            {VectorAggregate::MIN, 2}, {VectorAggregate::MAX, 2},
+                                            {VectorAggregate::AVG, 2}};
+    ColumnNames names = {"k", "t", "count", "sum", "min", "max", "avg"};
+    auto check = [&](HashAggregate &aggregate, bool spills) {
+        RowBatch batch;
+        std::vector<bool> seen(num_keys, false);
+        uint count = 0;
+        bool ok = true;
+        aggregate.open();
+        while (aggregate.next(batch)) {
+            for (uint i = 0; i < batch.size(); i++) {
+                const Row &row = batch[i];
+                int k = row[0].n;
+                int low = k - n / 2;
+                int high = low + 3 * num_keys;
+                ok = ok && k >= 0 && k < num_keys && !seen[k] && row.value(1).s == "group " + std::to_string(k) &&
+                     row[2].n == 4 && row[3].n == 4 * low + 6 * num_keys && row[4].n == low && row[5].n == high &&
+                     row[6].n == (4 * low + 6 * num_keys) / 4;
+                if (k >= 0 && k < num_keys)
+                    seen[k] = true;
+            }
+            count += batch.size();
+        }
+        ok = ok && (aggregate.get_partitions() > 0) == spills && aggregate.get_groups() == (u_int64_t) num_keys;
+        aggregate.close();
+        return ok && count == (uint) num_keys;
+    };
+    HashAggregate serial(new TableScan(table), {0, 1}, aggregates, names);
+    HashAggregate parallel(table, Comparisons(), {0, 1}, aggregates, names, 4);
+    if (!check(serial, false) || !check(parallel, false))
+        return false;
+
+    // no groups: one row, even over no rows
+    HashAggregate total(table, {Comparison("v", Comparison::GE, Value(0))}, {}, {{VectorAggregate::COUNT, -1}},
+                        {"count"}, 2);
+    HashAggregate none(table, {Comparison("v", Comparison::GE, Value(n))}, {}, {{VectorAggregate::COUNT, -1}},
+                       {"count"}, 2);
+    RowBatch batch;
+    total.open();
+    if (!total.next(batch) || batch.size() != 1 || batch[0][0].n != n / 2 || total.next(batch))
+        return false;
+    none.open();
+    if (!none.next(batch) || batch.size() != 1 || batch[0][0].n != 0 || none.next(batch))
+        return false;
+    std::cout << "hash aggregate ok" << std::endl;
+
+    HashAggregate serial_spilled(new TableScan(table), {0, 1}, aggregates, names, 16 * 1024);
+    HashAggregate parallel_spilled(table, Comparisons(), {0, 1}, aggregates, names, 4, 64 * 1024);
+    if (!check(serial_spilled, true) || !check(parallel_spilled, true))
+        return false;
+    std::cout << "hash aggregate spilled ok" << std::endl;
+
+    table.drop();
+    return true;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file hash_aggregate.h - GROUP BY with COUNT, SUM, MIN, MAX, and AVG by hashing.
+ * HashAggregate: QueryOperator
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "storage_engine.h"
+#include "executor.h"
+#include "vector_executor.h"
+#include "heap_storage.h"
+
+/**
+ * @class HashAggregate - one row per distinct value of the group columns, with its aggregates
+ *
+ * Output rows are the group columns followed by one INT per aggregate, in no
+ * particular order. With no group columns there is one row (of zeros over no rows).
+ *
+ * Groups are kept in an open-addressing hash table (linear probing over an array
+ * of group numbers), with each group's key in a RowArena and its accumulators in a
+ * flat array of int64s, a fixed number per group: one for each aggregate, two for
+ * AVG (sum and count).
+ *
+ * Given a table rather than an input operator, the scan is split into morsels of
+ * HeapTable::MORSEL_BLOCKS blocks shared out among the workers (tasks on
+ * ThreadPool::shared()), each aggregating what it reads into a table of its own; the
+ * partial tables are then merged, so the workers never contend for a group.
+ *
+ * If a table grows past its share of the memory budget, its groups are written,
+ * with their accumulators, to NUM_PARTITIONS temporary HeapTables by hash, and the
+ * table starts over. The partitions are then merged one at a time, so no group is
+ * ever in memory twice. Temporary tables are written outside any open transaction
+ * and dropped by close().
+ *
+ * Methods:
+ * 	open()
+ * 	next(batch)
+ * 	close()
+ * Accessors:
+ * 	get_groups()
+ * 	get_partitions()
+ */
+class HashAggregate : public QueryOperator {
+public:
+    typedef VectorAggregate::Aggregate Aggregate;
+    typedef VectorAggregate::Aggregates Aggregates;
+
+    /**
+     * bytes of groups held in memory (across all workers) before spilling to disk
+     */
+    static const size_t MEMORY_BUDGET = 64 * 1024 * 1024;
+
+    /**
+     * number of partitions groups are split into when they spill
+     */
+    static const uint NUM_PARTITIONS = 32;
+
+    /**
+     * Aggregate rows from an input operator (on this thread).
+     * @param input          rows to aggregate (owned)
+     * @param groups         ordinals of input's columns to group by
+     * @param aggregates     over input's columns (INT ones, but for COUNT)
+     * @param names          one per group column, then one per aggregate
+     * @param memory_budget  bytes of groups to hold before spilling
+     */
+    HashAggregate(QueryOperator *input, const std::vector<uint> &groups, const Aggregates &aggregates,
+                  const ColumnNames &names, size_t memory_budget = MEMORY_BUDGET);
+
+    /**
+     * Aggregate a table's rows, scanning it with several workers.
+     * @param table          table to read (must outlive the aggregate and not change while open() runs)
+     * @param where          terms the rows must all pass
+     * @param groups         ordinals of table's columns to group by
+     * @param aggregates     over table's columns (INT ones, but for COUNT)
+     * @param names          one per group column, then one per aggregate
+     * @param num_workers    scan tasks to run at once; 0 for one per hardware thread
+     * @param memory_budget  bytes of groups to hold before spilling
+     */
+    HashAggregate(HeapTable &table, const Comparisons &where, const std::vector<uint> &groups,
+                  const Aggregates &aggregates, const ColumnNames &names, uint num_workers = 0,
+                  size_t memory_budget = MEMORY_BUDGET);
+
+    virtual ~HashAggregate();
+
+    /**
+     * @throws  DbRelationError if the input has a column of the wrong type
+     */
+    virtual void open();
+
+    /**
+     * @throws  DbRelationError if a result doesn't fit in an INT
+     */
+    virtual bool next(RowBatch &batch);
+
+    virtual void close();
+
+    /**
+     * Groups the last open() found (so far, if it spilled).
+     */
+    virtual u_int64_t get_groups() const { return groups_out; }
+
+    /**
+     * Partitions the last open() spilled into (0 if the groups fit in memory).
+     */
+    virtual uint get_partitions() const { return (uint) partitions.size(); }
+
+protected:
+    // one worker's groups: the hash table, keys, and accumulators
+    struct Groups {
+        uint width;                         // accumulators per group
+        RowArena keys;
+        std::vector<u_int64_t> hashes;      // per group
+        std::vector<int64_t> values;        // width per group
+        std::vector<int32_t> slots;         // group numbers, or -1; a power of two of them
+
+        Groups(uint key_width, uint width) : width(width), keys(key_width) {}
+
+        size_t size() const { return hashes.size(); }
+
+        size_t get_bytes() const {
+            return keys.get_bytes() + hashes.size() * sizeof(u_int64_t) + values.size() * sizeof(int64_t) +
+                   slots.size() * sizeof(int32_t);
+        }
+
+        void clear();
+    };
+
+    QueryOperator *input;       // or nullptr to scan table
+    HeapTable *table;
+    Comparisons where;
+    std::vector<uint> groups;
+    std::vector<uint> key_columns;  // 0 to the number of groups, for keys already pulled out of rows
+    Aggregates aggregates;
+    std::vector<uint> offsets;  // of each aggregate's accumulators
+    uint width;                 // accumulators per group
+    uint num_workers;
+    size_t memory_budget;
+
+    std::vector<std::unique_ptr<Groups>> partials;  // one per worker; partials[0] is what next() emits
+    std::vector<HeapTable *> partitions;
+    std::mutex spill_lock;      // workers spill one at a time
+    uint partition;             // next to load
+    size_t emitted;             // groups of partials[0] handed up so far
+    bool empty_emitted;         // the one row with no group columns over no rows
+    u_int64_t groups_out;
+
+    virtual void scan(Groups &mine, const RowFilter *filter, BlockID last, std::atomic<BlockID> &next_morsel);
+
+    virtual void accumulate(Groups &mine, const RowBatch &rows);
+
+    virtual uint find(Groups &mine, const Field *key, const std::vector<uint> &columns, u_int64_t hash);
+
+    virtual void combine(int64_t *into, const int64_t *from) const;
+
+    virtual void merge(Groups &into, const Groups &from);
+
+    virtual void spill(Groups &mine);
+
+    virtual bool next_partition();
+
+    virtual void drop_partitions();
+};
+
+bool test_hash_aggregate();
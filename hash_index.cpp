@@ -0,0 +1,548 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "hash_index.h"
+#include <cstring>
+#include <iostream>
+
+// Page record:
+//      u32 next, u8 key columns, u32 count, then count entries of
+//      u32 hash, u32 block id, u16 record id, key (see RowCodec::encode_key)
+
+static const u_int32_t PAGE_HEADER_SZ = 4 + 1 + 4;
+static const u_int32_t ENTRY_HEADER_SZ = 4 + 4 + 2;
+
+template<typename T>
+static void put_at(char *&at, T n) {
+  memcpy(at, &n, sizeof(n));
+  at += sizeof(n);
+}
+
+template<typename T>
+static T get_at(const char *&at) {
+  T n;
+  memcpy(&n, at, sizeof(n));
+  at += sizeof(n);
+  return n;
+}
+
+const double HashIndex::SPLIT_FILL = 0.75;
+
+HashIndex::HashIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique)
+        : DbIndex(relation, name, key_columns, unique), buckets(relation.get_table_name() + "-" + name),
+          overflow(relation.get_table_name() + "-" + name + "-overflow"), closed(true), generation(0)
+{
+  if (key_columns.empty() || key_columns.size() > DbIndex::MAX_COMPOSITE) {
+    throw DbRelationError("index " + name + " needs 1 to 32 key columns");
+  }
+  memset(&this->stat, 0, sizeof(this->stat));
+}
+
+HashIndex::~HashIndex() {
+  close();
+}
+
+void HashIndex::create() {
+  this->buckets.create();   // makes bucket 0's page
+  this->overflow.create();  // makes block 1, for the stats
+  this->closed = false;
+  for (u_int32_t bucket = 1; bucket < INITIAL_BUCKETS; bucket++) {
+    SlottedPage *block = this->buckets.get_new();
+    this->buckets.release(block);
+  }
+  Page empty;
+  empty.next = 0;
+  for (u_int32_t bucket = 0; bucket < INITIAL_BUCKETS; bucket++) {
+    empty.block_id = bucket + 1;
+    save(this->buckets, empty);
+  }
+  memset(&this->stat, 0, sizeof(this->stat));
+  save_stat();
+
+  // index the rows already in the relation
+  Handles *handles = this->relation.select();
+  try
+    {
+      for (auto const& handle: *handles)
+        insert(handle);
+    }
+  catch(...)
+    {
+      delete handles;
+      throw;
+    }
+  delete handles;
+}
+
+void HashIndex::drop() {
+  this->buckets.drop();
+  this->overflow.drop();
+  this->closed = true;
+}
+
+void HashIndex::open() {
+  u_int32_t generation = this->buckets.get_generation() + this->overflow.get_generation();
+  if (!this->closed && this->generation == generation)
+    return;
+  if (this->closed) {
+    this->buckets.open();
+    this->overflow.open();
+  }
+  SlottedPage *block = this->overflow.get(STAT);
+  RecordView record;
+  if (!block->view(1, record) || record.size != sizeof(this->stat)) {
+    this->overflow.release(block);
+    throw DbRelationError("index " + this->name + " has no state");
+  }
+  memcpy(&this->stat, record.data, sizeof(this->stat));
+  this->overflow.release(block);
+  this->generation = generation;
+  this->closed = false;
+}
+
+void HashIndex::close() {
+  if (this->closed)
+    return;
+  this->buckets.close();
+  this->overflow.close();
+  this->closed = true;
+}
+
+Handles* HashIndex::lookup(const ValueDict *key_values) {
+  open();
+  KeyValue key = tkey(key_values);
+  u_int32_t key_hash = hash(key);
+  Handles *handles = new Handles();
+  Page page;
+  load(this->buckets, bucket_of(key_hash) + 1, page);
+  while (true) {
+    for (auto const& entry: page.entries) {
+      if (entry.hash == key_hash && equal(entry.key, key))
+        handles->push_back(entry.handle);
+    }
+    if (page.next == 0)
+      return handles;
+    load(this->overflow, page.next, page);
+  }
+}
+
+void HashIndex::insert(Handle handle) {
+  open();
+  Entry entry;
+  entry.key = tkey(handle);
+  entry.hash = hash(entry.key);
+  entry.handle = handle;
+  // so that every page can always hold a few entries
+  if (entry_size(entry) > page_capacity() / 4)
+    throw DbRelationError("key too long for index " + this->name);
+  if (this->unique && contains(entry.key, entry.hash))
+    throw DbRelationError("duplicate key for unique index " + this->name);
+
+  add(bucket_of(entry.hash), entry);
+  this->stat.bytes += entry_size(entry);
+  while (this->stat.bytes > SPLIT_FILL * page_capacity() * get_num_buckets())
+    split();
+  save_stat();
+}
+
+void HashIndex::del(Handle handle) {
+  open();
+  KeyValue key = tkey(handle);
+  u_int32_t key_hash = hash(key);
+  Page page;
+  HeapFile *file = &this->buckets;
+  load(*file, bucket_of(key_hash) + 1, page);
+  while (true) {
+    for (auto entry = page.entries.begin(); entry != page.entries.end(); entry++) {
+      if (entry->handle == handle) {
+        this->stat.bytes -= entry_size(*entry);
+        page.entries.erase(entry);
+        save(*file, page);
+        save_stat();
+        return;
+      }
+    }
+    if (page.next == 0)
+      return;
+    file = &this->overflow;
+    load(*file, page.next, page);
+  }
+}
+
+// key values in key column order, from a dictionary that has at least those columns
+KeyValue HashIndex::tkey(const ValueDict *key_values) const {
+  KeyValue key;
+  for (auto const& column_name: this->key_columns) {
+    ValueDict::const_iterator value = key_values->find(column_name);
+    if (value == key_values->end())
+      throw DbRelationError("no value for key column " + column_name + " of index " + this->name);
+    key.push_back(value->second);
+  }
+  return key;
+}
+
+KeyValue HashIndex::tkey(Handle handle) {
+  ValueDict *row = this->relation.project(handle, &this->key_columns);
+  KeyValue key;
+  try
+    {
+      key = tkey(row);
+    }
+  catch(...)
+    {
+      delete row;
+      throw;
+    }
+  delete row;
+  return key;
+}
+
+// FNV-1a over the key's encoding
+u_int32_t HashIndex::hash(const KeyValue &key) {
+  std::vector<char> bytes(RowCodec::key_size(key));
+  char *at = bytes.data();
+  RowCodec::encode_key(key, at);
+  u_int32_t h = 2166136261u;
+  for (char c: bytes) {
+    h ^= (unsigned char) c;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+bool HashIndex::equal(const KeyValue &a, const KeyValue &b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].data_type != b[i].data_type)
+      return false;
+    if (a[i].data_type == ColumnAttribute::DataType::INT ? a[i].n != b[i].n : a[i].s != b[i].s)
+      return false;
+  }
+  return true;
+}
+
+u_int32_t HashIndex::entry_size(const Entry &entry) {
+  return ENTRY_HEADER_SZ + RowCodec::key_size(entry.key);
+}
+
+// buckets before the split pointer have already been split this round, so use the next round's modulus
+u_int32_t HashIndex::bucket_of(u_int32_t hash) const {
+  u_int32_t bucket = hash % (INITIAL_BUCKETS << this->stat.level);
+  if (bucket < this->stat.next_split)
+    bucket = hash % (INITIAL_BUCKETS << (this->stat.level + 1));
+  return bucket;
+}
+
+bool HashIndex::contains(const KeyValue &key, u_int32_t key_hash) {
+  Page page;
+  load(this->buckets, bucket_of(key_hash) + 1, page);
+  while (true) {
+    for (auto const& entry: page.entries) {
+      if (entry.hash == key_hash && equal(entry.key, key))
+        return true;
+    }
+    if (page.next == 0)
+      return false;
+    load(this->overflow, page.next, page);
+  }
+}
+
+// add to the first page of the bucket's chain with room, growing the chain if none has
+void HashIndex::add(u_int32_t bucket, const Entry &entry) {
+  u_int32_t size = entry_size(entry);
+  Page page;
+  HeapFile *file = &this->buckets;
+  load(*file, bucket + 1, page);
+  while (encoded_size(page) + size > page_capacity()) {
+    if (page.next == 0) {
+      page.next = new_overflow();
+      save(*file, page);
+      Page tail;
+      tail.block_id = page.next;
+      tail.next = 0;
+      tail.entries.push_back(entry);
+      save(this->overflow, tail);
+      return;
+    }
+    file = &this->overflow;
+    load(*file, page.next, page);
+  }
+  page.entries.push_back(entry);
+  save(*file, page);
+}
+
+// split the bucket at the split pointer into itself and its image one round up
+void HashIndex::split() {
+  u_int32_t bucket = this->stat.next_split;
+  u_int32_t image = bucket + (INITIAL_BUCKETS << this->stat.level);
+
+  // take the whole chain apart, giving its overflow pages back for reuse
+  std::vector<Entry> entries;
+  Page page;
+  load(this->buckets, bucket + 1, page);
+  entries.insert(entries.end(), page.entries.begin(), page.entries.end());
+  BlockID next = page.next;
+  while (next != 0) {
+    load(this->overflow, next, page);
+    entries.insert(entries.end(), page.entries.begin(), page.entries.end());
+    BlockID freed = next;
+    next = page.next;
+    page.block_id = freed;
+    page.next = this->stat.free_overflow;
+    page.entries.clear();
+    save(this->overflow, page);
+    this->stat.free_overflow = freed;
+  }
+
+  // the image's block may already be there, added by a split that was rolled back
+  if (this->buckets.get_last_block_id() < image + 1) {
+    SlottedPage *block = this->buckets.get_new();
+    BlockID image_block = block->get_block_id();
+    this->buckets.release(block);
+    if (image_block != image + 1)
+      throw DbRelationError("index " + this->name + " bucket file is out of step");
+  }
+
+  std::vector<Entry> stay;
+  std::vector<Entry> move;
+  u_int32_t modulus = INITIAL_BUCKETS << (this->stat.level + 1);
+  for (auto const& entry: entries)
+    (entry.hash % modulus == bucket ? stay : move).push_back(entry);
+  write_chain(bucket + 1, stay);
+  write_chain(image + 1, move);
+
+  this->stat.next_split++;
+  if (this->stat.next_split == (INITIAL_BUCKETS << this->stat.level)) {
+    this->stat.level++;
+    this->stat.next_split = 0;
+  }
+}
+
+// rewrite a bucket's chain from scratch with the given entries
+void HashIndex::write_chain(BlockID primary, const std::vector<Entry> &entries) {
+  Page page;
+  page.block_id = primary;
+  page.next = 0;
+  HeapFile *file = &this->buckets;
+  for (auto const& entry: entries) {
+    if (encoded_size(page) + entry_size(entry) > page_capacity()) {
+      page.next = new_overflow();
+      save(*file, page);
+      file = &this->overflow;
+      page.block_id = page.next;
+      page.next = 0;
+      page.entries.clear();
+    }
+    page.entries.push_back(entry);
+  }
+  save(*file, page);
+}
+
+BlockID HashIndex::new_overflow() {
+  if (this->stat.free_overflow != 0) {
+    BlockID block_id = this->stat.free_overflow;
+    Page page;
+    load(this->overflow, block_id, page);
+    this->stat.free_overflow = page.next;
+    return block_id;
+  }
+  SlottedPage *block = this->overflow.get_new();
+  BlockID block_id = block->get_block_id();
+  this->overflow.release(block);
+  return block_id;
+}
+
+void HashIndex::load(HeapFile &file, BlockID block_id, Page &page) {
+  SlottedPage *block = file.get(block_id);
+  RecordView record;
+  if (!block->view(1, record)) {
+    file.release(block);
+    throw DbRelationError("index " + this->name + " is missing page " + std::to_string(block_id));
+  }
+  const char *at = record.data;
+  page.block_id = block_id;
+  page.next = get_at<u_int32_t>(at);
+  u_int8_t num_columns = get_at<u_int8_t>(at);
+  u_int32_t count = get_at<u_int32_t>(at);
+  page.entries.clear();
+  page.entries.resize(count);
+  for (auto &entry: page.entries) {
+    entry.hash = get_at<u_int32_t>(at);
+    entry.handle.first = get_at<u_int32_t>(at);
+    entry.handle.second = get_at<u_int16_t>(at);
+    RowCodec::decode_key(at, num_columns, entry.key);
+  }
+  file.release(block);
+}
+
+void HashIndex::save(HeapFile &file, const Page &page) {
+  std::vector<char> bytes(encoded_size(page));
+  char *at = bytes.data();
+  put_at<u_int32_t>(at, page.next);
+  put_at<u_int8_t>(at, (u_int8_t) this->key_columns.size());
+  put_at<u_int32_t>(at, (u_int32_t) page.entries.size());
+  for (auto const& entry: page.entries) {
+    put_at<u_int32_t>(at, entry.hash);
+    put_at<u_int32_t>(at, entry.handle.first);
+    put_at<u_int16_t>(at, entry.handle.second);
+    RowCodec::encode_key(entry.key, at);
+  }
+
+  Dbt data(bytes.data(), (u_int32_t) bytes.size());
+  SlottedPage *block = file.get(page.block_id);
+  try
+    {
+      RecordView record;
+      if (block->view(1, record))
+        block->put(1, data);
+      else
+        block->add(&data);
+    }
+  catch(...)
+    {
+      file.release(block);
+      throw;
+    }
+  file.put(block);
+  file.release(block);
+}
+
+u_int32_t HashIndex::encoded_size(const Page &page) const {
+  u_int32_t size = PAGE_HEADER_SZ;
+  for (auto const& entry: page.entries)
+    size += entry_size(entry);
+  return size;
+}
+
+void HashIndex::save_stat() {
+  Dbt data(&this->stat, sizeof(this->stat));
+  SlottedPage *block = this->overflow.get(STAT);
+  RecordView record;
+  if (block->view(1, record))
+    block->put(1, data);
+  else
+    block->add(&data);
+  this->overflow.put(block);
+  this->overflow.release(block);
+}
+
+// room for one record in an otherwise empty SlottedPage (its header plus one slot)
+u_int32_t HashIndex::page_capacity() {
+  return this->buckets.get_block_size() - 16;
+}
+
+
+// test function -- returns true if all tests pass
+bool test_hash_index() {
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_test_hash_index_cpp", column_names, column_attributes);
+    table.create();
+    ValueDicts rows;
+    for (int i = 0; i < 5000; i++) {
+        ValueDict row;
+        row["a"] = Value(i);
+        row["b"] = Value("b" + std::to_string(i % 100));
+        rows.push_back(row);
+    }
+    delete table.insert_batch(&rows);
+
+    HashIndex index(table, "fooindex", ColumnNames{"a"}, true);
+    index.create();
+    HashIndex by_b(table, "barindex", ColumnNames{"b"}, false);
+    by_b.create();
+    table.add_index(&index);
+    table.add_index(&by_b);
+    std::cout << "create hash index ok, " << index.get_num_buckets() << " buckets" << std::endl;
+    if (index.get_num_buckets() <= HashIndex::INITIAL_BUCKETS)
+        return false;
+
+    ValueDict key;
+    for (int i = 0; i < 5000; i += 7) {
+        key["a"] = Value(i);
+        Handles *handles = index.lookup(&key);
+        bool ok = handles->size() == 1;
+        if (ok) {
+            ValueDict *row = table.project((*handles)[0]);
+            ok = (*row)["a"].n == i;
+            delete row;
+        }
+        delete handles;
+        if (!ok)
+            return false;
+    }
+    key["a"] = Value(6000);
+    Handles *handles = index.lookup(&key);
+    bool missing = handles->empty();
+    delete handles;
+    if (!missing)
+        return false;
+    ValueDict b_key;
+    b_key["b"] = Value("b42");
+    handles = by_b.lookup(&b_key);
+    bool duplicates = handles->size() == 50;
+    delete handles;
+    if (!duplicates)
+        return false;
+    std::cout << "hash lookup ok" << std::endl;
+
+    // select(where) goes through the index and agrees with a scan
+    Comparisons scan_where = {Comparison("b", Comparison::EQ, Value("b42"))};
+    Handles *scanned = table.select(&scan_where);
+    handles = table.select(&b_key);
+    bool same = *handles == *scanned;
+    delete handles;
+    delete scanned;
+    if (!same)
+        return false;
+    std::cout << "select through hash index ok" << std::endl;
+
+    // the index follows the table
+    ValueDict row;
+    row["a"] = Value(-1);
+    row["b"] = Value("new");
+    Handle added = table.insert(&row);
+    try {
+        table.insert(&row);
+        return false;
+    } catch (DbRelationError const&) {
+    }
+    key["a"] = Value(-1);
+    handles = index.lookup(&key);
+    bool follows = handles->size() == 1 && (*handles)[0] == added;
+    delete handles;
+    ValueDict change;
+    change["a"] = Value(-2);
+    table.update(added, &change);
+    handles = index.lookup(&key);
+    follows = follows && handles->empty();
+    delete handles;
+    table.del(added);
+    key["a"] = Value(-2);
+    handles = index.lookup(&key);
+    follows = follows && handles->empty();
+    delete handles;
+    Handles *all = table.select();
+    follows = follows && all->size() == 5000;
+    delete all;
+    if (!follows)
+        return false;
+    std::cout << "hash insert/update/del ok" << std::endl;
+
+    // reopened from its files
+    table.remove_index(&by_b);
+    table.remove_index(&index);
+    index.close();
+    key["a"] = Value(4321);
+    handles = index.lookup(&key);
+    bool reopened = handles->size() == 1;
+    delete handles;
+    if (!reopened)
+        return false;
+
+    by_b.drop();
+    index.drop();
+    table.drop();
+    return true;
+}
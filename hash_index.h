@@ -0,0 +1,137 @@
+/**
+ * @file hash_index.h - Linear hashing implementation of DbIndex.
+ * HashIndex
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "heap_storage.h"
+
+/**
+ * @class HashIndex - equality-only index on a DbRelation, using linear hashing
+ *
+ * Bucket b's primary page is block b+1 of one HeapFile (<table>-<index>); pages that
+ * overflow chain into a second HeapFile (<table>-<index>-overflow), whose block 1
+ * holds the index's state. As with BTreeIndex, each page is the single record of
+ * its block and goes through the buffer pool.
+ *
+ * The table starts with INITIAL_BUCKETS buckets and grows one bucket at a time:
+ * whenever the entries would fill more than SPLIT_FILL of the buckets' primary
+ * pages, the bucket at the split pointer is split in two. So chains stay short
+ * and a lookup is about one page read, without ever rehashing the whole index.
+ * Entries carry their key's hash, so splits and lookups compare keys only on a
+ * hash match. Deletes just remove the entry. If a rollback touches either file, the
+ * state is read again.
+ *
+ * Methods:
+ * 	create()
+ * 	drop()
+ * 	open()
+ * 	close()
+ * 	lookup(key_values)
+ * 	insert(handle)
+ * 	del(handle)
+ */
+class HashIndex : public DbIndex {
+public:
+    static const u_int32_t INITIAL_BUCKETS = 4;
+
+    HashIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique);
+
+    virtual ~HashIndex();
+
+    HashIndex(const HashIndex &other) = delete;
+
+    HashIndex(HashIndex &&temp) = delete;
+
+    HashIndex &operator=(const HashIndex &other) = delete;
+
+    HashIndex &operator=(HashIndex &&temp) = delete;
+
+    virtual void create();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual Handles *lookup(const ValueDict *key_values);
+
+    virtual void insert(Handle handle);
+
+    virtual void del(Handle handle);
+
+    virtual bool is_ordered() const { return false; }
+
+    virtual u_int32_t get_num_buckets() const { return (INITIAL_BUCKETS << stat.level) + stat.next_split; }
+
+protected:
+    static const BlockID STAT = 1;
+    static const double SPLIT_FILL;
+
+    struct Entry {
+        u_int32_t hash;
+        Handle handle;
+        KeyValue key;
+    };
+
+    // one page of a bucket's chain
+    struct Page {
+        BlockID block_id;
+        BlockID next;  // next page of the chain in the overflow file, 0 at the end
+        std::vector<Entry> entries;
+    };
+
+    struct Stat {
+        u_int32_t level;          // buckets at the start of this round: INITIAL_BUCKETS << level
+        u_int32_t next_split;     // next bucket to split
+        u_int32_t free_overflow;  // head of the list of unused overflow pages, 0 if none
+        u_int32_t padding;
+        u_int64_t bytes;          // encoded size of all entries
+    };
+
+    HeapFile buckets;
+    HeapFile overflow;
+    bool closed;
+    Stat stat;
+    u_int32_t generation;   // the files' generations when stat was read
+
+    virtual KeyValue tkey(const ValueDict *key_values) const;
+
+    virtual KeyValue tkey(Handle handle);
+
+    static u_int32_t hash(const KeyValue &key);
+
+    static bool equal(const KeyValue &a, const KeyValue &b);
+
+    static u_int32_t entry_size(const Entry &entry);
+
+    virtual u_int32_t bucket_of(u_int32_t hash) const;
+
+    virtual bool contains(const KeyValue &key, u_int32_t hash);
+
+    virtual void add(u_int32_t bucket, const Entry &entry);
+
+    virtual void split();
+
+    virtual void write_chain(BlockID primary, const std::vector<Entry> &entries);
+
+    virtual BlockID new_overflow();
+
+    virtual void load(HeapFile &file, BlockID block_id, Page &page);
+
+    virtual void save(HeapFile &file, const Page &page);
+
+    virtual u_int32_t encoded_size(const Page &page) const;
+
+    virtual void save_stat();
+
+    virtual u_int32_t page_capacity();
+};
+
+bool test_hash_index();
@@ -0,0 +1,485 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "hash_join.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include "transaction.h"
+
+// memory a build row takes besides its Fields and TEXT: hash, chain link, two buckets
+static const size_t PER_ROW = sizeof(u_int64_t) + 3 * sizeof(int32_t);
+
+// chain and bucket marker for no row, and match's marker for a probe row not yet looked up
+static const int32_t NO_ROW = -1;
+static const int32_t NOT_LOOKED_UP = -2;
+
+// numbers temporary partition tables so concurrent joins don't collide
+static std::atomic<u_int32_t> next_join_id(0);
+
+// each split picks among NUM_PARTITIONS with the next this many bits of the hash's high half
+static const uint PARTITION_BITS = 5;
+static const uint MAX_LEVELS = 32 / PARTITION_BITS;
+
+static ColumnNames concat(const ColumnNames &a, const ColumnNames &b) {
+  ColumnNames both = a;
+  both.insert(both.end(), b.begin(), b.end());
+  return both;
+}
+
+static ColumnAttributes concat(const ColumnAttributes &a, const ColumnAttributes &b) {
+  ColumnAttributes both = a;
+  both.insert(both.end(), b.begin(), b.end());
+  return both;
+}
+
+HashJoin::HashJoin(QueryOperator *left, QueryOperator *right, const std::vector<uint> &left_keys,
+                   const std::vector<uint> &right_keys, bool build_left, size_t memory_budget)
+        : QueryOperator(concat(left->get_column_names(), right->get_column_names()),
+                        concat(left->get_column_attributes(), right->get_column_attributes())),
+          build_input(build_left ? left : right), probe_input(build_left ? right : left),
+          build_keys(build_left ? left_keys : right_keys), probe_keys(build_left ? right_keys : left_keys),
+          build_left(build_left), memory_budget(memory_budget),
+          partition(0), partition_scan(nullptr), probe(nullptr), probe_at(0), probe_hash(0), match(NOT_LOOKED_UP)
+{
+  this->build_width = (uint) this->build_input->get_column_attributes().size();
+  this->probe_width = (uint) this->probe_input->get_column_attributes().size();
+  this->build_rows.set_width(this->build_width);
+}
+
+HashJoin::~HashJoin() {
+  close();
+  delete this->build_input;
+  delete this->probe_input;
+}
+
+void HashJoin::open() {
+  close();
+  NoTransaction outside;
+  RowBatch batch;
+  this->build_input->open();
+  while (this->build_input->next(batch)) {
+    for (uint i = 0; i < batch.size(); i++) {
+      const Row &row = batch[i];
+      u_int64_t h = hash(row, this->build_keys);
+      if (this->partitions.empty()) {
+        this->add(row, h);
+        if (this->over_budget())
+          this->spill();
+      } else {
+        this->partition_build(0, row, h);
+      }
+    }
+  }
+  this->build_input->close();
+
+  this->probe_input->open();
+  if (this->partitions.empty()) {
+    this->build();
+    if (!this->hashes.empty())
+      this->probe = this->probe_input;
+  } else {
+    while (this->probe_input->next(batch))
+      for (uint i = 0; i < batch.size(); i++)
+        this->partition_probe(0, batch[i], hash(batch[i], this->probe_keys));
+    this->probe_input->close();
+    this->partition = 0;
+    this->next_partition();
+  }
+  this->probe_rows.clear();
+  this->probe_at = 0;
+  this->match = NOT_LOOKED_UP;
+}
+
+bool HashJoin::next(RowBatch &batch) {
+  batch.clear();
+  while (this->probe != nullptr) {
+    if (this->probe_at >= this->probe_rows.size()) {
+      if (!batch.empty())
+        return true;  // its rows point into probe_rows, so refill that next call
+      if (this->probe->next(this->probe_rows)) {
+        this->probe_at = 0;
+        this->match = NOT_LOOKED_UP;
+      } else {
+        this->probe_rows.clear();
+        this->probe_at = 0;
+        if (this->partitions.empty() || !this->next_partition())
+          this->probe = nullptr;
+      }
+      continue;
+    }
+
+    const Row &row = this->probe_rows[this->probe_at];
+    if (this->match == NOT_LOOKED_UP) {
+      this->probe_hash = hash(row, this->probe_keys);
+      this->match = this->buckets[this->probe_hash & (this->buckets.size() - 1)];
+    }
+    while (this->match != NO_ROW) {
+      int32_t found = this->match;
+      this->match = this->chain[found];
+      const Field *build_row = this->build_rows[(size_t) found];
+      if (this->hashes[found] != this->probe_hash || !this->keys_equal(build_row, row))
+        continue;
+      Row &out = batch.add();
+      out.resize(this->build_width + this->probe_width);
+      uint at = 0;
+      if (this->build_left) {
+        for (uint column = 0; column < this->build_width; column++)
+          out[at++] = build_row[column];
+      }
+      for (uint column = 0; column < this->probe_width; column++)
+        out[at++] = row[column];
+      if (!this->build_left) {
+        for (uint column = 0; column < this->build_width; column++)
+          out[at++] = build_row[column];
+      }
+      if (batch.full())
+        return true;
+    }
+    this->probe_at++;
+    this->match = NOT_LOOKED_UP;
+  }
+  return !batch.empty();
+}
+
+void HashJoin::close() {
+  delete this->partition_scan;
+  this->partition_scan = nullptr;
+  this->probe = nullptr;
+  this->build_input->close();
+  this->probe_input->close();
+  this->drop_partitions();
+  this->clear();
+  this->probe_rows.clear();
+  this->probe_at = 0;
+}
+
+// FNV-1a over the key columns, then mixed so the high bits (which pick the partition)
+// are as good as the low ones (which pick the bucket)
+u_int64_t HashJoin::hash(const Row &row, const std::vector<uint> &keys) {
+  u_int64_t h = 14695981039346656037ULL;
+  for (auto const& key: keys) {
+    const Field &field = row[key];
+    const unsigned char *bytes;
+    size_t size;
+    if (field.data_type == ColumnAttribute::INT) {
+      bytes = (const unsigned char *) &field.n;
+      size = sizeof(field.n);
+    } else {
+      bytes = (const unsigned char *) field.text;
+      size = field.size;
+      h = (h ^ size) * 1099511628211ULL;
+    }
+    for (size_t i = 0; i < size; i++)
+      h = (h ^ bytes[i]) * 1099511628211ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+bool HashJoin::keys_equal(const Field *build_row, const Row &probe_row) const {
+  for (uint i = 0; i < this->build_keys.size(); i++) {
+    const Field &a = build_row[this->build_keys[i]];
+    const Field &b = probe_row[this->probe_keys[i]];
+    if (a.data_type == ColumnAttribute::INT) {
+      if (a.n != b.n)
+        return false;
+    } else if (a.size != b.size || (a.size > 0 && std::memcmp(a.text, b.text, a.size) != 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Add a build row to the table; build() links it in
+void HashJoin::add(const Row &row, u_int64_t hash) {
+  this->build_rows.add(row);
+  this->hashes.push_back(hash);
+}
+
+// Link the rows added into chains, twice as many buckets as rows
+void HashJoin::build() {
+  size_t num_rows = this->hashes.size();
+  size_t num_buckets = 16;
+  while (num_buckets < 2 * num_rows)
+    num_buckets *= 2;
+  this->buckets.assign(num_buckets, NO_ROW);
+  this->chain.assign(num_rows, NO_ROW);
+  // backwards, so each chain runs in the order the rows came in
+  for (size_t i = num_rows; i-- > 0;) {
+    size_t bucket = this->hashes[i] & (num_buckets - 1);
+    this->chain[i] = this->buckets[bucket];
+    this->buckets[bucket] = (int32_t) i;
+  }
+}
+
+void HashJoin::clear() {
+  this->build_rows.clear();
+  this->hashes.clear();
+  this->chain.clear();
+  this->buckets.clear();
+}
+
+static HeapTable *partition_table(const std::string &name, const ColumnAttributes &column_attributes) {
+  ColumnNames column_names;
+  for (uint column = 0; column < column_attributes.size(); column++)
+    column_names.push_back("c" + std::to_string(column));
+  HeapTable *table = new HeapTable(name, column_names, column_attributes);
+  try
+    {
+      table->create();
+    }
+  catch(...)
+    {
+      delete table;
+      throw;
+    }
+  return table;
+}
+
+bool HashJoin::over_budget() const {
+  return this->build_rows.get_bytes() + this->hashes.size() * PER_ROW > this->memory_budget;
+}
+
+// Over budget: make the partitions and move what is in memory so far into them
+void HashJoin::spill() {
+  uint first = this->make_partitions(0);
+  Row row(this->build_width);
+  for (size_t i = 0; i < this->hashes.size(); i++) {
+    for (uint column = 0; column < this->build_width; column++)
+      row[column] = this->build_rows[i][column];
+    this->partition_build(first, row, this->hashes[i]);
+  }
+  this->clear();
+}
+
+// Add NUM_PARTITIONS empty partitions picked by the hash bits for level; returns the first
+uint HashJoin::make_partitions(uint level) {
+  std::string prefix = "_hash_join_" + std::to_string(next_join_id++) + "_";
+  uint first = (uint) this->partitions.size();
+  for (uint p = 0; p < NUM_PARTITIONS; p++) {
+    Partition empty = {nullptr, nullptr, 0, level};
+    this->partitions.push_back(empty);
+    Partition &made = this->partitions.back();
+    made.build = partition_table(prefix + "build_" + std::to_string(p), this->build_input->get_column_attributes());
+    made.probe = partition_table(prefix + "probe_" + std::to_string(p), this->probe_input->get_column_attributes());
+  }
+  return first;
+}
+
+// Which of the NUM_PARTITIONS starting at first a hash goes to
+uint HashJoin::pick(uint first, u_int64_t hash) const {
+  uint level = this->partitions[first].level;
+  return first + (uint) ((hash >> (32 + PARTITION_BITS * level)) % NUM_PARTITIONS);
+}
+
+void HashJoin::partition_build(uint first, const Row &row, u_int64_t hash) {
+  Partition &to = this->partitions[this->pick(first, hash)];
+  to.build->insert(row);
+  to.build_count++;
+}
+
+// A probe row goes to the partition its build rows went to (unless that has none)
+void HashJoin::partition_probe(uint first, const Row &row, u_int64_t hash) {
+  Partition &to = this->partitions[this->pick(first, hash)];
+  if (to.build_count > 0)
+    to.probe->insert(row);
+}
+
+// Read a partition's build rows into the table; false (and nothing read) if they go over
+// the budget and it can be split further
+bool HashJoin::load(uint p) {
+  bool splittable = this->partitions[p].level + 1 < MAX_LEVELS;
+  bool mixed = false;  // two build rows with different hashes, so a split would separate them
+  TableScan scan(*this->partitions[p].build);
+  RowBatch batch;
+  scan.open();
+  while (scan.next(batch)) {
+    for (uint i = 0; i < batch.size(); i++) {
+      u_int64_t h = hash(batch[i], this->build_keys);
+      mixed = mixed || (!this->hashes.empty() && h != this->hashes[0]);
+      this->add(batch[i], h);
+      if (splittable && mixed && this->over_budget()) {
+        scan.close();
+        this->clear();
+        return false;
+      }
+    }
+  }
+  scan.close();
+  return true;
+}
+
+// Split an over-budget partition on the next bits of the hash, and drop it
+void HashJoin::split(uint p) {
+  NoTransaction outside;
+  Partition parent = this->partitions[p];
+  uint first = this->make_partitions(parent.level + 1);
+  RowBatch batch;
+  TableScan build_scan(*parent.build);
+  build_scan.open();
+  while (build_scan.next(batch))
+    for (uint i = 0; i < batch.size(); i++)
+      this->partition_build(first, batch[i], hash(batch[i], this->build_keys));
+  build_scan.close();
+  TableScan probe_scan(*parent.probe);
+  probe_scan.open();
+  while (probe_scan.next(batch))
+    for (uint i = 0; i < batch.size(); i++)
+      this->partition_probe(first, batch[i], hash(batch[i], this->probe_keys));
+  probe_scan.close();
+
+  for (auto table: {parent.build, parent.probe}) {
+    table->drop();
+    delete table;
+  }
+  this->partitions[p].build = this->partitions[p].probe = nullptr;
+  this->partitions[p].build_count = 0;
+}
+
+// Load the next partition with build rows into the table and start on its probe rows
+bool HashJoin::next_partition() {
+  delete this->partition_scan;
+  this->partition_scan = nullptr;
+  this->probe = nullptr;
+  this->clear();
+  for (;;) {
+    while (this->partition < this->partitions.size() && this->partitions[this->partition].build_count == 0)
+      this->partition++;
+    if (this->partition == this->partitions.size())
+      return false;
+    if (this->load(this->partition))
+      break;
+    this->split(this->partition++);
+  }
+  this->build();
+
+  this->partition_scan = new TableScan(*this->partitions[this->partition].probe);
+  this->partition_scan->open();
+  this->probe = this->partition_scan;
+  this->partition++;
+  return true;
+}
+
+void HashJoin::drop_partitions() {
+  NoTransaction outside;
+  for (auto const& spilled: this->partitions) {
+    for (auto table: {spilled.build, spilled.probe}) {
+      if (table != nullptr) {
+        table->drop();
+        delete table;
+      }
+    }
+  }
+  this->partitions.clear();
+}
+
+// test function -- returns true if all tests pass
+bool test_hash_join() {
+    ColumnNames left_names = {"id", "name"};
+    ColumnAttributes left_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable left("_test_hash_join_left", left_names, left_attributes);
+    left.create();
+    ValueDicts rows;
+    for (int i = 0; i < 2000; i++) {
+        ValueDict row;
+        row["id"] = Value(i);
+        row["name"] = Value("n" + std::to_string(i));
+        rows.push_back(row);
+    }
+    delete left.insert_batch(&rows);
+
+    ColumnNames right_names = {"lid", "t", "v"};
+    ColumnAttributes right_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                         ColumnAttribute(ColumnAttribute::INT)};
+    HeapTable right("_test_hash_join_right", right_names, right_attributes);
+    right.create();
+    rows.clear();
+    for (int i = 0; i < 3000; i++) {
+        ValueDict row;
+        row["lid"] = Value(i % 1500);
+        row["t"] = Value("n" + std::to_string(i % 1500));
+        row["v"] = Value(i);
+        rows.push_back(row);
+    }
+    delete right.insert_batch(&rows);
+
+    // every right row matches exactly one left row
+    uint spilled = 0;
+    auto check = [&](const std::vector<uint> &left_keys, const std::vector<uint> &right_keys, bool build_left,
+                     size_t budget) {
+        HashJoin join(new TableScan(left), new TableScan(right), left_keys, right_keys, build_left, budget);
+        if (join.get_column_names().size() != 5)
+            return false;
+        RowBatch batch;
+        uint count = 0;
+        int64_t sum = 0;
+        bool ok = true;
+        join.open();
+        while (join.next(batch)) {
+            for (uint i = 0; i < batch.size(); i++) {
+                ok = ok && batch[i][0].n == batch[i][2].n && batch[i].value(1).s == batch[i].value(3).s &&
+                     batch[i].value(1).s == "n" + std::to_string(batch[i][0].n);
+                sum += batch[i][4].n;
+            }
+            count += batch.size();
+        }
+        spilled = join.get_partitions();
+        join.close();
+        return ok && count == 3000 && sum == 2999 * 3000 / 2;
+    };
+    if (!check({0}, {0}, false, HashJoin::MEMORY_BUDGET) || spilled != 0 ||
+        !check({0, 1}, {0, 1}, true, HashJoin::MEMORY_BUDGET) || spilled != 0)
+        return false;
+    std::cout << "hash join ok" << std::endl;
+    // (TEXT is held in 64K chunks, so even a partition of a few rows takes that much)
+    if (!check({1}, {1}, true, 96 * 1024) || spilled != HashJoin::NUM_PARTITIONS ||
+        !check({0}, {0}, false, 96 * 1024) || spilled != HashJoin::NUM_PARTITIONS)
+        return false;
+    std::cout << "hash join spilled ok" << std::endl;
+    // partitions still over the budget are split again
+    if (!check({1}, {1}, true, 65 * 1024) || spilled <= HashJoin::NUM_PARTITIONS ||
+        !check({0}, {0}, false, 65 * 1024) || spilled <= HashJoin::NUM_PARTITIONS)
+        return false;
+
+    // skewed build side: one hot key among many cold ones
+    HeapTable skewed("_test_hash_join_skewed", right_names, right_attributes);
+    skewed.create();
+    rows.clear();
+    for (int i = 0; i < 4000; i++) {
+        ValueDict row;
+        row["lid"] = Value(i < 3000 ? 0 : i - 2999);
+        row["t"] = Value("s");
+        row["v"] = Value(i);
+        rows.push_back(row);
+    }
+    delete skewed.insert_batch(&rows);
+    {
+        HashJoin join(new TableScan(left), new TableScan(skewed), {0}, {0}, false, 96 * 1024);
+        RowBatch batch;
+        uint count = 0;
+        int64_t sum = 0;
+        bool ok = true;
+        join.open();
+        while (join.next(batch)) {
+            for (uint i = 0; i < batch.size(); i++) {
+                ok = ok && batch[i][0].n == batch[i][2].n;
+                sum += batch[i][4].n;
+            }
+            count += batch.size();
+        }
+        ok = ok && count == 4000 && sum == 3999 * 4000 / 2 && join.get_partitions() > HashJoin::NUM_PARTITIONS;
+        join.close();
+        skewed.drop();
+        if (!ok)
+            return false;
+    }
+    std::cout << "hash join split ok" << std::endl;
+
+    left.drop();
+    right.drop();
+    return true;
+}
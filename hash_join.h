@@ -0,0 +1,147 @@
+/**
+ * @file hash_join.h - Equi-join of two query operators by hashing.
+ * HashJoin: QueryOperator
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "executor.h"
+#include "heap_storage.h"
+
+/**
+ * @class HashJoin - rows of left and right whose key columns are equal (inner join)
+ *
+ * open() reads all of the build input (the smaller one) into an in-memory hash
+ * table: the rows in a RowArena, and a bucket array with a chain of row numbers
+ * per bucket. next() then streams the
+ * probe input through it, so each input is read once.
+ *
+ * If the build input grows past the memory budget, the join goes grace-hash: both
+ * inputs are split by key hash into NUM_PARTITIONS temporary HeapTables, and each
+ * pair of partitions is then joined in memory in turn. Temporary tables are written
+ * outside any open transaction and dropped by close(). A partition still over the
+ * budget is split again the same way on the next bits of the hash, as many times as
+ * the hash's high half allows; one whose build rows all hash the same (one hot key)
+ * is joined in memory regardless.
+ *
+ * Output rows are left's columns followed by right's, whichever side is built.
+ *
+ * Methods:
+ * 	open()
+ * 	next(batch)
+ * 	close()
+ * 	hash(row, keys)
+ * Accessors:
+ * 	get_partitions()
+ */
+class HashJoin : public QueryOperator {
+public:
+    /**
+     * bytes of build rows held in memory before the join spills to disk
+     */
+    static const size_t MEMORY_BUDGET = 64 * 1024 * 1024;
+
+    /**
+     * number of partitions each input is split into when it spills
+     */
+    static const uint NUM_PARTITIONS = 32;
+
+    /**
+     * @param left           left input (owned)
+     * @param right          right input (owned)
+     * @param left_keys      ordinals of left's key columns
+     * @param right_keys     ordinals of right's key columns, each the same type as left's
+     * @param build_left     true to build the hash table from left rather than right
+     * @param memory_budget  bytes the build side may take before spilling
+     */
+    HashJoin(QueryOperator *left, QueryOperator *right, const std::vector<uint> &left_keys,
+             const std::vector<uint> &right_keys, bool build_left = false, size_t memory_budget = MEMORY_BUDGET);
+
+    virtual ~HashJoin();
+
+    virtual void open();
+
+    virtual bool next(RowBatch &batch);
+
+    virtual void close();
+
+    /**
+     * Partitions the last open() spilled into, those split again and the ones they were
+     * split into all counted (0 if the build side fit in memory).
+     */
+    virtual uint get_partitions() const { return (uint) partitions.size(); }
+
+    /**
+     * Hash of some of a row's columns; its high half picks spill partitions (five bits a
+     * split), its low bits a bucket. Rows with equal values in those columns hash the same.
+     */
+    static u_int64_t hash(const Row &row, const std::vector<uint> &keys);
+
+protected:
+    QueryOperator *build_input;
+    QueryOperator *probe_input;
+    std::vector<uint> build_keys;
+    std::vector<uint> probe_keys;
+    bool build_left;
+    size_t memory_budget;
+    uint build_width;
+    uint probe_width;
+
+    // the hash table
+    RowArena build_rows;
+    std::vector<u_int64_t> hashes;                  // per row
+    std::vector<int32_t> chain;                     // per row: next row in its bucket, or -1
+    std::vector<int32_t> buckets;                   // first row in each bucket, or -1
+
+    // spill partitions
+    struct Partition {
+        HeapTable *build;                           // nullptr once split (or dropped)
+        HeapTable *probe;
+        u_int64_t build_count;
+        uint level;                                 // splits it took to get here
+    };
+    std::vector<Partition> partitions;              // made NUM_PARTITIONS at a time
+    uint partition;                                 // next to join
+    TableScan *partition_scan;
+
+    // where the probe stands between calls to next()
+    QueryOperator *probe;
+    RowBatch probe_rows;
+    uint probe_at;
+    u_int64_t probe_hash;
+    int32_t match;
+
+    virtual void add(const Row &row, u_int64_t hash);
+
+    virtual void build();
+
+    virtual void clear();
+
+    virtual bool over_budget() const;
+
+    virtual void spill();
+
+    virtual uint make_partitions(uint level);
+
+    virtual uint pick(uint first, u_int64_t hash) const;
+
+    virtual void partition_build(uint first, const Row &row, u_int64_t hash);
+
+    virtual void partition_probe(uint first, const Row &row, u_int64_t hash);
+
+    virtual bool load(uint p);
+
+    virtual void split(uint p);
+
+    virtual bool next_partition();
+
+    virtual void drop_partitions();
+
+    virtual bool keys_equal(const Field *build_row, const Row &probe_row) const;
+};
+
+bool test_hash_join();
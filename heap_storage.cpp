@@ -2,8 +2,14 @@
 // Course: CPSC5300, Seattle University, WQ'24
 
 #include "heap_storage.h"
+#include "buffer_pool.h"
+#include "filter_kernels.h"
+#include <cstdlib>
+#include <algorithm>
 #include <cstring>
 #include <map>
+#include <mutex>
+#include <stdexcept>
 #include <vector>
 
 // test function -- returns true if all tests pass
@@ -35,6 +41,24 @@ bool test_heap_storage() {
     std::cout << "insert ok" << std::endl;
     Handles* handles = table.select();
     std::cout << "select ok " << handles->size() << std::endl;
+    HeapTableCursor* rows = table.cursor();
+    Handle first;
+    if (!rows->next(first) || first != (*handles)[0])
+        return false;
+    delete rows;
+    std::cout << "cursor ok" << std::endl;
+    ValueDicts batch;
+    for (int i = 0; i < 1000; i++) {
+        row["a"] = Value(i);
+        batch.push_back(row);
+    }
+    Handles* batch_handles = table.insert_batch(&batch);
+    delete batch_handles;
+    delete handles;
+    handles = table.select();
+    if (handles->size() != 1001)
+        return false;
+    std::cout << "insert_batch ok" << std::endl;
     ValueDict *result = table.project((*handles)[0]);
     std::cout << "project ok" << std::endl;
     Value value = (*result)["a"];
@@ -43,34 +67,103 @@ bool test_heap_storage() {
     value = (*result)["b"];
     if (value.s != "Hello!")
 		return false;
+    delete result;
+    ValueDict change;
+    change["b"] = Value("Goodbye, longer text!");
+    table.update((*handles)[0], &change);
+    Row full_row;
+    table.project((*handles)[0], full_row);
+    if (full_row[0].n != 12 || full_row.value(1).s != "Goodbye, longer text!")
+        return false;
+    std::cout << "update ok" << std::endl;
+    ValueDict where;
+    where["a"] = Value(500);
+    Handles* found = table.select(&where);
+    bool found_ok = found->size() == 1;
+    delete found;
+    Comparisons range = {Comparison("a", Comparison::GE, Value(10)), Comparison("a", Comparison::LT, Value(20)),
+                         Comparison("b", Comparison::EQ, Value("Hello!"))};
+    found = table.select(&range);
+    found_ok = found_ok && found->size() == 10;
+    delete found;
+    if (!found_ok)
+        return false;
+    std::cout << "select where ok" << std::endl;
+    ThreadPool pool(4);
+    found = table.select(&range, pool);
+    Handles* expected = table.select(&range);
+    found_ok = *found == *expected;
+    delete expected;
+    delete found;
+    found = table.select(nullptr, pool, false);
+    found_ok = found_ok && found->size() == handles->size();
+    delete found;
+    if (!found_ok)
+        return false;
+    std::cout << "parallel select ok" << std::endl;
+    delete handles;
     table.drop();
 
+    // a big block has room for more small records than a RecordID can number
+    ColumnNames narrow_names = {"a"};
+    ColumnAttributes narrow_attributes = {ColumnAttribute(ColumnAttribute::INT)};
+    HeapTable narrow("_test_max_records_cpp", narrow_names, narrow_attributes, DbBlock::MAX_BLOCK_SZ);
+    narrow.create();
+    ValueDicts many;
+    ValueDict one;
+    for (int i = 0; i < 70000; i++) {
+        one["a"] = Value(i);
+        many.push_back(one);
+    }
+    handles = narrow.insert_batch(&many);
+    bool many_ok = handles->size() == many.size() && (*handles)[0].first != handles->back().first;
+    for (size_t i = 0; many_ok && i < handles->size(); i++) {
+        narrow.project((*handles)[i], full_row);
+        many_ok = full_row[0].n == (int32_t) i;
+    }
+    delete handles;
+    narrow.drop();
+    if (!many_ok)
+        return false;
+    std::cout << "max records ok" << std::endl;
+
     return true;
 }
 
-SlottedPage::SlottedPage(Dbt &block, BlockID block_id, bool is_new): DbBlock(block, block_id, is_new)
+SlottedPage::SlottedPage(Dbt &block, BlockID block_id, bool is_new): DbBlock(block, block_id, is_new), block_sz(block.get_size())
 {
-  std::cout << "a";
   if (is_new) {
     this->num_records = 0;
-    this->end_free = DbBlock::BLOCK_SZ - 1;
+    this->end_free = this->block_sz - 1;
     put_header();
   }
   else {
     get_header(this->num_records, this->end_free);
   }
 
+  // bytes in the record area that no live record owns (deleted or shrunken records)
+  u_int32_t used = 0;
+  for (u_int32_t i = 1; i <= this->num_records; i++) {
+    u_int32_t size;
+    u_int32_t loc;
+    get_header(size, loc, i);
+    if (loc != 0) {
+      used += size;
+    }
+  }
+  this->dead = this->block_sz - (this->end_free + 1) - used;
 }
 
 RecordID SlottedPage::add(const Dbt *data) {
-  if (!has_room(data->get_size())){
+  // the new record needs its header slot as well as the data
+  if (this->num_records >= MAX_RECORDS || !make_room(data->get_size() + HEADER_SZ)){
     throw DbBlockNoRoomError("Not enough room in block");
   }
   this->num_records += 1;
-  u_int16_t record_id = this->num_records;
-  u_int16_t size = data->get_size();
+  RecordID record_id = this->num_records;
+  u_int32_t size = data->get_size();
   this->end_free -= size;
-  u_int16_t loc = this->end_free + 1;
+  u_int32_t loc = this->end_free + 1;
   put_header();
   put_header(record_id, size, loc);
   memcpy(this->address(loc), data->get_data(), size);
@@ -79,62 +172,84 @@ RecordID SlottedPage::add(const Dbt *data) {
 
 
 Dbt* SlottedPage::get(RecordID record_id) {
-  u_int16_t size;
-  u_int16_t loc;
+  RecordView record;
+
+  if (!view(record_id, record)){
+    return NULL;
+  }
+  
+  return new Dbt((void*)record.data, record.size);
+
+}
+
+bool SlottedPage::view(RecordID record_id, RecordView &record) {
+  u_int32_t size;
+  u_int32_t loc;
 
+  if (record_id == 0 || record_id > this->num_records){
+    return false;
+  }
   get_header(size, loc, record_id);
 
   if (loc == 0){
-    return NULL;
+    return false;
   }
-  
-  return new Dbt(this->address(loc), size);
 
+  record = RecordView(this->address(loc), size);
+  return true;
 }
 
 void SlottedPage::put(RecordID record_id, const Dbt &data){
   
-  u_int16_t size;
-  u_int16_t loc;
-  u_int16_t new_size = data.get_size();
-  u_int16_t extra;
+  u_int32_t size;
+  u_int32_t loc;
+  u_int32_t new_size = data.get_size();
   
   get_header(size, loc, record_id);
 
-  if(new_size > size){
-    extra = new_size - size;
-    if(!has_room(extra)){
-      throw DbBlockNoRoomError("Not enough room in block");
-    }
-    
-    slide(loc, loc - extra);
-    memcpy(this->address(loc - extra), data.get_data(), size);
-  }
-  else{
+  if(new_size <= size){
+    // shrink in place; the leftover tail is dead space until a compaction needs it
     memcpy(this->address(loc), data.get_data(), new_size);
-    slide(loc + new_size, loc + size);
+    this->dead += size - new_size;
+    put_header(record_id, new_size, loc);
+    return;
   }
 
-  get_header(size, loc, record_id);
+  // grow: the old bytes are given up, so they count toward the room we can find
+  if((int64_t)new_size > contiguous() + this->dead + size){
+    throw DbBlockNoRoomError("Not enough room in block");
+  }
+  put_header(record_id, 0, 0);
+  this->dead += size;
+  make_room(new_size);
+
+  this->end_free -= new_size;
+  loc = this->end_free + 1;
+  put_header();
   put_header(record_id, new_size, loc);
+  memcpy(this->address(loc), data.get_data(), new_size);
 }
 
 void SlottedPage::del(RecordID record_id){
-  u_int16_t size;
-  u_int16_t loc;
+  u_int32_t size;
+  u_int32_t loc;
 
   get_header(size, loc, record_id);
-  put_header(record_id, 0, 0);
-  slide(loc, loc + size);
+  if(loc == 0){
+    return;
+  }
 
+  // just leave a tombstone; the bytes are reclaimed by the next compaction that needs them
+  put_header(record_id, 0, 0);
+  this->dead += size;
 }
 
 RecordIDs* SlottedPage::ids(void){
-  RecordIDs *id(0);
-  u_int16_t size;
-  u_int16_t loc;
+  RecordIDs *id = new RecordIDs();
+  u_int32_t size;
+  u_int32_t loc;
   
-  for(u_int16_t i = 1; i < this->num_records + 1; i++){
+  for(u_int32_t i = 1; i <= this->num_records; i++){
     get_header(size, loc, i);
     
     if(loc != 0){
@@ -146,132 +261,199 @@ RecordIDs* SlottedPage::ids(void){
   return id;
 }
 
-void SlottedPage::get_header(u_int16_t &size, u_int16_t &loc, RecordID record_id){
-  size = get_n(4 * record_id);
-  loc = get_n(4 * record_id + 2);
+void SlottedPage::get_header(u_int32_t &size, u_int32_t &loc, RecordID record_id){
+  size = get_n(HEADER_SZ * record_id);
+  loc = get_n(HEADER_SZ * record_id + 4);
 }
 
-void SlottedPage::put_header(RecordID id, u_int16_t size, u_int16_t loc) {
+void SlottedPage::put_header(RecordID id, u_int32_t size, u_int32_t loc) {
   if (id == 0) {
     size = this->num_records;
     loc = this->end_free;
   }
-  put_n(4*id, size);
-  put_n(4*id + 2, loc);
+  put_n(HEADER_SZ*id, size);
+  put_n(HEADER_SZ*id + 4, loc);
 
 }
 
-bool SlottedPage::has_room(u_int16_t size){
+int64_t SlottedPage::contiguous(void){
+  // between the end of the headers and the start of the record data
+  return (int64_t)this->end_free + 1 - (int64_t)HEADER_SZ * (this->num_records + 1);
+}
 
-  u_int16_t avalaible = (this->end_free - (this->num_records + 2)*4);
+u_int32_t SlottedPage::free_space(void){
+  if (this->num_records >= MAX_RECORDS) {
+    return 0;
+  }
+  // counting dead bytes, since add() will compact to get them back
+  int64_t available = contiguous() + this->dead - HEADER_SZ;
 
-  return size <= avalaible;
+  return available > 0 ? (u_int32_t)available : 0;
 }
 
-void SlottedPage::slide(u_int16_t start, u_int16_t end){
-  u_int16_t shifted = end - start;
-
-  if(shifted == 0){
-    return;
+// Make sure there are size contiguous free bytes, compacting if that would get us there.
+bool SlottedPage::make_room(u_int32_t size){
+  if((int64_t)size <= contiguous()){
+    return true;
+  }
+  if((int64_t)size > contiguous() + this->dead){
+    return false;
   }
+  compact();
+  return true;
+}
 
+// Pack the live records against the end of the block in a single pass through a scratch
+// copy, squeezing out dead bytes. Record ids (and so handles) don't change.
+void SlottedPage::compact(void){
+  std::vector<char> scratch(this->block_sz);
+  u_int32_t new_end = this->block_sz;
 
-
-  memcpy(this->address(this->end_free + 1 + shifted), this->address(end_free + 1), start - (end_free + 1));
-  
-  for(u_int16_t i = 0; i < this->ids()->size(); i++){
-    u_int16_t size;
-    u_int16_t loc;
+  for(u_int32_t i = 1; i <= this->num_records; i++){
+    u_int32_t size;
+    u_int32_t loc;
 
     get_header(size, loc, i);
-
-    if(loc <= start){
-      loc += start;
-      put_header(i, size, loc);
+    if(loc == 0){
+      continue;
     }
+    new_end -= size;
+    memcpy(&scratch[new_end], this->address(loc), size);
+    put_header(i, size, new_end);
   }
-    this->end_free += shifted;
-    put_header();
+  memcpy(this->address(new_end), &scratch[new_end], this->block_sz - new_end);
+  this->end_free = new_end - 1;
+  this->dead = 0;
+  put_header();
 }
 
 
 
-u_int16_t SlottedPage::get_n(u_int16_t offset) {
-    return *(u_int16_t*)this->address(offset);
+void SlottedPage::filter_int(u_int32_t offset, Comparison::Op op, int32_t value, u_int64_t *bitmap) {
+  static const IntFilterKernel kernel = int_filter_kernel();
+  kernel((const char*)this->block.get_data(), this->num_records, offset, op, value, bitmap);
+}
+
+
+u_int32_t SlottedPage::get_n(u_int32_t offset) {
+    return *(u_int32_t*)this->address(offset);
 }
 
 
-void SlottedPage::put_n(u_int16_t offset, u_int16_t n) {
-    *(u_int16_t*)this->address(offset) = n;
+void SlottedPage::put_n(u_int32_t offset, u_int32_t n) {
+    *(u_int32_t*)this->address(offset) = n;
 }
 
 
-void* SlottedPage::address(u_int16_t offset) {
+void* SlottedPage::address(u_int32_t offset) {
     return (void*)((char*)this->block.get_data() + offset);
 }
 
 // HEAP FILE code
 
+HeapFile::HeapFile(std::string name, uint block_sz): DbFile(name), dbfilename(""), last(0), block_sz(block_sz), closed(true), db(nullptr), fsm(name), read_flags(0), generation(0)
+{
+  if (block_sz < DbBlock::MIN_BLOCK_SZ || block_sz > DbBlock::MAX_BLOCK_SZ || (block_sz & (block_sz - 1)) != 0) {
+    throw std::invalid_argument("block size must be a power of two from 1kB to 1MB");
+  }
+}
+
 void HeapFile::create(void) {
   this-> db_open(DB_CREATE);
+  this->fsm.create();
   SlottedPage *block = this->get_new();
-  this->put(block);
+  this->release(block);
 }
 
 void HeapFile::drop(void){
   open();
+  _BUFFER_POOL->discard(this);
   close();
-  remove(this->dbfilename.c_str());
+  this->fsm.drop();
+  // let Berkeley DB remove it, since it lives in the environment's home directory
+  Db db(_DB_ENV, 0);
+  db.remove(this->dbfilename.c_str(), nullptr, 0);
 }
 
 void HeapFile::open(void) {
-  db_open(DB_CREATE);
+  if (!closed) {
+    return;
+  }
+  db_open();
+  try {
+    this->fsm.open();
+  } catch (DbException const&) {
+    // no map yet (or it was lost) -- rebuild it from the blocks themselves
+    this->fsm.create();
+    for (BlockID block_id = 1; block_id <= this->last; block_id++) {
+      SlottedPage *block = this->get(block_id);
+      this->fsm.set(block_id, block->free_space());
+      this->release(block);
+    }
+  }
 }
 
 void HeapFile::close(void) {
   if (!closed) {
-    db.close(0);
+    _BUFFER_POOL->flush(this);
+    _BUFFER_POOL->discard(this);
+    this->fsm.close();
+    db->close(0);
+    delete db;
+    db = nullptr;
     closed = true;
   }
 }
 
 SlottedPage* HeapFile::get_new(void) {
-  char block[DbBlock::BLOCK_SZ];
-  std::memset(block, 0, sizeof(block));
-  Dbt data(block, sizeof(block));
+  BlockID block_id = ++this->last;
+  SlottedPage* page = _BUFFER_POOL->fetch_new(this, block_id);
 
-  int block_id = ++this->last;
-  Dbt key(&block_id, sizeof(block_id));
-
-  SlottedPage* page = new SlottedPage(data, this->last, true);
-  std::cout<<"after slot";
-  this->db.put(nullptr, &key, &data, 0);
-  std::cout<<"between";
-  this->db.get(nullptr, &key, &data, 0);
+  // write the empty page right away (outside any transaction) so the new record number is visible to cursors
+  this->write(page);
+  this->fsm.set(block_id, page->free_space());
   return page;
 }
 
 SlottedPage* HeapFile::get(BlockID block_id) {
-  Dbt key(&block_id, sizeof(block_id));
-  Dbt data;
-  this->db.get(nullptr, &key, &data, 0);
-  return new SlottedPage(data, block_id, false);
+  return _BUFFER_POOL->fetch(this, block_id);
 }
 
 void HeapFile::put(DbBlock *block) {
-  std::cout<<"put success" << std::endl;
-  BlockID block_id  = block->get_block_id();
+  _BUFFER_POOL->mark_dirty(block);
+  this->fsm.set(block->get_block_id(), block->free_space());
+}
+
+void HeapFile::release(DbBlock *block) {
+  _BUFFER_POOL->unpin(block);
+}
+
+// Copy a block straight into memory we own (DB_DBT_USERMEM) rather than into
+// memory Berkeley DB owns and may overwrite on the next call.
+void HeapFile::read(BlockID block_id, Dbt &buffer) {
   Dbt key(&block_id, sizeof(block_id));
-  std::cout<<"put success" << std::endl;
-  this->db.put(nullptr, &key, block->get_block(), 0);
+  buffer.set_ulen(this->block_sz);
+  buffer.set_flags(DB_DBT_USERMEM);
+  this->db->get(nullptr, &key, &buffer, this->read_flags);
 }
 
-BlockIDs* HeapFile::block_ids() {
-  BlockIDs* block_id(0);
-  for (BlockID i = 1; i < (BlockID)this->last+1; i++) {
-    block_id->push_back(i);
-  }
-  return block_id;
+void HeapFile::write(DbBlock *block, DbTxn *txn) {
+  BlockID block_id = block->get_block_id();
+  Dbt key(&block_id, sizeof(block_id));
+  this->db->put(txn, &key, block->get_block(), 0);
+}
+
+HeapFileBlockCursor* HeapFile::block_ids() {
+  return new HeapFileBlockCursor(*this->db, this->read_flags);
+}
+
+void HeapFile::rolled_back(BlockID block_id) {
+  this->generation++;
+  if (this->closed || block_id > this->last)
+    return;
+  SlottedPage *block = this->get(block_id);
+  this->fsm.set(block_id, block->free_space());
+  this->release(block);
 }
 
 void HeapFile::db_open(uint flags) {
@@ -279,21 +461,133 @@ void HeapFile::db_open(uint flags) {
     return;
   }
 
-    this->db.set_re_len(DbBlock::BLOCK_SZ);
+    // a Db handle can't be reopened once closed, so each open gets a fresh one
+    this->db = new Db(_DB_ENV, 0);
+    // an existing file's record length comes from its own metadata, so only set it on create
+    if (flags & DB_CREATE)
+      this->db->set_re_len(this->block_sz);
     this->dbfilename = this->name + ".db";
-    this->db.open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags, 0644);
+    // in a transactional environment, writes without a transaction commit on their own, and
+    // reads don't wait on other transactions' writes (the buffer pool already shows those)
+    u_int32_t env_flags = 0;
+    _DB_ENV->get_open_flags(&env_flags);
+    if (env_flags & DB_INIT_TXN) {
+      flags |= DB_AUTO_COMMIT | DB_READ_UNCOMMITTED;
+      this->read_flags = DB_READ_UNCOMMITTED;
+    }
+    try {
+      // DB_THREAD: blocks may be read from several threads at once (see HeapTable::select with a ThreadPool)
+      this->db->open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags | DB_THREAD, 0644);
+    } catch (DbException const&) {
+      delete this->db;
+      this->db = nullptr;
+      throw;
+    }
+    this->db->get_re_len(&this->block_sz);
+    this->fsm.set_block_size(this->block_sz);
     DB_BTREE_STAT *stat_type;
-    this->db.stat(nullptr, &stat_type, DB_FAST_STAT);
+    this->db->stat(nullptr, &stat_type, DB_FAST_STAT);
     this->last = stat_type->bt_ndata;
+    free(stat_type);
     this->closed = false;
 }
 
 
 
+// HEAP FILE BLOCK CURSOR code
+
+HeapFileBlockCursor::HeapFileBlockCursor(Db &db, u_int32_t flags): cursor(nullptr) {
+  db.cursor(nullptr, &this->cursor, flags);
+}
+
+HeapFileBlockCursor::~HeapFileBlockCursor() {
+  close();
+}
+
+bool HeapFileBlockCursor::next(BlockID &block_id) {
+  if (this->cursor == nullptr) {
+    return false;
+  }
+
+  // the record number is all we want, so ask for zero bytes of the block itself
+  db_recno_t recno;
+  Dbt key(&recno, sizeof(recno));
+  key.set_ulen(sizeof(recno));
+  key.set_flags(DB_DBT_USERMEM);
+  Dbt data;
+  data.set_flags(DB_DBT_USERMEM | DB_DBT_PARTIAL);
+  data.set_ulen(0);
+  data.set_dlen(0);
+  data.set_doff(0);
+
+  if (this->cursor->get(&key, &data, DB_NEXT) == DB_NOTFOUND) {
+    close();
+    return false;
+  }
+  block_id = recno;
+  return true;
+}
+
+void HeapFileBlockCursor::close() {
+  if (this->cursor != nullptr) {
+    this->cursor->close();
+    this->cursor = nullptr;
+  }
+}
+
+
+
+// HEAP TABLE CURSOR code
+
+HeapTableCursor::HeapTableCursor(HeapFile &file, RowFilter *filter): file(file), filter(filter), block_id(0), record_ids(nullptr), next_record(0) {
+  this->block_ids = file.block_ids();
+}
+
+HeapTableCursor::~HeapTableCursor() {
+  close();
+  delete this->filter;
+}
+
+bool HeapTableCursor::next(Handle &handle) {
+  while (this->block_ids != nullptr) {
+    if (this->record_ids != nullptr && this->next_record < this->record_ids->size()) {
+      handle = Handle(this->block_id, (*this->record_ids)[this->next_record++]);
+      return true;
+    }
+
+    // current block is used up (or we haven't started) -- move on to the next one
+    delete this->record_ids;
+    this->record_ids = nullptr;
+    if (!this->block_ids->next(this->block_id)) {
+      close();
+      return false;
+    }
+    SlottedPage* block = this->file.get(this->block_id);
+    if (this->filter == nullptr || this->filter->empty()) {
+      this->record_ids = block->ids();
+    } else {
+      this->record_ids = new RecordIDs();
+      this->filter->select(block, *this->record_ids);
+    }
+    this->next_record = 0;
+    this->file.release(block);
+  }
+  return false;
+}
+
+void HeapTableCursor::close() {
+  delete this->record_ids;
+  this->record_ids = nullptr;
+  delete this->block_ids;
+  this->block_ids = nullptr;
+}
+
+
+
 // HEAP TABLE code
 
 
-HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes): DbRelation(table_name, column_names, column_attributes), file(table_name)
+HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes, uint block_sz): DbRelation(table_name, column_names, column_attributes), file(table_name, block_sz), codec(column_names, column_attributes)
 {}
 
 void HeapTable::create(){
@@ -323,7 +617,14 @@ void HeapTable::drop(){
 
 void HeapTable::open(){
   
-  this->file.open();
+  try
+    {
+      this->file.open();
+    }
+  catch(DbException const& e)
+    {
+      throw DbRelationError("cannot open table " + this->table_name + ": " + e.what());
+    }
 }
 
 void HeapTable::close(){
@@ -332,136 +633,493 @@ void HeapTable::close(){
 }
 
 Handle HeapTable::insert(const ValueDict *row){
-  std::cout<<"insert open" << std::endl;
+  Row full_row;
+  this->validate(row, full_row);
+  return this->insert(full_row);
+}
+
+Handle HeapTable::insert(const Row &row){
+  this->open();
+  this->claim();
+  Handle handle = this->append(row);
+  this->index_insert(handle);
+  return handle;
+}
+
+Handles* HeapTable::insert_batch(const ValueDicts *rows){
   this->open();
-  return this->append(this->validate(row));
-  std::cout<<"insert after" << std::endl;
+  this->claim();
+  Handles* handles = new Handles();
+  handles->reserve(rows->size());
+  char *bytes = new char[this->file.get_block_size()];  // every row is marshaled into here in turn
+  Row full_row(this->codec.num_columns());              // and goes through this on the way
+  SlottedPage *block = nullptr;
+  bool block_is_new = false;
+
+  try
+    {
+      for (auto const& row: *rows) {
+        this->validate(&row, full_row);
+        Dbt data(bytes, this->marshal(full_row, bytes));
+
+        // keep filling the current block; only when it is full do we write it and move on
+        while (block == nullptr || block->free_space() < data.get_size()) {
+          if (block != nullptr) {
+            this->file.put(block);
+            this->file.release(block);
+            if (block_is_new)
+              throw DbRelationError("row too big to fit in a block");
+          }
+          BlockID block_id = this->file.find_room(data.get_size());
+          block_is_new = block_id == 0;
+          block = block_is_new ? this->file.get_new() : this->file.get(block_id);
+        }
+        handles->push_back(Handle(block->get_block_id(), block->add(&data)));
+        block_is_new = false;
+      }
+    }
+  catch(...)
+    {
+      if (block != nullptr) {
+        this->file.put(block);
+        this->file.release(block);
+      }
+      delete[] bytes;
+      delete handles;
+      throw;
+    }
+
+  if (block != nullptr) {
+    this->file.put(block);
+    this->file.release(block);
+  }
+  delete[] bytes;
+
+  if (!this->indices.empty()) {
+    try
+      {
+        for (auto const& handle: *handles)
+          this->index_insert(handle);
+      }
+    catch(...)
+      {
+        delete handles;
+        throw;
+      }
+  }
+  return handles;
 }
 
 void HeapTable::update(const Handle handle, const ValueDict *new_values){
+  this->open();
+  this->claim();
+  // out with the old index entries (they are found from the row as it is now), in with the new after
+  for (auto index: this->indices)
+    index->del(handle);
+  SlottedPage *block = this->file.get(handle.first);
+  char *bytes = new char[this->file.get_block_size()];
+  std::vector<char> old_record;  // to put back if an index refuses the new values
+  try
+    {
+      RecordView record;
+      if (!block->view(handle.second, record))
+        throw DbRelationError("no such row in " + this->table_name);
+      if (!this->indices.empty())
+        old_record.assign(record.data, record.data + record.size);
+
+      // overlay the new values on the old record; both are only borrowed until the
+      // new record is marshaled, so nothing is copied but the final bytes
+      Row row;
+      this->codec.decode(record, row);
+      for (auto const& new_value: *new_values) {
+        int column = this->codec.ordinal(new_value.first);
+        if (column < 0)
+          throw DbRelationError("unknown column " + new_value.first);
+        if (new_value.second.data_type != this->codec.get_data_type(column))
+          throw DbRelationError("wrong type for column " + new_value.first);
+        if (new_value.second.data_type == ColumnAttribute::DataType::INT)
+          row.set_int(column, new_value.second.n);
+        else
+          row.set_text(column, new_value.second.s.data(), (u_int32_t) new_value.second.s.length());
+      }
+      Dbt data(bytes, this->marshal(row, bytes));
+      try
+        {
+          block->put(handle.second, data);
+        }
+      catch(DbBlockNoRoomError const&)
+        {
+          // moving the row would change its handle, which callers may be holding
+          throw DbRelationError("updated row no longer fits in its block");
+        }
+    }
+  catch(...)
+    {
+      this->file.release(block);
+      delete[] bytes;
+      for (auto index: this->indices)
+        index->insert(handle);
+      throw;
+    }
+  this->file.put(block);
+  this->file.release(block);
+  delete[] bytes;
+
+  for (size_t i = 0; i < this->indices.size(); i++) {
+    try
+      {
+        this->indices[i]->insert(handle);
+      }
+    catch(...)
+      {
+        while (i-- > 0)
+          this->indices[i]->del(handle);
+        block = this->file.get(handle.first);
+        block->put(handle.second, Dbt(old_record.data(), (u_int32_t) old_record.size()));
+        this->file.put(block);
+        this->file.release(block);
+        for (auto index: this->indices)
+          index->insert(handle);
+        throw;
+      }
+  }
 }
 
 void HeapTable::del(const Handle handle){
+  this->open();
+  this->claim();
+  for (auto index: this->indices)
+    index->del(handle);
+  SlottedPage *block = this->file.get(handle.first);
+  block->del(handle.second);
+  this->file.put(block);
+  this->file.release(block);
 }
 
 Handles* HeapTable::select(){
-
-  Handles* handles = new Handles();
-
-  return handles;
+  return this->select((const ValueDict *) nullptr);
 }
 
 Handles* HeapTable::select(const ValueDict *where){
   
+  DbIndex *index = this->index_for(where);
+  if (index != nullptr) {
+    // same order as a scan would give
+    Handles *handles = index->lookup(where);
+    std::sort(handles->begin(), handles->end());
+    return handles;
+  }
+
   Handles* handles = new Handles();
-  BlockIDs* block_ids = file.block_ids();
-  for (auto const& block_id: *block_ids) {
-    SlottedPage* block = file.get(block_id);
-    RecordIDs* record_ids = block->ids();
-    for (auto const& record_id: *record_ids)
-      handles->push_back(Handle(block_id, record_id));
-    delete record_ids;
-    delete block;
-  }
-  delete block_ids;
+  HeapTableCursor* rows = this->cursor(where);
+  Handle handle;
+  while (rows->next(handle))
+    handles->push_back(handle);
+  delete rows;
   return handles;  
   
 }
 
-ValueDict* HeapTable::project(Handle handle){
+Handles* HeapTable::select(const Comparisons *where){
 
-  ValueDict *v_Dict = new ValueDict();
-
-  return v_Dict ;
+  Handles* handles = new Handles();
+  HeapTableCursor* rows = this->cursor(where);
+  Handle handle;
+  while (rows->next(handle))
+    handles->push_back(handle);
+  delete rows;
+  return handles;  
+  
 }
 
-ValueDict* HeapTable::project(Handle handle, const ColumnNames *column_names){
-
-  ValueDict *v_Dict = new ValueDict();
+Handles* HeapTable::select(const Comparisons *where, ThreadPool &pool, bool ordered){
+  this->open();
+  RowFilter filter(this->codec, where == nullptr ? Comparisons() : *where);
+  BlockID last = this->file.get_last_block_id();
+  uint num_morsels = (last + MORSEL_BLOCKS - 1) / MORSEL_BLOCKS;
+  std::vector<Handles> morsels(ordered ? num_morsels : 0);
+  Handles *handles = new Handles();
+  std::mutex merge;
+
+  for (uint morsel = 0; morsel < num_morsels; morsel++) {
+    pool.submit([this, &filter, &morsels, handles, &merge, morsel, last, ordered]() {
+      Handles found;
+      RecordIDs record_ids;
+      BlockID end = std::min(last, (morsel + 1) * MORSEL_BLOCKS);
+      for (BlockID block_id = morsel * MORSEL_BLOCKS + 1; block_id <= end; block_id++) {
+        SlottedPage *block = this->file.get(block_id);
+        record_ids.clear();
+        if (filter.empty()) {
+          RecordIDs *ids = block->ids();
+          record_ids.swap(*ids);
+          delete ids;
+        } else {
+          filter.select(block, record_ids);
+        }
+        this->file.release(block);
+        for (auto const& record_id: record_ids)
+          found.push_back(Handle(block_id, record_id));
+      }
+      if (ordered) {
+        morsels[morsel].swap(found);
+      } else {
+        std::lock_guard<std::mutex> guard(merge);
+        handles->insert(handles->end(), found.begin(), found.end());
+      }
+    });
+  }
 
-  return v_Dict ;
+  try
+    {
+      pool.wait();
+    }
+  catch(...)
+    {
+      delete handles;
+      throw;
+    }
+  for (auto const& found: morsels)
+    handles->insert(handles->end(), found.begin(), found.end());
+  return handles;
 }
 
+BlockID HeapTable::get_num_blocks(){
+  this->open();
+  return this->file.get_last_block_id();
+}
 
-ValueDict* HeapTable::validate(const ValueDict *row){
-  ValueDict *full_row = new ValueDict();
+void HeapTable::scan_block(BlockID block_id, const RowFilter *filter, RowBatch &rows){
+  SlottedPage *block = this->file.get(block_id);
+  try
+    {
+      RecordIDs *record_ids;
+      if (filter == nullptr || filter->empty()) {
+        record_ids = block->ids();
+      } else {
+        record_ids = new RecordIDs();
+        filter->select(block, *record_ids);
+      }
+      RecordView record;
+      for (auto const& record_id: *record_ids) {
+        if (block->view(record_id, record)) {
+          Row &row = rows.add();
+          this->codec.decode(record, row);
+          row.own();
+        }
+      }
+      delete record_ids;
+    }
+  catch(...)
+    {
+      this->file.release(block);
+      throw;
+    }
+  this->file.release(block);
+}
 
-  uint col_num = 0;
-  for (auto const& column_name: this->column_names) {
-    ColumnAttribute column_attributes = this->column_attributes[col_num++];
-    ValueDict::const_iterator column = row->find(column_name);
-    Value value = column->second;
-    if((column_attributes.get_data_type() != ColumnAttribute::DataType::INT) &&
-       (column_attributes.get_data_type() != ColumnAttribute::DataType::TEXT)){
-      throw DbRelationError ("Dont know how to handle Nulls, defaults, etc. yet");
+void HeapTable::scan_block(BlockID block_id, const RowFilter *filter, const ColumnDecoder &decoder,
+                           ColumnBatch &batch){
+  SlottedPage *block = this->file.get(block_id);
+  try
+    {
+      RecordIDs *record_ids;
+      if (filter == nullptr || filter->empty()) {
+        record_ids = block->ids();
+      } else {
+        record_ids = new RecordIDs();
+        filter->select(block, *record_ids);
+      }
+      std::vector<RecordView> records;
+      records.reserve(record_ids->size());
+      RecordView record;
+      for (auto const& record_id: *record_ids)
+        if (block->view(record_id, record))
+          records.push_back(record);
+      delete record_ids;
+      decoder.decode(records, batch);
     }
-    else{
-      value = row->at(column_name);
+  catch(...)
+    {
+      this->file.release(block);
+      throw;
     }
-    
-     full_row->insert(std::pair<Identifier, Value>(column_name, value));
-  }
-  
-  return full_row;
+  this->file.release(block);
+}
 
+HeapTableCursor* HeapTable::cursor(){
+  return this->cursor((const ValueDict *) nullptr);
 }
 
-Handle HeapTable::append(const ValueDict *row){
-  Dbt *data = this->marshal(row);
+HeapTableCursor* HeapTable::cursor(const ValueDict *where){
+  this->open();
+  RowFilter *filter = where == nullptr ? nullptr : new RowFilter(this->codec, *where);
+  return new HeapTableCursor(this->file, filter);
+}
 
-  SlottedPage *block = this->file.get(this->file.get_last_block_id());
+HeapTableCursor* HeapTable::cursor(const Comparisons *where){
+  this->open();
+  RowFilter *filter = where == nullptr ? nullptr : new RowFilter(this->codec, *where);
+  return new HeapTableCursor(this->file, filter);
+}
+
+ValueDict* HeapTable::project(Handle handle){
+  return this->project(handle, nullptr);
+}
 
+ValueDict* HeapTable::project(Handle handle, const ColumnNames *column_names){
+  this->open();
+  SlottedPage *block = this->file.get(handle.first);
+  RecordView record;
+  if (!block->view(handle.second, record)) {
+    this->file.release(block);
+    throw DbRelationError("no such row in " + this->table_name);
+  }
 
-  u_int16_t  record_id;;
+  ValueDict *row = new ValueDict();
   try
     {
-      record_id = block->add(data);
+      if (column_names == nullptr || column_names->empty()) {
+        this->codec.decode(record, *row);
+      } else {
+        // only decode the columns asked for, straight from their offsets
+        for (auto const& column_name: *column_names) {
+          int column = this->codec.ordinal(column_name);
+          if (column < 0)
+            throw DbRelationError("unknown column " + column_name);
+          (*row)[column_name] = this->codec.get(record, column);
+        }
+      }
     }
-  catch(DbRelationError const&)
+  catch(...)
     {
-      block = this->file.get_new();
-      record_id = block->add(data);
+      this->file.release(block);
+      delete row;
+      throw;
     }
+  this->file.release(block);
+  return row;
+}
 
-  this->file.put(block);
+void HeapTable::project(Handle handle, Row &row){
+  this->open();
+  SlottedPage *block = this->file.get(handle.first);
+  RecordView record;
+  if (!block->view(handle.second, record)) {
+    this->file.release(block);
+    throw DbRelationError("no such row in " + this->table_name);
+  }
+  this->codec.decode(record, row);
+  row.own();  // copy the TEXT out before the block can go away
+  this->file.release(block);
+}
 
-  return Handle(this->file.get_last_block_id(), record_id);
+
+void HeapTable::add_index(DbIndex *index){
+  this->indices.push_back(index);
 }
 
+void HeapTable::remove_index(DbIndex *index){
+  this->indices.erase(std::remove(this->indices.begin(), this->indices.end(), index), this->indices.end());
+}
 
-Dbt* HeapTable::marshal(const ValueDict *row){
-  
-  char *bytes = new char[DbBlock::BLOCK_SZ];
-  uint offset = 0;
-  uint col_num = 0;
-  for (auto const& column_name: this->column_names) {
-    ColumnAttribute ca = this->column_attributes[col_num++];
-    ValueDict::const_iterator column = row->find(column_name);
-    Value value = column->second;
-    if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
-      *(u_int32_t*) (bytes + offset) = value.n;
-      offset += sizeof(int32_t);
-    } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
-      u_int16_t size = value.s.length();
-      *(u_int16_t*) (bytes + offset) = size;
-      offset += sizeof(u_int16_t);
-      memcpy(bytes+offset, value.s.c_str(), size); // assume ascii for now
-      offset += size;
-    } else {
-      throw DbRelationError("Only know how to marshal INT and TEXT");
-    }
+// before a change: a table with another open transaction's changes pending can't be changed
+void HeapTable::claim(){
+  if (!_BUFFER_POOL->claim(&this->file))
+    throw DbRelationError("table " + this->table_name + " has changes pending in another transaction");
+}
+
+// add a new row to every index; if one refuses it (e.g., a duplicate unique key), the row is backed out
+void HeapTable::index_insert(Handle handle){
+  for (size_t i = 0; i < this->indices.size(); i++) {
+    try
+      {
+        this->indices[i]->insert(handle);
+      }
+    catch(...)
+      {
+        while (i-- > 0)
+          this->indices[i]->del(handle);
+        SlottedPage *block = this->file.get(handle.first);
+        block->del(handle.second);
+        this->file.put(block);
+        this->file.release(block);
+        throw;
+      }
   }
-  char *right_size_bytes = new char[offset];
-  memcpy(right_size_bytes, bytes, offset);
-  delete[] bytes;
-  Dbt *data = new Dbt(right_size_bytes, offset);
-  return data;
 }
 
+// an index whose key columns are exactly where's columns, hash indices first; nullptr if none
+DbIndex* HeapTable::index_for(const ValueDict *where) const{
+  if (where == nullptr || where->empty())
+    return nullptr;
+  DbIndex *found = nullptr;
+  for (auto index: this->indices) {
+    const ColumnNames &key_columns = index->get_key_columns();
+    if (key_columns.size() != where->size())
+      continue;
+    bool covers = true;
+    for (auto const& column_name: key_columns)
+      covers = covers && where->count(column_name) > 0;
+    if (covers && (found == nullptr || (found->is_ordered() && !index->is_ordered())))
+      found = index;
+  }
+  return found;
+}
 
-ValueDict* HeapTable::unmarshal(Dbt *data){
+// check the row against the schema and lay it out in column order (TEXT still borrowed from row)
+void HeapTable::validate(const ValueDict *row, Row &full_row){
+  this->codec.to_row(*row, full_row);
+}
 
-  ValueDict *v_Dict = new ValueDict();
+Handle HeapTable::append(const Row &row){
+  Dbt *data = this->marshal(row);
+  char *bytes = (char*)data->get_data();
+
+  while (true) {
+    BlockID block_id = this->file.find_room(data->get_size());
+    bool is_new = block_id == 0;
+    SlottedPage *block = is_new ? this->file.get_new() : this->file.get(block_id);
+    try
+      {
+        Handle handle(block->get_block_id(), block->add(data));
+        this->file.put(block);
+        this->file.release(block);
+        delete[] bytes;
+        delete data;
+        return handle;
+      }
+    catch(DbBlockNoRoomError const&)
+      {
+        // the free-space map overstated this block's room; put() sets it straight
+        this->file.put(block);
+        this->file.release(block);
+        if (is_new) {
+          delete[] bytes;
+          delete data;
+          throw DbRelationError("row too big to fit in a block");
+        }
+      }
+  }
+}
+
+
+Dbt* HeapTable::marshal(const Row &row){
+  
+  u_int32_t size = this->codec.encoded_size(row);
+  char *bytes = new char[size];
+  this->codec.encode(row, bytes, size);
+  return new Dbt(bytes, size);
+}
 
-  return v_Dict ;
-}
\ No newline at end of file
+// marshal into caller-supplied memory of one block's size, returning the size used
+u_int32_t HeapTable::marshal(const Row &row, char *bytes){
+  return this->codec.encode(row, bytes, this->file.get_block_size());
+}
+
+
+ValueDict* HeapTable::unmarshal(Dbt *data){
+
+  ValueDict *row = new ValueDict();
+  this->codec.decode(RecordView(data->get_data(), data->get_size()), *row);
+  return row;
+}
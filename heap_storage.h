@@ -9,8 +9,14 @@
  */
 #pragma once
 
+#include <cstdint>
 #include "db_cxx.h"
 #include "storage_engine.h"
+#include "free_space_map.h"
+#include "row_codec.h"
+#include "column_batch.h"
+#include "predicate.h"
+#include "thread_pool.h"
 
 /**
  * @class SlottedPage - heap file implementation of DbBlock.
@@ -20,15 +26,24 @@
 
         Record id are handed out sequentially starting with 1 as records are added with add().
         Each record has a header which is a fixed offset from the beginning of the block:
-            Bytes 0x00 - Ox01: number of records
-            Bytes 0x02 - 0x03: offset to end of free space
-            Bytes 0x04 - 0x05: size of record 1
-            Bytes 0x06 - 0x07: offset to record 1
+            Bytes 0x00 - 0x03: number of records
+            Bytes 0x04 - 0x07: offset to end of free space
+            Bytes 0x08 - 0x0B: size of record 1
+            Bytes 0x0C - 0x0F: offset to record 1
             etc.
+        The fields are 32 bits so blocks larger than 64kB can be addressed; the block size
+        is whatever size the Dbt we are given has.
+
+        Deleting a record just zeroes its header (a tombstone), and shrinking or moving a
+        record leaves its old bytes behind; those dead bytes are only squeezed out, in one
+        compaction pass, when add() or put() needs contiguous space that isn't there.
  *
  */
 class SlottedPage : public DbBlock {
 public:
+    // most records one block can hold, since a RecordID (and an index's handle) is 16 bits
+    static const u_int32_t MAX_RECORDS = UINT16_MAX;
+
     SlottedPage(Dbt &block, BlockID block_id, bool is_new = false);
 
     // Big 5 - we only need the destructor, copy-ctor, move-ctor, and op= are unnecessary
@@ -47,44 +62,110 @@ public:
 
     virtual Dbt *get(RecordID record_id);
 
+    virtual bool view(RecordID record_id, RecordView &record);
+
     virtual void put(RecordID record_id, const Dbt &data);
 
     virtual void del(RecordID record_id);
 
     virtual RecordIDs *ids(void);
 
+    virtual u_int32_t free_space(void);
+
+    /**
+     * Number of record ids handed out so far (deleted ones included).
+     */
+    virtual u_int32_t get_num_records(void) { return num_records; }
+
+    /**
+     * Compare an INT column against a constant in every record, with the best
+     * filter kernel for this CPU (see filter_kernels.h).
+     * @param offset  the column's offset within each record
+     * @param op      comparison, as in "column op value"
+     * @param value   constant to compare with
+     * @param bitmap  (get_num_records() + 63) / 64 words; bit id-1 is cleared for
+     *                each record id that is deleted or doesn't qualify
+     */
+    virtual void filter_int(u_int32_t offset, Comparison::Op op, int32_t value, u_int64_t *bitmap);
+
 protected:
-    u_int16_t num_records;
-    u_int16_t end_free;
+    static const uint HEADER_SZ = 8;  // bytes per record header (size, offset)
+
+    u_int32_t block_sz;
+    u_int32_t num_records;
+    u_int32_t end_free;
+    u_int32_t dead;  // bytes held by deleted or shrunken records, reclaimable by compact()
+
+    virtual void get_header(u_int32_t &size, u_int32_t &loc, RecordID id = 0);
 
-    virtual void get_header(u_int16_t &size, u_int16_t &loc, RecordID id = 0);
+    virtual void put_header(RecordID id = 0, u_int32_t size = 0, u_int32_t loc = 0);
 
-    virtual void put_header(RecordID id = 0, u_int16_t size = 0, u_int16_t loc = 0);
+    virtual int64_t contiguous(void);
 
-    virtual bool has_room(u_int16_t size);
+    virtual bool make_room(u_int32_t size);
 
-    virtual void slide(u_int16_t start, u_int16_t end);
+    virtual void compact(void);
 
-    virtual u_int16_t get_n(u_int16_t offset);
+    virtual u_int32_t get_n(u_int32_t offset);
 
-    virtual void put_n(u_int16_t offset, u_int16_t n);
+    virtual void put_n(u_int32_t offset, u_int32_t n);
 
-    virtual void *address(u_int16_t offset);
+    virtual void *address(u_int32_t offset);
+};
+
+/**
+ * @class HeapFileBlockCursor - BlockIDCursor over a HeapFile's Berkeley DB RecNo file.
+ *
+ * Walks the file with a Berkeley DB cursor, fetching only the record numbers
+ * (a zero-length partial get), so no block data is copied while iterating.
+ */
+class HeapFileBlockCursor : public BlockIDCursor {
+public:
+    HeapFileBlockCursor(Db &db, u_int32_t flags = 0);
+
+    virtual ~HeapFileBlockCursor();
+
+    HeapFileBlockCursor(const HeapFileBlockCursor &other) = delete;
+
+    HeapFileBlockCursor(HeapFileBlockCursor &&temp) = delete;
+
+    HeapFileBlockCursor &operator=(const HeapFileBlockCursor &other) = delete;
+
+    HeapFileBlockCursor &operator=(HeapFileBlockCursor &&temp) = delete;
+
+    virtual bool next(BlockID &block_id);
+
+    virtual void close();
+
+protected:
+    Dbc *cursor;
 };
 
 /**
  * @class HeapFile - heap file implementation of DbFile
  *
  * Heap file organization. Built on top of Berkeley DB RecNo file. There is one of our
-        database blocks for each Berkeley DB record in the RecNo file. In this way we are using Berkeley DB
-        for buffer management and file management.
-        Uses SlottedPage for storing records within blocks.
+        database blocks for each Berkeley DB record in the RecNo file. Blocks are cached in
+        the engine's BufferPool (pages from get/get_new are pinned until release, and put
+        only marks them dirty); Berkeley DB does the file management underneath.
+        Uses SlottedPage for storing records within blocks. The block size is chosen when
+        the file is created and kept as the RecNo file's record length from then on.
+        Keeps a FreeSpaceMap alongside, refreshed whenever a block is put, so appends
+        can reuse room freed anywhere in the file.
+        In a transactional environment blocks are written under the transaction that
+        changed them (see BufferPool), and new blocks are added outside any transaction,
+        so a rollback can leave an empty block at the end but never a missing one.
  */
 class HeapFile : public DbFile {
 public:
-    HeapFile(std::string name) : DbFile(name), dbfilename(""), last(0), closed(true), db(_DB_ENV, 0) {}
+    /**
+     * @param name      file name (without extension)
+     * @param block_sz  block size to use if the file is created (ignored for an existing file)
+     * @throws          std::invalid_argument if block_sz isn't a power of two in range
+     */
+    HeapFile(std::string name, uint block_sz = DbBlock::BLOCK_SZ);
 
-    virtual ~HeapFile() {}
+    virtual ~HeapFile() { close(); }
 
     HeapFile(const HeapFile &other) = delete;
 
@@ -108,26 +189,109 @@ public:
 
     virtual void put(DbBlock *block);
 
-    virtual BlockIDs *block_ids();
+    virtual void release(DbBlock *block);
+
+    virtual HeapFileBlockCursor *block_ids();
 
     virtual u_int32_t get_last_block_id() { return last; }
 
+    virtual u_int32_t get_block_size() { return block_sz; }
+
+    /**
+     * Find an existing block that should have room for a record, per the free-space map.
+     * @param size  record size needed
+     * @returns     the block's id, or 0 if there is none (so get_new() is needed)
+     */
+    virtual BlockID find_room(u_int32_t size) { return fsm.find(size); }
+
+    /**
+     * A transaction that changed a block has rolled back: the block is back to what the
+     * file holds, so bring the free-space map into line and bump the generation.
+     * @param block_id  the block
+     */
+    virtual void rolled_back(BlockID block_id);
+
+    /**
+     * Number of rollbacks that have touched this file, so that anything cached from its
+     * blocks (e.g., an index's root) can tell it needs reading again.
+     */
+    virtual u_int32_t get_generation() const { return generation; }
+
 protected:
     std::string dbfilename;
     u_int32_t last;
+    u_int32_t block_sz;
     bool closed;
-    Db db;
+    Db *db;
+    FreeSpaceMap fsm;
+    u_int32_t read_flags;       // DB_READ_UNCOMMITTED in a transactional environment
+    u_int32_t generation;
 
     virtual void db_open(uint flags = 0);
+
+    // block I/O underneath the BufferPool
+    friend class BufferPool;
+
+    virtual void read(BlockID block_id, Dbt &buffer);
+
+    virtual void write(DbBlock *block, DbTxn *txn = nullptr);
+};
+
+/**
+ * @class HeapTableCursor - HandleCursor over a HeapTable's file.
+ *
+ * Walks the file one block at a time, holding only the current block's
+ * record ids, so memory use does not grow with the size of the table.
+ * With a RowFilter, each block's records are tested in place while the
+ * block is pinned and only the qualifying ids are kept.
+ */
+class HeapTableCursor : public HandleCursor {
+public:
+    /**
+     * @param file    file to scan
+     * @param filter  where clause to apply, or nullptr for every row (the cursor takes ownership)
+     */
+    HeapTableCursor(HeapFile &file, RowFilter *filter);
+
+    virtual ~HeapTableCursor();
+
+    HeapTableCursor(const HeapTableCursor &other) = delete;
+
+    HeapTableCursor(HeapTableCursor &&temp) = delete;
+
+    HeapTableCursor &operator=(const HeapTableCursor &other) = delete;
+
+    HeapTableCursor &operator=(HeapTableCursor &&temp) = delete;
+
+    virtual bool next(Handle &handle);
+
+    virtual void close();
+
+protected:
+    HeapFile &file;
+    RowFilter *filter;
+    HeapFileBlockCursor *block_ids;
+    BlockID block_id;
+    RecordIDs *record_ids;
+    size_t next_record;
 };
 
 /**
  * @class HeapTable - Heap storage engine (implementation of DbRelation)
+ *
+ * Rows are stored in the RowCodec format, compiled from the schema when the
+ * table object is constructed. Internally rows travel as Rows (indexed by column
+ * ordinal); the ValueDict methods convert at the edge. insert(Row) and
+ * project(handle, Row) let callers that already have ordinals skip the conversion.
+ * Indices added with add_index() are updated along with the rows, and
+ * select(where) answers from one (preferring a hash index) when where gives
+ * exactly its key columns, instead of scanning the file.
  */
 
 class HeapTable : public DbRelation {
 public:
-    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes);
+    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+              uint block_sz = DbBlock::BLOCK_SZ);
 
     virtual ~HeapTable() {}
 
@@ -151,6 +315,15 @@ public:
 
     virtual Handle insert(const ValueDict *row);
 
+    /**
+     * Insert a row given in column order.
+     * @param row  one Field per column, of the column's type
+     * @returns    a handle to the new row
+     */
+    virtual Handle insert(const Row &row);
+
+    virtual Handles *insert_batch(const ValueDicts *rows);
+
     virtual void update(const Handle handle, const ValueDict *new_values);
 
     virtual void del(const Handle handle);
@@ -159,18 +332,131 @@ public:
 
     virtual Handles *select(const ValueDict *where);
 
+    virtual HeapTableCursor *cursor();
+
+    virtual HeapTableCursor *cursor(const ValueDict *where);
+
+    /**
+     * SELECT <handle> FROM <table_name> WHERE <comparisons> (equality or range on any columns)
+     * @param where  terms that must all hold (nullptr for every row)
+     * @returns      a pointer to a list of handles for qualifying rows (freed by caller)
+     */
+    virtual Handles *select(const Comparisons *where);
+
+    /**
+     * Streaming form of select(comparisons).
+     * @param where  terms that must all hold (nullptr for every row; need not outlive the cursor)
+     * @returns      a pointer to a cursor over the qualifying rows (freed by caller)
+     */
+    virtual HeapTableCursor *cursor(const Comparisons *where);
+
+    /**
+     * Parallel form of select(comparisons): the file's blocks are cut into morsels of
+     * MORSEL_BLOCKS consecutive blocks, each filtered by a task on pool.
+     * Only reads the table; it must not be changed by anyone while this runs.
+     * @param where    terms that must all hold (nullptr for every row)
+     * @param pool     workers to scan with
+     * @param ordered  true for handles in the same order select() gives; false
+     *                 for whatever order the morsels finish in (skips the merge)
+     * @returns        a pointer to a list of handles for qualifying rows (freed by caller)
+     */
+    virtual Handles *select(const Comparisons *where, ThreadPool &pool, bool ordered = true);
+
+    /**
+     * number of consecutive blocks in one parallel scan task
+     */
+    static const uint MORSEL_BLOCKS = 16;
+
+    /**
+     * Compile a where clause for scan_block().
+     * @param where  terms that must all hold
+     * @returns      the filter (freed by caller)
+     * @throws       DbRelationError for an unknown column or a value of the wrong type
+     */
+    virtual RowFilter *compile(const Comparisons &where) const { return new RowFilter(codec, where); }
+
+    /**
+     * Number of blocks in the table's file; they are numbered 1 to this.
+     */
+    virtual BlockID get_num_blocks();
+
+    /**
+     * Read one block's qualifying rows, in order, for a caller that wants the values
+     * rather than handles (a query executor scan). The block is pinned only while
+     * its records are decoded.
+     * @param block_id  which block (1 to get_num_blocks())
+     * @param filter    where clause from compile(), or nullptr for every row
+     * @param rows      the rows are added to the batch, each owning its TEXT
+     */
+    virtual void scan_block(BlockID block_id, const RowFilter *filter, RowBatch &rows);
+
+    /**
+     * Compile a decoder of some of the table's columns for scan_block().
+     * @param columns  ordinals of the columns wanted
+     * @returns        the decoder (freed by caller)
+     */
+    virtual ColumnDecoder *decoder(const std::vector<uint> &columns) const { return new ColumnDecoder(codec, columns); }
+
+    /**
+     * Columnar form of scan_block(): the qualifying records' columns are decoded
+     * straight into the batch's column vectors.
+     * @param block_id  which block (1 to get_num_blocks())
+     * @param filter    where clause from compile(), or nullptr for every row
+     * @param decoder   columns wanted, from decoder()
+     * @param batch     the rows are added to the batch (its columns as decoder's)
+     */
+    virtual void scan_block(BlockID block_id, const RowFilter *filter, const ColumnDecoder &decoder,
+                            ColumnBatch &batch);
+
     virtual ValueDict *project(Handle handle);
 
     virtual ValueDict *project(Handle handle, const ColumnNames *column_names);
 
+    /**
+     * Read all of a row's columns, in column order.
+     * @param handle  row to get values from
+     * @param row     receives the values (owning its TEXT)
+     */
+    virtual void project(Handle handle, Row &row);
+
+    /**
+     * Column ordinal for a name, or -1 if the table has no such column.
+     */
+    virtual int ordinal(const Identifier &column_name) const { return codec.ordinal(column_name); }
+
+    /**
+     * Before a change: claim the table for this thread's open transaction, if any.
+     * @throws  DbRelationError if another open transaction has changes to the table pending
+     *          (or, outside any transaction, if any open transaction has)
+     */
+    virtual void claim();
+
+    /**
+     * Keep an index up to date from now on as rows are inserted, updated, and deleted.
+     * @param index  an open index on this table (not owned; remove it before it goes away)
+     */
+    virtual void add_index(DbIndex *index);
+
+    virtual void remove_index(DbIndex *index);
+
+    virtual const std::vector<DbIndex *> &get_indices() const { return indices; }
+
 protected:
     HeapFile file;
+    RowCodec codec;
+    std::vector<DbIndex *> indices;
+
+    virtual void index_insert(Handle handle);
+
+    virtual DbIndex *index_for(const ValueDict *where) const;
+
+    virtual void validate(const ValueDict *row, Row &full_row);
 
-    virtual ValueDict *validate(const ValueDict *row);
+    virtual Handle append(const Row &row);
 
-    virtual Handle append(const ValueDict *row);
+    virtual Dbt *marshal(const Row &row);
 
-    virtual Dbt *marshal(const ValueDict *row);
+    virtual u_int32_t marshal(const Row &row, char *bytes);
 
     virtual ValueDict *unmarshal(Dbt *data);
 };
@@ -0,0 +1,777 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "planner.h"
+#include "hash_join.h"
+#include "hash_aggregate.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+
+using namespace hsql;
+
+// tables smaller than this many blocks are aggregated without starting any workers
+static const BlockID PARALLEL_BLOCKS = 4 * HeapTable::MORSEL_BLOCKS;
+
+// The Comparison::Op for a comparison operator expression; false if expr isn't one
+static bool comparison_op(const Expr *expr, Comparison::Op &op) {
+  if (expr == nullptr || expr->type != kExprOperator)
+    return false;
+  switch (expr->opType) {
+    case Expr::SIMPLE_OP:
+      switch (expr->opChar) {
+        case '=': op = Comparison::EQ; return true;
+        case '<': op = Comparison::LT; return true;
+        case '>': op = Comparison::GT; return true;
+        default: return false;
+      }
+    case Expr::NOT_EQUALS: op = Comparison::NE; return true;
+    case Expr::LESS_EQ: op = Comparison::LE; return true;
+    case Expr::GREATER_EQ: op = Comparison::GE; return true;
+    default: return false;
+  }
+}
+
+// a op b is the same as b flipped(op) a
+static Comparison::Op flipped(Comparison::Op op) {
+  switch (op) {
+    case Comparison::LT: return Comparison::GT;
+    case Comparison::LE: return Comparison::GE;
+    case Comparison::GT: return Comparison::LT;
+    case Comparison::GE: return Comparison::LE;
+    default: return op;
+  }
+}
+
+// The aggregate a function call names; false if it isn't one
+static bool aggregate_function(const Expr *expr, VectorAggregate::Function &function) {
+  std::string name = expr->name;
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+  if (name == "count")
+    function = VectorAggregate::COUNT;
+  else if (name == "sum")
+    function = VectorAggregate::SUM;
+  else if (name == "min")
+    function = VectorAggregate::MIN;
+  else if (name == "max")
+    function = VectorAggregate::MAX;
+  else if (name == "avg")
+    function = VectorAggregate::AVG;
+  else
+    return false;
+  return true;
+}
+
+// The select list column an ORDER BY item names, by position or by output name; false if neither
+static bool output_column(const Expr *item, const ColumnNames &names, uint &column) {
+  if (item->type == kExprLiteralInt) {
+    if (item->ival < 1 || item->ival > (int64_t) names.size())
+      throw DbRelationError("ORDER BY position " + std::to_string(item->ival) + " is not in the select list");
+    column = (uint) item->ival - 1;
+    return true;
+  }
+  if (item->type != kExprColumnRef || item->table != nullptr)
+    return false;
+  bool found = false;
+  for (uint i = 0; i < names.size(); i++) {
+    if (names[i] != item->name)
+      continue;
+    if (found)
+      throw DbRelationError(std::string("ORDER BY column ") + item->name + " is ambiguous");
+    column = i;
+    found = true;
+  }
+  return found;
+}
+
+// An aggregate's output name: its alias, or its function's name
+static std::string aggregate_name(const Expr *expr) {
+  if (expr->alias != nullptr)
+    return expr->alias;
+  std::string name = expr->name;
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+  return name;
+}
+
+QueryOperator *QueryPlanner::plan(const SelectStatement *select, const Bindings *bindings) {
+  if (select->selectDistinct || select->unionSelect != nullptr)
+    throw DbRelationError("DISTINCT and UNION are not implemented");
+
+  bool grouped = select->groupBy != nullptr;
+  for (auto const& expr: *select->selectList) {
+    VectorAggregate::Function function;
+    grouped = grouped || (expr->type == kExprFunctionRef && aggregate_function(expr, function));
+  }
+
+  QueryOperator *plan = nullptr;
+  if (select->groupBy == nullptr)
+    plan = this->plan_vector(select, bindings);
+  if (plan == nullptr)
+    plan = grouped ? this->plan_aggregate(select, bindings) : this->plan_rows(select, bindings);
+  if (select->limit != nullptr && select->limit->limit >= 0)
+    plan = new Limit(plan, (u_int64_t) select->limit->limit,
+                     select->limit->offset > 0 ? (u_int64_t) select->limit->offset : 0);
+  return plan;
+}
+
+QueryOperator *QueryPlanner::plan_rows(const SelectStatement *select, const Bindings *bindings) {
+  for (auto const& expr: *select->selectList)
+    if (expr->type == kExprFunctionRef)
+      throw DbRelationError(std::string("function ") + expr->name + " is not implemented");
+
+  Scope scope;
+  QueryOperator *input = this->plan_from(select->fromTable, select->whereClause, bindings, scope);
+  std::vector<Expression *> expressions;
+  ColumnNames names;
+  SortKeys keys;
+  size_t visible = 0;
+  try
+    {
+      for (auto const& expr: *select->selectList) {
+        if (expr->type == kExprStar) {
+          size_t before = expressions.size();
+          for (uint column = 0; column < scope.size(); column++) {
+            if (expr->table != nullptr && scope[column].table != expr->table)
+              continue;
+            expressions.push_back(Expression::column(column, scope[column].data_type));
+            names.push_back(scope[column].name);
+          }
+          if (expressions.size() == before && expr->table != nullptr)
+            throw DbRelationError(std::string("unknown table ") + expr->table);
+          continue;
+        }
+        expressions.push_back(this->compile(expr, scope, bindings));
+        if (expr->alias != nullptr)
+          names.push_back(expr->alias);
+        else if (expr->type == kExprColumnRef)
+          names.push_back(expr->name);
+        else
+          names.push_back("?column?");
+      }
+      visible = names.size();
+
+      // an ORDER BY item that isn't an output column is computed alongside them, then dropped
+      if (select->order != nullptr) {
+        for (auto const& item: *select->order) {
+          SortKey key;
+          key.descending = item->type == kOrderDesc;
+          if (!output_column(item->expr, names, key.column)) {
+            expressions.push_back(this->compile(item->expr, scope, bindings));
+            names.push_back("?sort?");
+            key.column = (uint) expressions.size() - 1;
+          }
+          keys.push_back(key);
+        }
+      }
+    }
+  catch(...)
+    {
+      for (auto const& expression: expressions)
+        delete expression;
+      delete input;
+      throw;
+    }
+
+  QueryOperator *plan = new Project(input, expressions, names);
+  if (keys.empty())
+    return plan;
+  plan = this->sort(plan, keys, select);
+  if (names.size() > visible) {
+    ColumnAttributes column_attributes = plan->get_column_attributes();
+    expressions.clear();
+    for (uint column = 0; column < visible; column++)
+      expressions.push_back(Expression::column(column, column_attributes[column].get_data_type()));
+    names.resize(visible);
+    plan = new Project(plan, expressions, names);
+  }
+  return plan;
+}
+
+// GROUP BY, or aggregates plan_vector can't take: a HashAggregate of the FROM rows (of
+// the table itself, scanned by several workers, if the WHERE goes entirely into the scan),
+// then a Project into select list order
+QueryOperator *QueryPlanner::plan_aggregate(const SelectStatement *select, const Bindings *bindings) {
+  if (select->groupBy != nullptr && select->groupBy->having != nullptr)
+    throw DbRelationError("HAVING is not implemented");
+
+  Scope scope;
+  HeapTable *table = nullptr;
+  Comparisons pushed;
+  if (select->fromTable != nullptr && select->fromTable->type == kTableName) {
+    table = &this->add_table(select->fromTable, scope);
+    std::vector<const Expr *> terms;
+    conjuncts(select->whereClause, terms);
+    for (auto const& term: terms) {
+      Comparison comparison("", Comparison::EQ, Value());
+      if (!this->pushable(term, scope, bindings, comparison)) {
+        table = nullptr;
+        scope.clear();
+        break;
+      }
+      pushed.push_back(comparison);
+    }
+  }
+  QueryOperator *input = nullptr;
+  if (table == nullptr)
+    input = this->plan_from(select->fromTable, select->whereClause, bindings, scope);
+
+  std::vector<uint> groups;
+  HashAggregate::Aggregates aggregates;
+  std::vector<uint> outputs;  // per select list item: which of the aggregate's columns
+  std::vector<int> selected;  // per select list item: its column of scope, or -1 for an aggregate
+  ColumnNames names;
+  ColumnNames aggregate_names;
+  try
+    {
+      if (select->groupBy != nullptr) {
+        for (auto const& item: *select->groupBy->columns) {
+          if (item->type != kExprColumnRef)
+            throw DbRelationError("GROUP BY takes columns");
+          uint column = this->resolve(item, scope);
+          if (std::find(groups.begin(), groups.end(), column) == groups.end())
+            groups.push_back(column);
+        }
+      }
+      for (auto const& expr: *select->selectList) {
+        if (expr->type == kExprFunctionRef) {
+          outputs.push_back((uint) (groups.size() + aggregates.size()));
+          selected.push_back(-1);
+          aggregates.push_back(this->aggregate(expr, scope));
+          names.push_back(aggregate_name(expr));
+          aggregate_names.push_back(names.back());
+        } else if (expr->type == kExprColumnRef) {
+          uint column = this->resolve(expr, scope);
+          auto group = std::find(groups.begin(), groups.end(), column);
+          if (group == groups.end())
+            throw DbRelationError(std::string("column ") + expr->name + " must be in GROUP BY or in an aggregate");
+          outputs.push_back((uint) (group - groups.begin()));
+          selected.push_back((int) column);
+          names.push_back(expr->alias != nullptr ? expr->alias : expr->name);
+        } else {
+          throw DbRelationError("a grouped select list takes columns and aggregates");
+        }
+      }
+    }
+  catch(...)
+    {
+      delete input;
+      throw;
+    }
+
+  ColumnNames aggregate_columns;
+  for (auto const& column: groups)
+    aggregate_columns.push_back(scope[column].name);
+  aggregate_columns.insert(aggregate_columns.end(), aggregate_names.begin(), aggregate_names.end());
+  QueryOperator *plan;
+  if (table != nullptr)
+    plan = new HashAggregate(*table, pushed, groups, aggregates, aggregate_columns,
+                             table->get_num_blocks() >= PARALLEL_BLOCKS ? 0 : 1);
+  else
+    plan = new HashAggregate(input, groups, aggregates, aggregate_columns);
+
+  ColumnAttributes column_attributes = plan->get_column_attributes();
+  std::vector<Expression *> expressions;
+  for (auto const& output: outputs)
+    expressions.push_back(Expression::column(output, column_attributes[output].get_data_type()));
+  plan = new Project(plan, expressions, names);
+
+  if (select->order != nullptr) {
+    SortKeys keys;
+    try
+      {
+        for (auto const& item: *select->order) {
+          SortKey key;
+          key.descending = item->type == kOrderDesc;
+          if (!output_column(item->expr, names, key.column)) {
+            // or a (qualified) FROM column that is in the select list
+            auto found = selected.end();
+            if (item->expr->type == kExprColumnRef)
+              found = std::find(selected.begin(), selected.end(), (int) this->resolve(item->expr, scope));
+            if (found == selected.end())
+              throw DbRelationError("ORDER BY of a grouped query must name a select list column");
+            key.column = (uint) (found - selected.begin());
+          }
+          keys.push_back(key);
+        }
+      }
+    catch(...)
+      {
+        delete plan;
+        throw;
+      }
+    plan = this->sort(plan, keys, select);
+  }
+  return plan;
+}
+
+// The aggregate a function call computes, over a column of scope (-1 for COUNT(*))
+VectorAggregate::Aggregate QueryPlanner::aggregate(const Expr *expr, const Scope &scope) const {
+  VectorAggregate::Aggregate aggregate;
+  if (!aggregate_function(expr, aggregate.function))
+    throw DbRelationError(std::string("function ") + expr->name + " is not implemented");
+  const Expr *argument = expr->expr;
+  if (argument == nullptr && expr->exprList != nullptr && expr->exprList->size() == 1)
+    argument = expr->exprList->front();
+  if (argument != nullptr && argument->type == kExprStar && aggregate.function == VectorAggregate::COUNT) {
+    aggregate.column = -1;
+  } else if (argument != nullptr && argument->type == kExprColumnRef) {
+    uint column = this->resolve(argument, scope);
+    if (aggregate.function != VectorAggregate::COUNT && scope[column].data_type != ColumnAttribute::INT)
+      throw DbRelationError(std::string(expr->name) + " needs an INT column");
+    aggregate.column = (int) column;
+  } else {
+    throw DbRelationError(std::string(expr->name) + " takes a column");
+  }
+  return aggregate;
+}
+
+// A single table, a WHERE of column-vs-constant and column-vs-column terms, and a
+// select list of columns or of aggregates run on column vectors; for anything else
+// this gives nullptr.
+QueryOperator *QueryPlanner::plan_vector(const SelectStatement *select, const Bindings *bindings) {
+  const TableRef *from = select->fromTable;
+  if (from == nullptr || from->type != kTableName)
+    return nullptr;
+  Scope scope;
+  HeapTable &table = this->add_table(from, scope);
+
+  // the scan decodes just the columns used, in the order first used
+  std::vector<uint> decoded;
+  auto position = [&decoded](uint column) {
+    for (uint i = 0; i < decoded.size(); i++)
+      if (decoded[i] == column)
+        return i;
+    decoded.push_back(column);
+    return (uint) decoded.size() - 1;
+  };
+
+  std::vector<const Expr *> terms;
+  conjuncts(select->whereClause, terms);
+  Comparisons pushed;
+  std::vector<const Expr *> compared;
+  for (auto const& term: terms) {
+    Comparison comparison("", Comparison::EQ, Value());
+    Comparison::Op op;
+    if (this->pushable(term, scope, bindings, comparison)) {
+      pushed.push_back(comparison);
+    } else if (comparison_op(term, op) && term->expr->type == kExprColumnRef && term->expr2->type == kExprColumnRef) {
+      if (scope[this->resolve(term->expr, scope)].data_type != scope[this->resolve(term->expr2, scope)].data_type)
+        throw DbRelationError("cannot compare INT with TEXT");
+      compared.push_back(term);
+    } else {
+      return nullptr;
+    }
+  }
+
+  VectorAggregate::Aggregates aggregates;
+  std::vector<uint> columns;
+  ColumnNames names;
+  bool other = false;
+  for (auto const& expr: *select->selectList) {
+    if (expr->type == kExprFunctionRef) {
+      VectorAggregate::Aggregate aggregate = this->aggregate(expr, scope);
+      if (aggregate.column >= 0)
+        aggregate.column = (int) position((uint) aggregate.column);
+      aggregates.push_back(aggregate);
+      names.push_back(aggregate_name(expr));
+    } else if (expr->type == kExprStar) {
+      size_t before = columns.size();
+      for (uint column = 0; column < scope.size(); column++) {
+        if (expr->table != nullptr && scope[column].table != expr->table)
+          continue;
+        columns.push_back(position(column));
+        names.push_back(scope[column].name);
+      }
+      if (columns.size() == before && expr->table != nullptr)
+        throw DbRelationError(std::string("unknown table ") + expr->table);
+    } else if (expr->type == kExprColumnRef) {
+      columns.push_back(position(this->resolve(expr, scope)));
+      names.push_back(expr->alias != nullptr ? expr->alias : expr->name);
+    } else {
+      other = true;
+    }
+  }
+  if (!aggregates.empty() && (other || !columns.empty()))
+    throw DbRelationError("columns alongside aggregates need GROUP BY");
+  if (other)
+    return nullptr;
+
+  // sort the rows if ORDER BY names only output columns (aggregates give just one row)
+  SortKeys keys;
+  if (select->order != nullptr) {
+    for (auto const& item: *select->order) {
+      SortKey key;
+      key.descending = item->type == kOrderDesc;
+      if (!output_column(item->expr, names, key.column)) {
+        if (!aggregates.empty())
+          throw DbRelationError("ORDER BY of aggregates must name one of them");
+        return nullptr;
+      }
+      if (aggregates.empty())
+        keys.push_back(key);
+    }
+  }
+
+  VectorComparisons comparisons;
+  for (auto const& term: compared) {
+    Comparison::Op op;
+    comparison_op(term, op);
+    uint left = position(this->resolve(term->expr, scope));
+    comparisons.push_back(VectorComparison(left, op, position(this->resolve(term->expr2, scope))));
+  }
+  VectorOperator *plan = new VectorScan(table, decoded, pushed);
+  if (!comparisons.empty())
+    plan = new VectorFilter(plan, comparisons);
+  if (!aggregates.empty())
+    plan = new VectorAggregate(plan, aggregates, names);
+  else
+    plan = new VectorProject(plan, columns, names);
+  if (keys.empty())
+    return new VectorRows(plan);
+  return this->sort(new VectorRows(plan), keys, select);
+}
+
+// A TopN if the query's LIMIT (plus OFFSET) is small enough to hold, else an ExternalSort
+QueryOperator *QueryPlanner::sort(QueryOperator *plan, const SortKeys &keys, const SelectStatement *select) {
+  if (select->limit != nullptr && select->limit->limit >= 0) {
+    u_int64_t rows = (u_int64_t) select->limit->limit + (select->limit->offset > 0 ? select->limit->offset : 0);
+    if (rows <= TopN::MAX_ROWS)
+      return new TopN(plan, keys, rows);
+  }
+  return new ExternalSort(plan, keys);
+}
+
+// True if every column expr names is in scope
+bool QueryPlanner::covers(const Expr *expr, const Scope &scope) {
+  if (expr == nullptr)
+    return true;
+  if (expr->type == kExprColumnRef) {
+    for (auto const& column: scope)
+      if (column.name == expr->name && (expr->table == nullptr || column.table == expr->table))
+        return true;
+    return false;
+  }
+  if (expr->exprList != nullptr)
+    for (auto const& item: *expr->exprList)
+      if (!covers(item, scope))
+        return false;
+  return covers(expr->expr, scope) && covers(expr->expr2, scope);
+}
+
+// Remove from terms, and return, the ones scope has every column for
+std::vector<const Expr *> QueryPlanner::take(std::vector<const Expr *> &terms, const Scope &scope) {
+  std::vector<const Expr *> taken, rest;
+  for (auto const& term: terms)
+    (covers(term, scope) ? taken : rest).push_back(term);
+  terms.swap(rest);
+  return taken;
+}
+
+QueryOperator *QueryPlanner::plan_from(const TableRef *from, const Expr *where, const Bindings *bindings,
+                                       Scope &scope) {
+  std::vector<const Expr *> terms;
+  conjuncts(where, terms);
+  BlockID blocks;
+  QueryOperator *plan = this->plan_table(from, terms, bindings, scope, blocks);
+  // whatever no table took names an unknown column, which compiling it reports
+  return this->add_filter(plan, terms, scope, bindings);
+}
+
+// A FROM item, taking from terms the ones it can apply; blocks is how big it is
+QueryOperator *QueryPlanner::plan_table(const TableRef *from, std::vector<const Expr *> &terms,
+                                        const Bindings *bindings, Scope &scope, BlockID &blocks) {
+  if (from->type == kTableName)
+    return this->plan_scan(from, terms, bindings, scope, blocks);
+
+  if (from->type == kTableCrossProduct) {
+    // FROM a, b, ...: joined left to right, with keys from the WHERE clause
+    QueryOperator *plan = this->plan_table(from->list->at(0), terms, bindings, scope, blocks);
+    for (size_t i = 1; i < from->list->size(); i++)
+      plan = this->plan_join(plan, scope, blocks, from->list->at(i), false, terms, bindings);
+    return plan;
+  }
+
+  if (from->type != kTableJoin)
+    throw DbRelationError("subqueries in FROM are not implemented");
+  const JoinDefinition *join = from->join;
+  if (join->type != kJoinInner && join->type != kJoinNatural)
+    throw DbRelationError("only inner and natural joins are implemented");
+  // for an inner join, ON terms are just more terms
+  conjuncts(join->condition, terms);
+  QueryOperator *plan = this->plan_table(join->left, terms, bindings, scope, blocks);
+  return this->plan_join(plan, scope, blocks, join->right, join->type == kJoinNatural, terms, bindings);
+}
+
+// A TableScan, taking the simple terms; the rest of the ones on this table go to a Filter
+QueryOperator *QueryPlanner::plan_scan(const TableRef *from, std::vector<const Expr *> &terms,
+                                       const Bindings *bindings, Scope &scope, BlockID &blocks) {
+  HeapTable &table = this->add_table(from, scope);
+  blocks = table.get_num_blocks();
+  std::vector<const Expr *> residual;
+  Comparisons pushed;
+  for (auto const& term: take(terms, scope)) {
+    Comparison comparison("", Comparison::EQ, Value());
+    if (this->pushable(term, scope, bindings, comparison))
+      pushed.push_back(comparison);
+    else
+      residual.push_back(term);
+  }
+  return this->add_filter(new TableScan(table, pushed), residual, scope, bindings);
+}
+
+// A HashJoin of left (already planned, with scope and blocks) and right. The keys are
+// the common columns for a natural join, else the terms equating a left column with a
+// right one. On return scope and blocks are the join's.
+QueryOperator *QueryPlanner::plan_join(QueryOperator *left, Scope &scope, BlockID &blocks, const TableRef *right_ref,
+                                       bool natural, std::vector<const Expr *> &terms, const Bindings *bindings) {
+  Scope right_scope;
+  BlockID right_blocks;
+  QueryOperator *right;
+  try
+    {
+      right = this->plan_table(right_ref, terms, bindings, right_scope, right_blocks);
+    }
+  catch(...)
+    {
+      delete left;
+      throw;
+    }
+
+  std::vector<uint> left_keys, right_keys;
+  std::vector<bool> dropped(right_scope.size(), false);  // a natural join's common columns, from the right
+  if (natural) {
+    for (uint l = 0; l < scope.size(); l++) {
+      for (uint r = 0; r < right_scope.size(); r++) {
+        if (!dropped[r] && scope[l].name == right_scope[r].name) {
+          left_keys.push_back(l);
+          right_keys.push_back(r);
+          dropped[r] = true;
+          break;
+        }
+      }
+    }
+  } else {
+    std::vector<const Expr *> rest;
+    for (auto const& term: terms) {
+      Comparison::Op op;
+      const Expr *a = term->expr;
+      const Expr *b = term->expr2;
+      if (!comparison_op(term, op) || op != Comparison::EQ || a->type != kExprColumnRef || b->type != kExprColumnRef) {
+        rest.push_back(term);
+        continue;
+      }
+      if (covers(b, scope) && !covers(b, right_scope))
+        std::swap(a, b);
+      if (!covers(a, scope) || covers(a, right_scope) || !covers(b, right_scope) || covers(b, scope)) {
+        rest.push_back(term);
+        continue;
+      }
+      try
+        {
+          left_keys.push_back(this->resolve(a, scope));
+          right_keys.push_back(this->resolve(b, right_scope));
+        }
+      catch(...)
+        {
+          delete left;
+          delete right;
+          throw;
+        }
+    }
+    terms.swap(rest);
+  }
+  for (uint i = 0; i < left_keys.size(); i++) {
+    if (scope[left_keys[i]].data_type != right_scope[right_keys[i]].data_type) {
+      delete left;
+      delete right;
+      throw DbRelationError("cannot compare INT with TEXT");
+    }
+  }
+
+  // build from the smaller side
+  QueryOperator *plan = new HashJoin(left, right, left_keys, right_keys, blocks < right_blocks);
+  blocks += right_blocks;
+  if (natural) {
+    // keep one copy of each common column
+    std::vector<Expression *> expressions;
+    ColumnNames names;
+    Scope joined;
+    for (uint column = 0; column < scope.size() + right_scope.size(); column++) {
+      const ScopeColumn &from = column < scope.size() ? scope[column] : right_scope[column - scope.size()];
+      if (column >= scope.size() && dropped[column - scope.size()])
+        continue;
+      expressions.push_back(Expression::column(column, from.data_type));
+      names.push_back(from.name);
+      joined.push_back(from);
+    }
+    plan = new Project(plan, expressions, names);
+    scope.swap(joined);
+  } else {
+    scope.insert(scope.end(), right_scope.begin(), right_scope.end());
+  }
+  return this->add_filter(plan, take(terms, scope), scope, bindings);
+}
+
+// plan with a Filter on top for terms (if there are any)
+QueryOperator *QueryPlanner::add_filter(QueryOperator *plan, const std::vector<const Expr *> &terms, const Scope &scope,
+                                        const Bindings *bindings) {
+  Expression *residual = nullptr;
+  try
+    {
+      for (auto const& term: terms) {
+        Expression *condition = this->compile(term, scope, bindings);
+        residual = residual == nullptr ? condition : Expression::binary(Expression::AND, residual, condition);
+      }
+    }
+  catch(...)
+    {
+      delete residual;
+      delete plan;
+      throw;
+    }
+  if (residual != nullptr)
+    plan = new Filter(plan, residual);
+  return plan;
+}
+
+// Find a FROM table and add its columns to scope
+HeapTable &QueryPlanner::add_table(const TableRef *from, Scope &scope) {
+  HeapTable &table = this->tables(from->name);
+  Identifier table_name = from->alias != nullptr ? from->alias : from->name;
+  const ColumnNames &column_names = table.get_column_names();
+  const ColumnAttributes &column_attributes = table.get_column_attributes();
+  for (uint column = 0; column < column_names.size(); column++) {
+    ColumnAttribute attribute = column_attributes[column];
+    scope.push_back(ScopeColumn{table_name, column_names[column], attribute.get_data_type()});
+  }
+  return table;
+}
+
+uint QueryPlanner::resolve(const Expr *column_ref, const Scope &scope) const {
+  int found = -1;
+  for (uint column = 0; column < scope.size(); column++) {
+    if (scope[column].name != column_ref->name)
+      continue;
+    if (column_ref->table != nullptr && scope[column].table != column_ref->table)
+      continue;
+    if (found >= 0)
+      throw DbRelationError(std::string("column ") + column_ref->name + " is ambiguous");
+    found = (int) column;
+  }
+  if (found < 0)
+    throw DbRelationError(std::string("unknown column ") + column_ref->name);
+  return (uint) found;
+}
+
+Expression *QueryPlanner::compile(const Expr *expr, const Scope &scope, const Bindings *bindings) const {
+  Value value;
+  if (constant(expr, bindings, value))
+    return Expression::constant(value);
+  if (expr->type == kExprColumnRef) {
+    uint column = this->resolve(expr, scope);
+    return Expression::column(column, scope[column].data_type);
+  }
+  if (expr->type != kExprOperator)
+    throw DbRelationError("unsupported expression");
+
+  if (expr->opType == Expr::NOT)
+    return Expression::unary(Expression::NOT, this->compile(expr->expr, scope, bindings));
+  if (expr->opType == Expr::UMINUS)
+    return Expression::unary(Expression::NEGATE, this->compile(expr->expr, scope, bindings));
+
+  Comparison::Op op;
+  Expression::Kind kind = Expression::AND;
+  bool is_comparison = comparison_op(expr, op);
+  if (!is_comparison) {
+    if (expr->opType == Expr::AND) {
+      kind = Expression::AND;
+    } else if (expr->opType == Expr::OR) {
+      kind = Expression::OR;
+    } else if (expr->opType == Expr::SIMPLE_OP) {
+      switch (expr->opChar) {
+        case '+': kind = Expression::ADD; break;
+        case '-': kind = Expression::SUBTRACT; break;
+        case '*': kind = Expression::MULTIPLY; break;
+        case '/': kind = Expression::DIVIDE; break;
+        case '%': kind = Expression::MODULO; break;
+        default: throw DbRelationError(std::string("unsupported operator ") + expr->opChar);
+      }
+    } else {
+      throw DbRelationError("unsupported operator");
+    }
+  }
+  Expression *left = this->compile(expr->expr, scope, bindings);
+  Expression *right;
+  try
+    {
+      right = this->compile(expr->expr2, scope, bindings);
+    }
+  catch(...)
+    {
+      delete left;
+      throw;
+    }
+  if (is_comparison)
+    return Expression::compare(op, left, right);
+  return Expression::binary(kind, left, right);
+}
+
+bool QueryPlanner::constant(const Expr *expr, const Bindings *bindings, Value &value) {
+  switch (expr->type) {
+    case kExprLiteralInt:
+      if (expr->ival < INT_MIN || expr->ival > INT_MAX)
+        throw DbRelationError("integer out of range");
+      value = Value((int32_t) expr->ival);
+      return true;
+    case kExprLiteralString:
+      value = Value(std::string(expr->name));
+      return true;
+    case kExprPlaceholder:
+      if (bindings == nullptr || bindings->count(expr) == 0)
+        throw DbRelationError("? parameters need EXECUTE");
+      value = bindings->at(expr);
+      return true;
+    case kExprOperator:
+      if (expr->opType == Expr::UMINUS && expr->expr->type == kExprLiteralInt && expr->expr->ival <= -(int64_t) INT_MIN) {
+        value = Value((int32_t) -expr->expr->ival);
+        return true;
+      }
+      return false;
+    default:
+      return false;
+  }
+}
+
+// A term of the form column op constant (either way round), as a Comparison for the scan
+bool QueryPlanner::pushable(const Expr *term, const Scope &scope, const Bindings *bindings,
+                            Comparison &comparison) const {
+  Comparison::Op op;
+  if (!comparison_op(term, op))
+    return false;
+  const Expr *column_ref = term->expr;
+  const Expr *other = term->expr2;
+  if (column_ref->type != kExprColumnRef) {
+    std::swap(column_ref, other);
+    op = flipped(op);
+  }
+  Value value;
+  if (column_ref->type != kExprColumnRef || !constant(other, bindings, value))
+    return false;
+  uint column = this->resolve(column_ref, scope);
+  if (scope[column].data_type != value.data_type)
+    return false;  // let the Filter report the type error
+  comparison = Comparison(scope[column].name, op, value);
+  return true;
+}
+
+// Split expr at its top-level ANDs
+void QueryPlanner::conjuncts(const Expr *expr, std::vector<const Expr *> &terms) {
+  if (expr == nullptr)
+    return;
+  if (expr->type == kExprOperator && expr->opType == Expr::AND) {
+    conjuncts(expr->expr, terms);
+    conjuncts(expr->expr2, terms);
+  } else {
+    terms.push_back(expr);
+  }
+}
@@ -0,0 +1,145 @@
+/**
+ * @file planner.h - Turns parsed SQL queries into physical query plans.
+ * QueryPlanner
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "SQLParser.h"
+#include "executor.h"
+#include "vector_executor.h"
+#include "external_sort.h"
+#include "heap_storage.h"
+#include "statement_cache.h"
+
+// Finds an open table by name, or throws DbRelationError if there is none
+typedef std::function<HeapTable &(const Identifier &table_name)> TableResolver;
+
+/**
+ * @class QueryPlanner - builds the operator tree for a SELECT
+ *
+ * The plan is a TableScan of the FROM table, a Filter for whatever part of the
+ * WHERE clause the scan can't take itself, a Project for the select list, and a
+ * Limit. The WHERE clause is split at its ANDs; each term that is a column compared
+ * with a constant (or a bound ? parameter) is pushed into the scan, where it is
+ * tested against the records in place.
+ *
+ * Joins (INNER JOIN ... ON, NATURAL JOIN, and FROM a, b, ...) are HashJoins, keyed
+ * on the terms that equate a column of one side with a column of the other (or on
+ * the common columns) and built from the side with fewer blocks. Each term goes to
+ * the lowest point in the plan that has all its columns.
+ *
+ * A query on one table whose WHERE terms are all column-vs-constant or
+ * column-vs-column comparisons, and whose select list is columns or aggregates
+ * (COUNT, SUM, MIN, MAX, AVG), is planned on column vectors instead: a VectorScan
+ * decoding just the columns used, a VectorFilter, and a VectorProject or
+ * VectorAggregate.
+ *
+ * GROUP BY, and aggregates the vector plan can't take (over a join, say), are a
+ * HashAggregate, then a Project into select list order. Over one table whose WHERE
+ * goes entirely into the scan, the HashAggregate scans the table itself, with a
+ * worker per hardware thread once the table is PARALLEL_BLOCKS blocks or more.
+ *
+ * ORDER BY is an ExternalSort over the select list's rows, under the Limit. An
+ * item is a select list position, an output column's name, or any expression over
+ * the FROM columns, which is computed alongside the output and dropped after the sort.
+ * With a LIMIT, and LIMIT + OFFSET no more than TopN::MAX_ROWS, it is a TopN instead,
+ * holding just those rows. The Limit also passes its row goal down, so the scans
+ * under a plain LIMIT read no more than a block or so past it.
+ *
+ * Methods:
+ * 	plan(select, bindings)
+ */
+class QueryPlanner {
+public:
+    /**
+     * @param tables  how to find the tables a query names
+     */
+    QueryPlanner(TableResolver tables) : tables(tables) {}
+
+    virtual ~QueryPlanner() {}
+
+    QueryPlanner(const QueryPlanner &other) = delete;
+
+    QueryPlanner(QueryPlanner &&temp) = delete;
+
+    QueryPlanner &operator=(const QueryPlanner &other) = delete;
+
+    QueryPlanner &operator=(QueryPlanner &&temp) = delete;
+
+    /**
+     * Plan a query.
+     * @param select    the parsed SELECT
+     * @param bindings  values for its ? parameters (nullptr if it has none)
+     * @returns         the plan's root, not yet opened (freed by caller)
+     * @throws          DbRelationError for an unknown table or column, a type error,
+     *                  or a kind of query that isn't handled
+     */
+    virtual QueryOperator *plan(const hsql::SelectStatement *select, const Bindings *bindings = nullptr);
+
+    /**
+     * The value of a constant expression: a literal, a bound ? parameter, or a negated INT.
+     * @param expr      the expression
+     * @param bindings  values for ? parameters (nullptr if there are none)
+     * @param value     set to expr's value
+     * @returns         false if expr isn't constant
+     * @throws          DbRelationError for an unbound parameter or an INT out of range
+     */
+    static bool constant(const hsql::Expr *expr, const Bindings *bindings, Value &value);
+
+protected:
+    // A column an expression can name: which table (name or alias) it comes from, and its type
+    struct ScopeColumn {
+        Identifier table;
+        Identifier name;
+        ColumnAttribute::DataType data_type;
+    };
+    typedef std::vector<ScopeColumn> Scope;
+
+    TableResolver tables;
+
+    virtual QueryOperator *plan_rows(const hsql::SelectStatement *select, const Bindings *bindings);
+
+    virtual QueryOperator *plan_vector(const hsql::SelectStatement *select, const Bindings *bindings);
+
+    virtual QueryOperator *plan_aggregate(const hsql::SelectStatement *select, const Bindings *bindings);
+
+    virtual QueryOperator *sort(QueryOperator *plan, const SortKeys &keys, const hsql::SelectStatement *select);
+
+    virtual VectorAggregate::Aggregate aggregate(const hsql::Expr *expr, const Scope &scope) const;
+
+    virtual HeapTable &add_table(const hsql::TableRef *from, Scope &scope);
+
+    virtual QueryOperator *plan_from(const hsql::TableRef *from, const hsql::Expr *where, const Bindings *bindings,
+                                     Scope &scope);
+
+    virtual QueryOperator *plan_table(const hsql::TableRef *from, std::vector<const hsql::Expr *> &terms,
+                                      const Bindings *bindings, Scope &scope, BlockID &blocks);
+
+    virtual QueryOperator *plan_scan(const hsql::TableRef *from, std::vector<const hsql::Expr *> &terms,
+                                     const Bindings *bindings, Scope &scope, BlockID &blocks);
+
+    virtual QueryOperator *plan_join(QueryOperator *left, Scope &scope, BlockID &blocks, const hsql::TableRef *right,
+                                     bool natural, std::vector<const hsql::Expr *> &terms, const Bindings *bindings);
+
+    virtual QueryOperator *add_filter(QueryOperator *plan, const std::vector<const hsql::Expr *> &terms,
+                                      const Scope &scope, const Bindings *bindings);
+
+    virtual uint resolve(const hsql::Expr *column_ref, const Scope &scope) const;
+
+    virtual Expression *compile(const hsql::Expr *expr, const Scope &scope, const Bindings *bindings) const;
+
+    virtual bool pushable(const hsql::Expr *term, const Scope &scope, const Bindings *bindings,
+                          Comparison &comparison) const;
+
+    static void conjuncts(const hsql::Expr *expr, std::vector<const hsql::Expr *> &terms);
+
+    static bool covers(const hsql::Expr *expr, const Scope &scope);
+
+    static std::vector<const hsql::Expr *> take(std::vector<const hsql::Expr *> &terms, const Scope &scope);
+};
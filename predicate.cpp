@@ -0,0 +1,124 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "predicate.h"
+#include "heap_storage.h"
+#include <algorithm>
+#include <cstring>
+
+RowFilter::RowFilter(const RowCodec &codec, const Comparisons &comparisons): codec(codec), num_int_terms(0)
+{
+  for (auto const& comparison: comparisons) {
+    add(comparison.column_name, comparison.op, comparison.value);
+  }
+  order();
+}
+
+RowFilter::RowFilter(const RowCodec &codec, const ValueDict &where): codec(codec), num_int_terms(0)
+{
+  for (auto const& term: where) {
+    add(term.first, Comparison::EQ, term.second);
+  }
+  order();
+}
+
+void RowFilter::add(const Identifier &column_name, Comparison::Op op, const Value &value) {
+  int column = this->codec.ordinal(column_name);
+  if (column < 0) {
+    throw DbRelationError("unknown column " + column_name + " in where clause");
+  }
+  if (value.data_type != this->codec.get_data_type(column)) {
+    throw DbRelationError("wrong type for column " + column_name + " in where clause");
+  }
+  Term term;
+  term.column = column;
+  term.op = op;
+  term.data_type = value.data_type;
+  term.n = value.n;
+  term.s = value.s;
+  this->terms.push_back(term);
+}
+
+// INTs first: a failed INT compare saves looking at any TEXT
+void RowFilter::order() {
+  std::stable_sort(this->terms.begin(), this->terms.end(), [](const Term &a, const Term &b) {
+    return a.data_type == ColumnAttribute::DataType::INT && b.data_type != ColumnAttribute::DataType::INT;
+  });
+  this->num_int_terms = 0;
+  while (this->num_int_terms < this->terms.size() &&
+         this->terms[this->num_int_terms].data_type == ColumnAttribute::DataType::INT)
+    this->num_int_terms++;
+}
+
+bool RowFilter::matches(const RecordView &record) const {
+  return matches(record, 0);
+}
+
+bool RowFilter::matches(const RecordView &record, size_t first_term) const {
+  for (size_t i = first_term; i < this->terms.size(); i++) {
+    const Term &term = this->terms[i];
+    int cmp;
+    if (term.data_type == ColumnAttribute::DataType::INT) {
+      int32_t n = this->codec.get_int(record, term.column);
+      cmp = n < term.n ? -1 : (n > term.n ? 1 : 0);
+    } else {
+      // byte-wise, shorter sorts first on a tie
+      RecordView text = this->codec.get_text(record, term.column);
+      size_t common = std::min((size_t) text.size, term.s.length());
+      cmp = common == 0 ? 0 : memcmp(text.data, term.s.data(), common);
+      if (cmp == 0)
+        cmp = text.size < term.s.length() ? -1 : (text.size > term.s.length() ? 1 : 0);
+    }
+    if (!holds(cmp, term.op))
+      return false;
+  }
+  return true;
+}
+
+void RowFilter::select(SlottedPage *block, RecordIDs &record_ids) const {
+  if (this->num_int_terms > 0) {
+    u_int32_t num_records = block->get_num_records();
+    std::vector<u_int64_t> bitmap((num_records + 63) / 64, ~(u_int64_t) 0);
+    for (size_t i = 0; i < this->num_int_terms; i++) {
+      const Term &term = this->terms[i];
+      block->filter_int(this->codec.get_offset(term.column), term.op, term.n, bitmap.data());
+    }
+
+    RecordView record;
+    for (size_t word = 0; word < bitmap.size(); word++) {
+      for (u_int64_t bits = bitmap[word]; bits != 0; bits &= bits - 1) {
+        RecordID record_id = (RecordID) (word * 64 + __builtin_ctzll(bits) + 1);
+        if (this->num_int_terms == this->terms.size() ||
+            (block->view(record_id, record) && matches(record, this->num_int_terms)))
+          record_ids.push_back(record_id);
+      }
+    }
+    return;
+  }
+
+  RecordIDs *ids = block->ids();
+  RecordView record;
+  for (auto const& record_id: *ids) {
+    if (block->view(record_id, record) && matches(record))
+      record_ids.push_back(record_id);
+  }
+  delete ids;
+}
+
+bool RowFilter::holds(int cmp, Comparison::Op op) {
+  switch (op) {
+    case Comparison::EQ:
+      return cmp == 0;
+    case Comparison::NE:
+      return cmp != 0;
+    case Comparison::LT:
+      return cmp < 0;
+    case Comparison::LE:
+      return cmp <= 0;
+    case Comparison::GT:
+      return cmp > 0;
+    case Comparison::GE:
+      return cmp >= 0;
+  }
+  return false;
+}
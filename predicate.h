@@ -0,0 +1,115 @@
+/**
+ * @file predicate.h - Where-clause predicates evaluated on marshaled records.
+ * Comparison
+ * RowFilter
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "row_codec.h"
+
+class SlottedPage;
+
+/**
+ * @class Comparison - one where-clause term: <column_name> <op> <value>
+ */
+class Comparison {
+public:
+    enum Op {
+        EQ, NE, LT, LE, GT, GE
+    };
+
+    Identifier column_name;
+    Op op;
+    Value value;
+
+    Comparison(Identifier column_name, Op op, Value value) : column_name(column_name), op(op), value(value) {}
+};
+
+// a where clause: all of its Comparisons must hold
+typedef std::vector<Comparison> Comparisons;
+
+
+/**
+ * @class RowFilter - a where clause compiled against a table's RowCodec
+ *
+ * Each term is resolved to a column ordinal once, up front, and then tested
+ * directly against the marshaled bytes of a record: an INT term is one load at
+ * the column's fixed offset and an integer compare, a TEXT term is a byte
+ * compare against the column's bytes in place. Nothing is decoded or allocated
+ * per record. INT terms are tested before TEXT terms since they are cheaper.
+ * When filtering a whole block, the INT terms are run column-at-a-time over all
+ * of its slots by a filter kernel (see filter_kernels.h) into a selection bitmap,
+ * and only the records that survive are looked at for the TEXT terms.
+ *
+ * Methods:
+ * 	empty()
+ * 	matches(record)
+ * 	select(block, record_ids)
+ */
+class RowFilter {
+public:
+    /**
+     * @param codec        the table's codec (must outlive the filter)
+     * @param comparisons  terms that must all hold
+     * @throws             DbRelationError for an unknown column or a value of the wrong type
+     */
+    RowFilter(const RowCodec &codec, const Comparisons &comparisons);
+
+    /**
+     * Equality on every column in where (the DbRelation::select(where) form).
+     */
+    RowFilter(const RowCodec &codec, const ValueDict &where);
+
+    virtual ~RowFilter() {}
+
+    RowFilter(const RowFilter &other) = delete;
+
+    RowFilter(RowFilter &&temp) = delete;
+
+    RowFilter &operator=(const RowFilter &other) = delete;
+
+    RowFilter &operator=(RowFilter &&temp) = delete;
+
+    /**
+     * True if there are no terms, so every row qualifies.
+     */
+    virtual bool empty() const { return terms.empty(); }
+
+    /**
+     * Test one marshaled record.
+     */
+    virtual bool matches(const RecordView &record) const;
+
+    /**
+     * Append the ids of the block's live records that qualify.
+     * @param block       block to filter
+     * @param record_ids  receives the qualifying record ids, in order
+     */
+    virtual void select(SlottedPage *block, RecordIDs &record_ids) const;
+
+protected:
+    struct Term {
+        uint column;
+        Comparison::Op op;
+        ColumnAttribute::DataType data_type;
+        int32_t n;
+        std::string s;
+    };
+
+    const RowCodec &codec;
+    std::vector<Term> terms;
+    size_t num_int_terms;  // terms[0..num_int_terms) are the INT ones
+
+    virtual bool matches(const RecordView &record, size_t first_term) const;
+
+    virtual void add(const Identifier &column_name, Comparison::Op op, const Value &value);
+
+    virtual void order();
+
+    static bool holds(int cmp, Comparison::Op op);
+};
@@ -0,0 +1,180 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "row_codec.h"
+#include <cstring>
+
+RowCodec::RowCodec(const ColumnNames &column_names, const ColumnAttributes &column_attributes):
+        column_names(column_names), text_table(0), text_start(0)
+{
+  uint num_ints = 0;
+  uint num_texts = 0;
+  for (auto const& attribute: column_attributes) {
+    ColumnAttribute ca = attribute;
+    ColumnAttribute::DataType data_type = ca.get_data_type();
+    if (data_type == ColumnAttribute::DataType::INT) {
+      num_ints++;
+    } else if (data_type == ColumnAttribute::DataType::TEXT) {
+      num_texts++;
+    } else {
+      throw DbRelationError("Only know how to marshal INT and TEXT");
+    }
+    this->data_types.push_back(data_type);
+  }
+
+  // lay out the fixed part: INTs first, then the TEXT end-offset table
+  this->text_table = num_ints * sizeof(int32_t);
+  this->text_start = this->text_table + num_texts * sizeof(u_int32_t);
+  u_int32_t next_int = 0;
+  u_int32_t next_text = this->text_table;
+  for (uint column = 0; column < this->data_types.size(); column++) {
+    if (this->data_types[column] == ColumnAttribute::DataType::INT) {
+      this->offsets.push_back(next_int);
+      next_int += sizeof(int32_t);
+    } else {
+      this->offsets.push_back(next_text);
+      next_text += sizeof(u_int32_t);
+    }
+    this->ordinals[column_names[column]] = column;
+  }
+}
+
+int RowCodec::ordinal(const Identifier &column_name) const {
+  auto found = this->ordinals.find(column_name);
+  return found == this->ordinals.end() ? -1 : (int) found->second;
+}
+
+u_int32_t RowCodec::encoded_size(const Row &row) const {
+  u_int32_t size = this->text_start;
+  for (uint column = 0; column < this->data_types.size(); column++) {
+    if (this->data_types[column] == ColumnAttribute::DataType::TEXT) {
+      size += row[column].size;
+    }
+  }
+  return size;
+}
+
+u_int32_t RowCodec::encode(const Row &row, char *bytes, u_int32_t capacity) const {
+  if (this->text_start > capacity) {
+    throw DbRelationError("row too big to marshal");
+  }
+  u_int32_t end = this->text_start;
+  for (uint column = 0; column < this->data_types.size(); column++) {
+    const Field &field = row[column];
+    if (this->data_types[column] == ColumnAttribute::DataType::INT) {
+      memcpy(bytes + this->offsets[column], &field.n, sizeof(int32_t));
+    } else {
+      if (end + field.size > capacity) {
+        throw DbRelationError("row too big to marshal");
+      }
+      if (field.size > 0)
+        memcpy(bytes + end, field.text, field.size);
+      end += field.size;
+      memcpy(bytes + this->offsets[column], &end, sizeof(u_int32_t));
+    }
+  }
+  return end;
+}
+
+void RowCodec::decode(const RecordView &record, Row &row) const {
+  row.resize(this->num_columns());
+  for (uint column = 0; column < this->data_types.size(); column++) {
+    if (this->data_types[column] == ColumnAttribute::DataType::INT) {
+      row.set_int(column, get_int(record, column));
+    } else {
+      RecordView text = get_text(record, column);
+      row.set_text(column, text.data, text.size);
+    }
+  }
+}
+
+void RowCodec::to_row(const ValueDict &dict, Row &row) const {
+  row.resize(this->num_columns());
+  for (uint column = 0; column < this->data_types.size(); column++) {
+    ValueDict::const_iterator value = dict.find(this->column_names[column]);
+    if (value == dict.end()) {
+      throw DbRelationError("don't know how to handle NULLs, defaults, etc. yet");
+    }
+    if (value->second.data_type != this->data_types[column]) {
+      throw DbRelationError("wrong type for column " + this->column_names[column]);
+    }
+    if (this->data_types[column] == ColumnAttribute::DataType::INT) {
+      row.set_int(column, value->second.n);
+    } else {
+      row.set_text(column, value->second.s.data(), (u_int32_t) value->second.s.length());
+    }
+  }
+}
+
+void RowCodec::to_dict(const Row &row, ValueDict &dict) const {
+  for (uint column = 0; column < row.size(); column++) {
+    dict[this->column_names[column]] = row.value(column);
+  }
+}
+
+void RowCodec::decode(const RecordView &record, ValueDict &row) const {
+  for (uint column = 0; column < this->data_types.size(); column++) {
+    row[this->column_names[column]] = get(record, column);
+  }
+}
+
+Value RowCodec::get(const RecordView &record, uint column) const {
+  if (this->data_types[column] == ColumnAttribute::DataType::INT) {
+    return Value(get_int(record, column));
+  }
+  RecordView text = get_text(record, column);
+  return Value(std::string(text.data, text.size));
+}
+
+RecordView RowCodec::get_text(const RecordView &record, uint column) const {
+  u_int32_t slot = this->offsets[column];
+  u_int32_t start = this->text_start;
+  if (slot != this->text_table)
+    memcpy(&start, record.data + slot - sizeof(u_int32_t), sizeof(u_int32_t));
+  u_int32_t end;
+  memcpy(&end, record.data + slot, sizeof(u_int32_t));
+  return RecordView(record.data + start, end - start);
+}
+
+u_int32_t RowCodec::key_size(const KeyValue &key) {
+  u_int32_t size = 0;
+  for (auto const& value: key)
+    size += 1 + (value.data_type == ColumnAttribute::DataType::INT ? sizeof(int32_t) : sizeof(u_int16_t) + (u_int32_t) value.s.length());
+  return size;
+}
+
+void RowCodec::encode_key(const KeyValue &key, char *&at) {
+  for (auto const& value: key) {
+    *at++ = (char) value.data_type;
+    if (value.data_type == ColumnAttribute::DataType::INT) {
+      memcpy(at, &value.n, sizeof(int32_t));
+      at += sizeof(int32_t);
+    } else {
+      u_int16_t length = (u_int16_t) value.s.length();
+      memcpy(at, &length, sizeof(length));
+      at += sizeof(length);
+      memcpy(at, value.s.data(), length);
+      at += length;
+    }
+  }
+}
+
+void RowCodec::decode_key(const char *&at, uint num_columns, KeyValue &key) {
+  key.clear();
+  key.reserve(num_columns);
+  for (uint column = 0; column < num_columns; column++) {
+    ColumnAttribute::DataType data_type = (ColumnAttribute::DataType) *at++;
+    if (data_type == ColumnAttribute::DataType::INT) {
+      int32_t n;
+      memcpy(&n, at, sizeof(n));
+      at += sizeof(n);
+      key.push_back(Value(n));
+    } else {
+      u_int16_t length;
+      memcpy(&length, at, sizeof(length));
+      at += sizeof(length);
+      key.push_back(Value(std::string(at, length)));
+      at += length;
+    }
+  }
+}
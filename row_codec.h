@@ -0,0 +1,151 @@
+/**
+ * @file row_codec.h - Record format for heap table rows.
+ * RowCodec
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "storage_engine.h"
+
+/**
+ * @class RowCodec - encodes/decodes a table's rows, compiled once from its schema
+ *
+ * Record layout:
+ *      INT columns, 4 bytes each, at fixed offsets (in column order)
+ *      one 4-byte entry per TEXT column: offset of the end of that column's bytes
+ *      TEXT bytes, back to back (in column order)
+ * so any INT is one load at a precomputed offset, and any TEXT is found from its
+ * own end offset and the previous TEXT column's (or the start of the TEXT area).
+ * Nothing is allocated while encoding or while reading a single column.
+ * Records sit at arbitrary offsets within a block, so fields are copied in and
+ * out with memcpy rather than dereferenced.
+ *
+ * Methods:
+ * 	ordinal(column_name)
+ * 	encoded_size(row)
+ * 	encode(row, bytes, capacity)
+ * 	decode(record, row)
+ * 	to_row(dict, row)
+ * 	to_dict(row, dict)
+ * 	get(record, column)
+ * 	get_int(record, column)
+ * 	get_text(record, column)
+ * 	key_size(key)
+ * 	encode_key(key, at)
+ * 	decode_key(at, num_columns, key)
+ */
+class RowCodec {
+public:
+    RowCodec(const ColumnNames &column_names, const ColumnAttributes &column_attributes);
+
+    virtual ~RowCodec() {}
+
+    /**
+     * Position of a column in the table.
+     * @param column_name  the column
+     * @returns            its ordinal, or -1 if the table has no such column
+     */
+    virtual int ordinal(const Identifier &column_name) const;
+
+    virtual uint num_columns() const { return (uint) data_types.size(); }
+
+    virtual ColumnAttribute::DataType get_data_type(uint column) const { return data_types[column]; }
+
+    /**
+     * How many bytes encode() will use for a row.
+     * @param row  one Field per column, already of the column's type (see to_row)
+     * @returns    encoded size in bytes
+     */
+    virtual u_int32_t encoded_size(const Row &row) const;
+
+    /**
+     * Encode a row into caller-supplied memory.
+     * @param row       one Field per column, already of the column's type (see to_row)
+     * @param bytes     where to put the record
+     * @param capacity  size of bytes
+     * @returns         number of bytes used
+     * @throws          DbRelationError if the record doesn't fit
+     */
+    virtual u_int32_t encode(const Row &row, char *bytes, u_int32_t capacity) const;
+
+    /**
+     * Decode every column of a record.
+     * @param record  the encoded record
+     * @param row     receives the values keyed by column name
+     */
+    virtual void decode(const RecordView &record, ValueDict &row) const;
+
+    /**
+     * Decode every column of a record into a Row without copying any TEXT:
+     * the Row's TEXT Fields point into the record until row.own().
+     */
+    virtual void decode(const RecordView &record, Row &row) const;
+
+    /**
+     * Convert a ValueDict into a Row in column order. TEXT Fields borrow the dict's strings.
+     * @throws  DbRelationError if a column is missing or has the wrong type
+     */
+    virtual void to_row(const ValueDict &dict, Row &row) const;
+
+    /**
+     * Convert a Row back to a ValueDict keyed by column name.
+     */
+    virtual void to_dict(const Row &row, ValueDict &dict) const;
+
+    /**
+     * Decode a single column without looking at the others.
+     * @param record  the encoded record
+     * @param column  column ordinal
+     * @returns       the column's value
+     */
+    virtual Value get(const RecordView &record, uint column) const;
+
+    /**
+     * Read an INT column in place.
+     */
+    virtual int32_t get_int(const RecordView &record, uint column) const {
+        int32_t n;
+        std::memcpy(&n, record.data + offsets[column], sizeof(n));
+        return n;
+    }
+
+    /**
+     * Borrow a TEXT column's bytes in place.
+     */
+    virtual RecordView get_text(const RecordView &record, uint column) const;
+
+    /**
+     * Byte offset of an INT column within every record.
+     */
+    virtual u_int32_t get_offset(uint column) const { return offsets[column]; }
+
+    /**
+     * Index keys are stored self-describing: per column a type byte, then an INT's
+     * 4 bytes or a TEXT's 2-byte length and bytes.
+     * @returns  bytes encode_key() will use for key
+     */
+    static u_int32_t key_size(const KeyValue &key);
+
+    /**
+     * Encode key at at, advancing at past it.
+     */
+    static void encode_key(const KeyValue &key, char *&at);
+
+    /**
+     * Decode a key of num_columns columns at at, advancing at past it.
+     */
+    static void decode_key(const char *&at, uint num_columns, KeyValue &key);
+
+protected:
+    ColumnNames column_names;
+    std::vector<ColumnAttribute::DataType> data_types;
+    std::vector<u_int32_t> offsets;   // INT: where the value is; TEXT: where its end offset is
+    std::unordered_map<Identifier, uint> ordinals;
+    u_int32_t text_table;             // where the TEXT end offsets start
+    u_int32_t text_start;             // where the TEXT bytes start
+};
@@ -0,0 +1,451 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "schema_tables.h"
+#include <iostream>
+#include <map>
+#include "btree.h"
+#include "hash_index.h"
+#include "transaction.h"
+
+const Identifier SchemaCache::TABLES = "_tables";
+const Identifier SchemaCache::COLUMNS = "_columns";
+const Identifier SchemaCache::INDICES = "_indices";
+
+// A column type as the catalog spells it
+static std::string type_name(ColumnAttribute attribute) {
+  return attribute.get_data_type() == ColumnAttribute::INT ? "INT" : "TEXT";
+}
+
+// The rows of a catalog table that match where
+static ValueDicts catalog_rows(HeapTable &catalog, const ValueDict &where) {
+  ValueDicts rows;
+  Handles *handles = catalog.select(&where);
+  try
+    {
+      for (auto const& handle: *handles) {
+        ValueDict *row = catalog.project(handle);
+        rows.push_back(*row);
+        delete row;
+      }
+    }
+  catch(...)
+    {
+      delete handles;
+      throw;
+    }
+  delete handles;
+  return rows;
+}
+
+// Delete the rows of a catalog table that match where
+static void remove_rows(HeapTable &catalog, const ValueDict &where) {
+  Handles *handles = catalog.select(&where);
+  try
+    {
+      for (auto const& handle: *handles)
+        catalog.del(handle);
+    }
+  catch(...)
+    {
+      delete handles;
+      throw;
+    }
+  delete handles;
+}
+
+// The catalog rows about a table
+static ValueDict about(const Identifier &table_name) {
+  ValueDict where;
+  where["table_name"] = Value(table_name);
+  return where;
+}
+
+
+// SCHEMA CACHE code
+
+SchemaCache::SchemaCache() : tables(nullptr), columns(nullptr), indices(nullptr), hits(0), misses(0) {
+  NoTransaction outside;
+  ColumnAttribute int_type(ColumnAttribute::INT), text_type(ColumnAttribute::TEXT);
+  ColumnNames tables_names = {"table_name"};
+  ColumnAttributes tables_attributes = {text_type};
+  ColumnNames columns_names = {"table_name", "column_name", "ordinal", "data_type"};
+  ColumnAttributes columns_attributes = {text_type, text_type, int_type, text_type};
+  ColumnNames indices_names = {"table_name", "index_name", "seq_in_index", "column_name", "index_type", "is_unique"};
+  ColumnAttributes indices_attributes = {text_type, text_type, int_type, text_type, text_type, int_type};
+
+  bool created_tables, created_columns, created_indices;
+  this->tables = this->open_catalog(TABLES, tables_names, tables_attributes, created_tables);
+  this->columns = this->open_catalog(COLUMNS, columns_names, columns_attributes, created_columns);
+  this->indices = this->open_catalog(INDICES, indices_names, indices_attributes, created_indices);
+
+  // a new catalog starts out describing itself
+  if (created_tables)
+    this->add_to_catalog(TABLES, tables_names, tables_attributes);
+  if (created_columns)
+    this->add_to_catalog(COLUMNS, columns_names, columns_attributes);
+  if (created_indices)
+    this->add_to_catalog(INDICES, indices_names, indices_attributes);
+}
+
+HeapTable &SchemaCache::get_table(const Identifier &table_name) {
+  auto found = this->open_tables.find(table_name);
+  if (found != this->open_tables.end()) {
+    this->hits++;
+    return *found->second.table;
+  }
+  OpenTable *loaded = this->load(table_name);
+  if (loaded == nullptr)
+    throw DbRelationError("unknown table " + table_name);
+  return *loaded->table;
+}
+
+bool SchemaCache::exists(const Identifier &table_name) {
+  return this->open_tables.count(table_name) > 0 || this->load(table_name) != nullptr;
+}
+
+HeapTable &SchemaCache::create_table(const Identifier &table_name, const ColumnNames &column_names,
+                                     const ColumnAttributes &column_attributes) {
+  if (this->exists(table_name))
+    throw DbRelationError("table " + table_name + " already exists");
+  NoTransaction outside;
+  std::unique_ptr<HeapTable> table(new HeapTable(table_name, column_names, column_attributes));
+  try
+    {
+      this->add_to_catalog(table_name, column_names, column_attributes);
+      table->create();
+    }
+  catch(DbException const& e)
+    {
+      this->forget(table_name);
+      throw DbRelationError("cannot create " + table_name + ": " + e.what());
+    }
+  catch(...)
+    {
+      this->forget(table_name);
+      throw;
+    }
+  OpenTable &entry = this->open_tables[table_name];
+  entry.table = std::move(table);
+  return *entry.table;
+}
+
+// An index is built from the table's blocks as they stand, uncommitted changes and all, and
+// a drop throws away blocks a transaction may have changed, so neither may touch a table some
+// open transaction has changes to pending. Called outside any transaction: the caller's own
+// transaction counts too.
+static void check_unclaimed(HeapTable &table, const std::string &what) {
+  try
+    {
+      table.claim();
+    }
+  catch(DbRelationError const&)
+    {
+      throw DbRelationError("cannot " + what + " while a transaction has changes to "
+                            + table.get_table_name() + " pending");
+    }
+}
+
+DbIndex &SchemaCache::create_index(const Identifier &table_name, const Identifier &index_name,
+                                   const ColumnNames &key_columns, const std::string &index_type, bool unique) {
+  HeapTable &table = this->get_table(table_name);
+  OpenTable &entry = this->open_tables.at(table_name);
+  for (auto const& index: entry.indices)
+    if (index->get_name() == index_name)
+      throw DbRelationError("index " + index_name + " on " + table_name + " already exists");
+  for (auto const& column: key_columns)
+    if (table.ordinal(column) < 0)
+      throw DbRelationError("unknown column " + column + " in " + table_name);
+
+  NoTransaction outside;
+  check_unclaimed(table, "create index " + index_name);
+  std::unique_ptr<DbIndex> index(this->new_index(table, index_name, key_columns, index_type, unique));
+  ValueDict row = about(table_name);
+  row["index_name"] = Value(index_name);
+  ValueDict where = row;
+  try
+    {
+      row["index_type"] = Value(index_type);
+      row["is_unique"] = Value(unique ? 1 : 0);
+      for (uint i = 0; i < key_columns.size(); i++) {
+        row["seq_in_index"] = Value((int32_t) i + 1);
+        row["column_name"] = Value(key_columns[i]);
+        this->indices->insert(&row);
+      }
+    }
+  catch(...)
+    {
+      remove_rows(*this->indices, where);
+      throw;
+    }
+  try
+    {
+      index->create();
+    }
+  catch(...)
+    {
+      remove_rows(*this->indices, where);
+      // create() may have failed before making any files, so there may be nothing to drop
+      try
+        {
+          index->drop();
+        }
+      catch(DbException const&)
+        {
+        }
+      throw;
+    }
+  table.add_index(index.get());
+  entry.indices.push_back(std::move(index));
+  return *entry.indices.back();
+}
+
+void SchemaCache::drop_table(const Identifier &table_name) {
+  if (table_name == TABLES || table_name == COLUMNS || table_name == INDICES)
+    throw DbRelationError("cannot drop schema table " + table_name);
+  HeapTable &table = this->get_table(table_name);
+  NoTransaction outside;
+  check_unclaimed(table, "drop table " + table_name);
+  OpenTable &entry = this->open_tables.at(table_name);
+  for (auto const& index: entry.indices)
+    index->drop();
+  entry.table->drop();
+  this->forget(table_name);
+  this->open_tables.erase(table_name);
+}
+
+// Open one of the catalog's own tables, creating it if it isn't there
+HeapTable *SchemaCache::open_catalog(const Identifier &table_name, const ColumnNames &column_names,
+                                     const ColumnAttributes &column_attributes, bool &created) {
+  OpenTable &entry = this->open_tables[table_name];
+  entry.table.reset(new HeapTable(table_name, column_names, column_attributes));
+  created = false;
+  try
+    {
+      entry.table->open();
+    }
+  catch(DbRelationError const&)
+    {
+      entry.table->create();
+      created = true;
+    }
+  return entry.table.get();
+}
+
+// Record a table and its columns in _tables and _columns
+void SchemaCache::add_to_catalog(const Identifier &table_name, const ColumnNames &column_names,
+                                 const ColumnAttributes &column_attributes) {
+  ValueDict row = about(table_name);
+  this->tables->insert(&row);
+  for (uint column = 0; column < column_names.size(); column++) {
+    row["column_name"] = Value(column_names[column]);
+    row["ordinal"] = Value((int32_t) column);
+    row["data_type"] = Value(type_name(column_attributes[column]));
+    this->columns->insert(&row);
+  }
+}
+
+// Read a table's columns and indices from the catalog and open them; nullptr if it isn't there
+SchemaCache::OpenTable *SchemaCache::load(const Identifier &table_name) {
+  this->misses++;
+  ValueDict where = about(table_name);
+  if (catalog_rows(*this->tables, where).empty())
+    return nullptr;
+
+  std::map<int32_t, ValueDict> by_ordinal;
+  for (auto const& row: catalog_rows(*this->columns, where))
+    by_ordinal[row.at("ordinal").n] = row;
+  ColumnNames column_names;
+  ColumnAttributes column_attributes;
+  for (auto const& column: by_ordinal) {
+    column_names.push_back(column.second.at("column_name").s);
+    column_attributes.push_back(ColumnAttribute(column.second.at("data_type").s == "INT" ? ColumnAttribute::INT
+                                                                                         : ColumnAttribute::TEXT));
+  }
+  OpenTable entry;
+  entry.table.reset(new HeapTable(table_name, column_names, column_attributes));
+  entry.table->open();
+
+  // an index has a row per key column, numbered from 1
+  std::map<Identifier, std::map<int32_t, ValueDict>> by_index;
+  for (auto const& row: catalog_rows(*this->indices, where))
+    by_index[row.at("index_name").s][row.at("seq_in_index").n] = row;
+  for (auto const& index_rows: by_index) {
+    ColumnNames key_columns;
+    for (auto const& key_column: index_rows.second)
+      key_columns.push_back(key_column.second.at("column_name").s);
+    const ValueDict &first = index_rows.second.begin()->second;
+    entry.indices.emplace_back(this->new_index(*entry.table, index_rows.first, key_columns,
+                                               first.at("index_type").s, first.at("is_unique").n != 0));
+    entry.indices.back()->open();
+    entry.table->add_index(entry.indices.back().get());
+  }
+
+  OpenTable &stored = this->open_tables[table_name];
+  stored = std::move(entry);
+  return &stored;
+}
+
+DbIndex *SchemaCache::new_index(HeapTable &table, const Identifier &index_name, const ColumnNames &key_columns,
+                                const std::string &index_type, bool unique) {
+  if (index_type == "BTREE")
+    return new BTreeIndex(table, index_name, key_columns, unique);
+  if (index_type == "HASH")
+    return new HashIndex(table, index_name, key_columns, unique);
+  throw DbRelationError("unknown index type " + index_type);
+}
+
+// Take every trace of a table out of the catalog
+void SchemaCache::forget(const Identifier &table_name) {
+  ValueDict where = about(table_name);
+  remove_rows(*this->indices, where);
+  remove_rows(*this->columns, where);
+  remove_rows(*this->tables, where);
+}
+
+
+// test function -- returns true if all tests pass
+bool test_schema_tables() {
+    Identifier name = "_test_schema_tables";
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    {
+        SchemaCache schema;
+        if (schema.exists(name))
+            schema.drop_table(name);
+        HeapTable &table = schema.create_table(name, column_names, column_attributes);
+        ValueDicts rows;
+        for (int i = 0; i < 1000; i++) {
+            ValueDict row;
+            row["a"] = Value(i);
+            row["b"] = Value("b" + std::to_string(i % 10));
+            rows.push_back(row);
+        }
+        delete table.insert_batch(&rows);
+        schema.create_index(name, "by_a", {"a"}, "HASH", true);
+        schema.create_index(name, "by_b_a", {"b", "a"});
+
+        // lookups after the first are from the cache
+        u_int64_t hits = schema.get_hits(), misses = schema.get_misses();
+        for (int i = 0; i < 10; i++)
+            if (&schema.get_table(name) != &table)
+                return false;
+        if (schema.get_hits() != hits + 10 || schema.get_misses() != misses)
+            return false;
+
+        try {
+            schema.create_table(name, column_names, column_attributes);
+            return false;
+        } catch (DbRelationError const&) {
+        }
+        try {
+            schema.create_index(name, "by_c", {"c"});
+            return false;
+        } catch (DbRelationError const&) {
+        }
+        try {
+            schema.get_table("_test_schema_tables_missing");
+            return false;
+        } catch (DbRelationError const&) {
+        }
+        // a failed unique index leaves nothing behind
+        try {
+            schema.create_index(name, "by_b", {"b"}, "BTREE", true);
+            return false;
+        } catch (DbRelationError const&) {
+        }
+        if (table.get_indices().size() != 2)
+            return false;
+        // only a transaction with changes to a table pending holds up its DDL
+        if (_TXN_MANAGER != nullptr) {
+            Identifier idle = name + "_idle", busy = name + "_busy";
+            for (auto const& other: {idle, busy})
+                if (schema.exists(other))
+                    schema.drop_table(other);
+            schema.create_table(idle, column_names, column_attributes);
+            HeapTable &busy_table = schema.create_table(busy, column_names, column_attributes);
+            _TXN_MANAGER->begin();
+            busy_table.insert(&rows[0]);
+            int refused = 0;
+            bool idle_ok = false;
+            {
+                // another session, with a transaction of its own
+                NoTransaction other_session;
+                _TXN_MANAGER->begin();
+                try {
+                    schema.create_index(busy, "by_b", {"b"});
+                } catch (DbRelationError const&) {
+                    refused++;
+                }
+                try {
+                    schema.drop_table(busy);
+                } catch (DbRelationError const&) {
+                    refused++;
+                }
+                try {
+                    schema.create_index(idle, "by_b", {"b"});
+                    schema.drop_table(idle);
+                    idle_ok = true;
+                } catch (DbRelationError const&) {
+                }
+                _TXN_MANAGER->rollback();
+            }
+            // nor by its own
+            try {
+                schema.create_index(busy, "by_b", {"b"});
+            } catch (DbRelationError const&) {
+                refused++;
+            }
+            _TXN_MANAGER->rollback();
+            bool ok = refused == 3 && idle_ok && !schema.exists(idle) && busy_table.get_indices().empty();
+            schema.drop_table(busy);   // free again once the transaction is done
+            if (!ok || schema.exists(busy) || table.get_indices().size() != 2)
+                return false;
+        }
+    }
+    std::cout << "schema cache ok" << std::endl;
+
+    // as after a restart: everything comes back from the catalog
+    {
+        SchemaCache schema;
+        HeapTable &table = schema.get_table(name);
+        if (table.get_column_names() != column_names || table.get_indices().size() != 2)
+            return false;
+        ColumnAttributes found = table.get_column_attributes();
+        if (found[0].get_data_type() != ColumnAttribute::INT || found[1].get_data_type() != ColumnAttribute::TEXT)
+            return false;
+        ValueDict where;
+        where["a"] = Value(617);
+        Handles *handles = table.select(&where);
+        bool ok = handles->size() == 1;
+        if (ok) {
+            ValueDict *row = table.project((*handles)[0]);
+            ok = (*row)["b"].s == "b7";
+            delete row;
+        }
+        delete handles;
+        if (!ok)
+            return false;
+        ValueDict row;
+        row["a"] = Value(617);
+        row["b"] = Value("dup");
+        try {
+            table.insert(&row);
+            return false;
+        } catch (DbRelationError const&) {
+        }
+        if (schema.get_table(SchemaCache::COLUMNS).get_column_names().size() != 4)
+            return false;
+
+        schema.drop_table(name);
+        if (schema.exists(name))
+            return false;
+    }
+    {
+        SchemaCache schema;
+        if (schema.exists(name))
+            return false;
+    }
+    std::cout << "schema reload ok" << std::endl;
+    return true;
+}
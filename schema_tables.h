@@ -0,0 +1,162 @@
+/**
+ * @file schema_tables.h - The system catalog and the open tables it describes.
+ * SchemaCache
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "storage_engine.h"
+#include "heap_storage.h"
+
+/**
+ * @class SchemaCache - the catalog of tables, columns, and indices, and a handle on each table
+ *
+ * The catalog is three HeapTables of its own, which describe themselves too:
+ * 	_tables   (table_name)
+ * 	_columns  (table_name, column_name, ordinal, data_type)
+ * 	_indices  (table_name, index_name, seq_in_index, column_name, index_type, is_unique)
+ * They are created the first time a database is opened.
+ *
+ * The first time a statement names a table, its schema is read from the catalog and
+ * the table is opened, along with its indices; from then on the open HeapTable is found
+ * by a hash lookup, with no catalog reads and no reopening of its file. Tables stay
+ * open until the cache is destroyed.
+ *
+ * Catalog changes (and the files they create or drop) are made outside any open
+ * transaction, so a ROLLBACK doesn't undo them. An index is created on, or a table
+ * dropped, only while no open transaction has changes to it pending. Not safe to share
+ * between threads without a lock: neither is a HeapTable.
+ *
+ * Methods:
+ * 	get_table(table_name)
+ * 	exists(table_name)
+ * 	create_table(table_name, column_names, column_attributes)
+ * 	create_index(table_name, index_name, key_columns, index_type, unique)
+ * 	drop_table(table_name)
+ * Accessors:
+ * 	get_num_open()
+ * 	get_hits()
+ * 	get_misses()
+ */
+class SchemaCache {
+public:
+    static const Identifier TABLES;
+    static const Identifier COLUMNS;
+    static const Identifier INDICES;
+
+    /**
+     * Open the catalog, creating it if the database doesn't have one yet.
+     */
+    SchemaCache();
+
+    /**
+     * Close every table and index the cache opened.
+     */
+    virtual ~SchemaCache() {}
+
+    SchemaCache(const SchemaCache &other) = delete;
+
+    SchemaCache(SchemaCache &&temp) = delete;
+
+    SchemaCache &operator=(const SchemaCache &other) = delete;
+
+    SchemaCache &operator=(SchemaCache &&temp) = delete;
+
+    /**
+     * Find a table, opening it (and its indices) the first time.
+     * @param table_name  the table
+     * @returns           the open table (good until the cache is destroyed or the table dropped)
+     * @throws            DbRelationError if there is no such table
+     */
+    virtual HeapTable &get_table(const Identifier &table_name);
+
+    /**
+     * Is there a table by this name?
+     * @param table_name  the table
+     */
+    virtual bool exists(const Identifier &table_name);
+
+    /**
+     * Add a table to the catalog and create its file.
+     * @param table_name         the new table
+     * @param column_names       its columns
+     * @param column_attributes  their types, one per column
+     * @returns                  the open table
+     * @throws                   DbRelationError if the table already exists or can't be created
+     */
+    virtual HeapTable &create_table(const Identifier &table_name, const ColumnNames &column_names,
+                                    const ColumnAttributes &column_attributes);
+
+    /**
+     * Add an index to the catalog, and build it from the table's rows.
+     * @param table_name   the indexed table
+     * @param index_name   the new index (unique to the table)
+     * @param key_columns  the table's columns to index on, most significant first
+     * @param index_type   "BTREE" or "HASH"
+     * @param unique       whether two rows may have the same key
+     * @returns            the index, already kept up to date by the table
+     * @throws             DbRelationError for an unknown table, column, or index type, an index
+     *                     name already in use, or a transaction with changes to the table pending
+     */
+    virtual DbIndex &create_index(const Identifier &table_name, const Identifier &index_name,
+                                  const ColumnNames &key_columns, const std::string &index_type = "BTREE",
+                                  bool unique = false);
+
+    /**
+     * Remove a table, its indices, and their files, and take them out of the catalog.
+     * @param table_name  the table
+     * @throws            DbRelationError for an unknown table or a catalog table, or a transaction
+     *                    with changes to the table pending
+     */
+    virtual void drop_table(const Identifier &table_name);
+
+    /**
+     * Tables open now (the catalog's three included).
+     */
+    virtual size_t get_num_open() const { return open_tables.size(); }
+
+    /**
+     * Lookups answered without reading the catalog.
+     */
+    virtual u_int64_t get_hits() const { return hits; }
+
+    /**
+     * Lookups that read the catalog (found or not).
+     */
+    virtual u_int64_t get_misses() const { return misses; }
+
+protected:
+    // a table the cache has open, and its indices (destroyed first)
+    struct OpenTable {
+        std::unique_ptr<HeapTable> table;
+        std::vector<std::unique_ptr<DbIndex>> indices;
+    };
+
+    std::unordered_map<Identifier, OpenTable> open_tables;
+    HeapTable *tables;
+    HeapTable *columns;
+    HeapTable *indices;
+    u_int64_t hits;
+    u_int64_t misses;
+
+    virtual HeapTable *open_catalog(const Identifier &table_name, const ColumnNames &column_names,
+                                    const ColumnAttributes &column_attributes, bool &created);
+
+    virtual void add_to_catalog(const Identifier &table_name, const ColumnNames &column_names,
+                                const ColumnAttributes &column_attributes);
+
+    virtual OpenTable *load(const Identifier &table_name);
+
+    virtual DbIndex *new_index(HeapTable &table, const Identifier &index_name, const ColumnNames &key_columns,
+                               const std::string &index_type, bool unique);
+
+    virtual void forget(const Identifier &table_name);
+};
+
+bool test_schema_tables();
@@ -5,27 +5,67 @@
 #include "SQLParser.h"
 #include "sqlhelper.h"
 #include "heap_storage.h"
+#include "buffer_pool.h"
+#include "btree.h"
+#include "hash_index.h"
+#include "transaction.h"
+#include "sql_server.h"
+#include "statement_cache.h"
+#include "executor.h"
+#include "vector_executor.h"
+#include "hash_join.h"
+#include "external_sort.h"
+#include "hash_aggregate.h"
+#include "planner.h"
+#include "schema_tables.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <cctype>
+#include <csignal>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace hsql;
 
 // Prototypes
-string expressionToString(const Expr * expression);
-string operatorToString(const Expr *opExpr);
+string expressionToString(const Expr * expression, const Bindings *bindings = nullptr);
+string operatorToString(const Expr *opExpr, const Bindings *bindings = nullptr);
+string valueToString(const Value &value);
 string columnToString(const ColumnDefinition *col);
-string tableRefToString(const TableRef *table);
-string executeSelect(const SelectStatement *statement);
+string tableRefToString(const TableRef *table, const Bindings *bindings = nullptr);
+string executeSelect(const SelectStatement *statement, const Bindings *bindings = nullptr,
+                     const ResultStream &stream = nullptr, unique_lock<mutex> *held = nullptr);
 string executeCreate(const CreateStatement *statement);
-string executeInsert(const InsertStatement *statement);
-string execute(const SQLStatement *statement);
+string executeCreateIndex(const CreateStatement *statement);
+string executeInsert(const InsertStatement *statement, const Bindings *bindings = nullptr);
+string execute(const SQLStatement *statement, const Bindings *bindings = nullptr, const ResultStream &stream = nullptr);
+bool executeTransaction(string input, string &result);
+string executeAll(const SQLParserResult *parse, const Bindings *bindings, const ResultStream &stream);
+bool executePrepared(const string &input, PreparedStatements &prepared, const ResultStream &stream, string &result);
+string executeInput(const string &userInput, PreparedStatements &prepared, const ResultStream &stream);
+
+// The catalog, and the tables it has open (set up in main). A HeapTable isn't safe to
+// share between threads, so one statement that touches tables runs at a time; a SELECT
+// lets go of the lock while each batch of its rows goes out (see executeSelect). BEGIN,
+// COMMIT, and ROLLBACK take the same lock (see TransactionManager::set_statement_lock).
+static SchemaCache *schema = nullptr;
+static mutex dataLock;
+
+// Function to find a table by name
+static HeapTable &getTable(const Identifier &name) {
+  return schema->get_table(name);
+}
+
 
 // Function to convert an expression to a string
-string expressionToString(const Expr * expression) {
+string expressionToString(const Expr * expression, const Bindings *bindings) {
   string result;
 
   switch (expression->type) {
@@ -49,7 +89,14 @@ string expressionToString(const Expr * expression) {
       result += string(expression->name) + " " + expression->expr->name;
       break;
     case kExprOperator:
-      result += operatorToString(expression);
+      result += operatorToString(expression, bindings);
+      break;
+    case kExprPlaceholder:
+      if (bindings != nullptr && bindings->count(expression) > 0) {
+        result += valueToString(bindings->at(expression));
+      } else {
+        result += "?";
+      }
       break;
     default:
       result += "Unknown expression.";
@@ -64,14 +111,14 @@ string expressionToString(const Expr * expression) {
 }
 
 // Function to convert an operator expression to a string
-string operatorToString(const Expr *opExpr){
+string operatorToString(const Expr *opExpr, const Bindings *bindings){
   string result;
 
   if (opExpr == NULL) {
     return "NULL";
   }
 
-  result += expressionToString(opExpr->expr) + " ";
+  result += expressionToString(opExpr->expr, bindings) + " ";
 
   switch (opExpr->opType) {
     case Expr::SIMPLE_OP:
@@ -91,12 +138,27 @@ string operatorToString(const Expr *opExpr){
   }
 
   if (opExpr->expr2 != NULL) {
-    result += " " + expressionToString(opExpr->expr2);
+    result += " " + expressionToString(opExpr->expr2, bindings);
   }
 
   return result;
 }
 
+// Function to convert a parameter value to a SQL literal
+string valueToString(const Value &value) {
+  if (value.data_type == ColumnAttribute::INT) {
+    return to_string(value.n);
+  }
+  string result = "'";
+  for (char c: value.s) {
+    result += c;
+    if (c == '\'') {
+      result += c;
+    }
+  }
+  return result + "'";
+}
+
 // Function to convert a column definition to a string
 string columnToString(const ColumnDefinition *col){
 
@@ -121,7 +183,7 @@ string columnToString(const ColumnDefinition *col){
 }
 
 // Function to convert a table reference to a string
-string tableRefToString(const TableRef *table) {
+string tableRefToString(const TableRef *table, const Bindings *bindings) {
   string result;
   switch (table->type) {
     case kTableSelect:
@@ -134,7 +196,7 @@ string tableRefToString(const TableRef *table) {
       }
       break;
     case kTableJoin:
-      result += tableRefToString(table->join->left);
+      result += tableRefToString(table->join->left, bindings);
       switch (table->join->type) {
         case kJoinCross:
           result += " JOIN CROSS NOT IMPLEMENTED ";
@@ -161,9 +223,9 @@ string tableRefToString(const TableRef *table) {
           result += " NATURAL JOIN ";
           break;
       }
-      result += tableRefToString(table->join->right);
+      result += tableRefToString(table->join->right, bindings);
       if (table->join->condition != NULL){
-        result += " ON " + expressionToString(table->join->condition);
+        result += " ON " + expressionToString(table->join->condition, bindings);
       }
       break;
     case kTableCrossProduct:
@@ -171,7 +233,7 @@ string tableRefToString(const TableRef *table) {
       for (TableRef *tbl : *table->list) {
         if (comma)
           result += ", ";
-        result += tableRefToString(tbl);
+        result += tableRefToString(tbl, bindings);
         comma = true;
       }
       break;
@@ -179,61 +241,167 @@ string tableRefToString(const TableRef *table) {
   return result;
 }
 
-// Function to execute a SELECT statement
-string executeSelect(const SelectStatement *statement) {
-  string result = "SELECT ";
-  bool comma = false;
-  for (Expr *expr : *statement->selectList) {
-    if (comma) {
-      result += ", ";
+// Function to convert a result row to a string
+static string rowToString(const Row &row) {
+  string result;
+  for (uint column = 0; column < row.size(); column++) {
+    if (column > 0) {
+      result += " ";
+    }
+    if (row[column].data_type == ColumnAttribute::INT) {
+      result += to_string(row[column].n);
+    } else {
+      result += "\"" + string(row[column].text, row[column].size) + "\"";
     }
-    result += expressionToString(expr);
-    comma = true;
-  }
-  result += " FROM " + tableRefToString(statement->fromTable);
-  if (statement->whereClause != NULL) {
-    result += " WHERE " + expressionToString(statement->whereClause);
   }
   return result;
 }
 
-// Function to execute a CREATE statement
-string executeCreate(const CreateStatement *statement) {
-  string result = "CREATE TABLE ";
-  bool ifComma = false;
+// Send lines through stream with held (if any) let go of meanwhile
+static void streamUnlocked(const ResultStream &stream, const string &lines, unique_lock<mutex> *held) {
+  if (held != nullptr) {
+    held->unlock();
+  }
+  try {
+    stream(lines);
+  } catch (...) {
+    if (held != nullptr) {
+      held->lock();
+    }
+    throw;
+  }
+  if (held != nullptr) {
+    held->lock();
+  }
+}
 
-  if(statement->ifNotExists){
-    return result + "DOES NOT EXIST ";
+// Function to execute a SELECT statement; rows go out through stream a batch at a time
+// (when there is one) as the plan produces them, with held (the lock the statement runs
+// under) let go of while each batch is sent, so a slow client holds up no one else
+string executeSelect(const SelectStatement *statement, const Bindings *bindings, const ResultStream &stream,
+                     unique_lock<mutex> *held) {
+  QueryPlanner planner(getTable);
+  QueryOperator *plan = planner.plan(statement, bindings);
+  string result;
+  for (auto const& column_name: plan->get_column_names()) {
+    result += column_name + " ";
+  }
+  result += "\n+";
+  for (uint i = 0; i < plan->get_column_names().size(); i++) {
+    result += "----------+";
+  }
+  u_int64_t count = 0;
+  try {
+    RowBatch batch;
+    plan->open();
+    while (plan->next(batch)) {
+      for (uint i = 0; i < batch.size(); i++) {
+        if (!result.empty()) {
+          result += "\n";
+        }
+        result += rowToString(batch[i]);
+      }
+      count += batch.size();
+      if (stream) {
+        streamUnlocked(stream, result, held);
+        result.clear();
+      }
+    }
+    plan->close();
+  } catch (...) {
+    delete plan;
+    throw;
+  }
+  delete plan;
+  if (!result.empty()) {
+    result += "\n";
+  }
+  return result + "successfully returned " + to_string(count) + " rows";
+}
+
+// Function to execute a CREATE INDEX statement
+string executeCreateIndex(const CreateStatement *statement) {
+  string index_type = statement->indexType != NULL ? statement->indexType : "BTREE";
+  if (index_type != "BTREE" && index_type != "HASH") {
+    return "unknown index type " + index_type;
+  }
+  ColumnNames key_columns;
+  for (char *column: *statement->indexColumns) {
+    key_columns.push_back(column);
   }
+  schema->create_index(statement->tableName, statement->indexName, key_columns, index_type);
+  return string("created index ") + statement->indexName + " on " + statement->tableName;
+}
 
-  result += string(statement->tableName) + " (";
+// Function to execute a CREATE statement
+string executeCreate(const CreateStatement *statement) {
+  if (statement->type == CreateStatement::kIndex) {
+    return executeCreateIndex(statement);
+  }
 
-  for(ColumnDefinition *column: *statement->columns){
-    if(ifComma){
-      result += ", ";
+  ColumnNames column_names;
+  ColumnAttributes column_attributes;
+  for (ColumnDefinition *column: *statement->columns) {
+    if (column->type == ColumnDefinition::INT) {
+      column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    } else if (column->type == ColumnDefinition::TEXT) {
+      column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    } else {
+      throw DbRelationError("only INT and TEXT columns are supported");
     }
-
-    result += columnToString(column);
-    ifComma = true;
+    column_names.push_back(column->name);
   }
 
-  result += ")";
-  return result;
+  string table_name = statement->tableName;
+  if (schema->exists(table_name)) {
+    if (statement->ifNotExists) {
+      return "table " + table_name + " already exists";
+    }
+    throw DbRelationError("table " + table_name + " already exists");
+  }
+  schema->create_table(table_name, column_names, column_attributes);
+  return "created " + table_name;
 }
 
 // Function to execute an INSERT statement
-string executeInsert(const InsertStatement *statement) {
-  string result = " INSERT NOT IMPLEMENTED";
-  return result;
+string executeInsert(const InsertStatement *statement, const Bindings *bindings) {
+  if (statement->type != InsertStatement::kInsertValues) {
+    throw DbRelationError("INSERT ... SELECT is not implemented");
+  }
+  HeapTable &table = getTable(statement->tableName);
+  ColumnNames column_names;
+  if (statement->columns != NULL) {
+    for (char *column: *statement->columns) {
+      column_names.push_back(column);
+    }
+  } else {
+    column_names = table.get_column_names();
+  }
+  if (column_names.size() != statement->values->size()) {
+    throw DbRelationError("INSERT has " + to_string(statement->values->size()) + " values for "
+                          + to_string(column_names.size()) + " columns");
+  }
+
+  ValueDict row;
+  for (uint i = 0; i < column_names.size(); i++) {
+    Value value;
+    if (!QueryPlanner::constant((*statement->values)[i], bindings, value)) {
+      throw DbRelationError("INSERT values must be constants");
+    }
+    row[column_names[i]] = value;
+  }
+  table.insert(&row);
+  return string("successfully inserted 1 row into ") + statement->tableName;
 }
 
-// Function to execute a SQL statement
-string execute(const SQLStatement *statement) {
+// Function to execute a SQL statement, with bindings for its ? parameters if it has any
+string execute(const SQLStatement *statement, const Bindings *bindings, const ResultStream &stream) {
+  unique_lock<mutex> guard(dataLock);
   switch (statement->type()) {
     case kStmtSelect:
-      return executeSelect((const SelectStatement *) statement);
+      return executeSelect((const SelectStatement *) statement, bindings, stream, &guard);
     case kStmtInsert:
-      return executeInsert((const InsertStatement *) statement);
+      return executeInsert((const InsertStatement *) statement, bindings);
     case kStmtCreate:
       return executeCreate((const CreateStatement *) statement);
     default:
@@ -241,17 +409,267 @@ string execute(const SQLStatement *statement) {
   }
 }
 
+// Function to execute BEGIN, COMMIT, or ROLLBACK, which the parser doesn't know;
+// returns false if input is none of them
+bool executeTransaction(string input, string &result) {
+  transform(input.begin(), input.end(), input.begin(), ::tolower);
+  while (!input.empty() && (input.back() == ';' || isspace(input.back()))) {
+    input.pop_back();
+  }
+  for (string noise: {" transaction", " work"}) {
+    if (input.size() > noise.size() && input.compare(input.size() - noise.size(), noise.size(), noise) == 0) {
+      input.erase(input.size() - noise.size());
+    }
+  }
+  if (input != "begin" && input != "start" && input != "commit" && input != "rollback") {
+    return false;
+  }
+
+  try {
+    if (input == "commit") {
+      _TXN_MANAGER->commit();
+      result = "COMMIT";
+    } else if (input == "rollback") {
+      _TXN_MANAGER->rollback();
+      result = "ROLLBACK";
+    } else {
+      _TXN_MANAGER->begin();
+      result = "BEGIN";
+    }
+  } catch (TransactionError const& e) {
+    result = string("ERROR: ") + e.what();
+  } catch (DbException const& e) {
+    result = string("ERROR: ") + e.what();
+  }
+  return true;
+}
+
+// Parsed statements, shared by every session
+static StatementCache statementCache;
+
+// Skip white space in input from pos
+static void skipSpace(const string &input, size_t &pos) {
+  while (pos < input.size() && isspace((unsigned char) input[pos])) {
+    pos++;
+  }
+}
+
+// The word (letters, digits, _) at pos in input, lower-cased; pos moves past it
+static string nextWord(const string &input, size_t &pos) {
+  skipSpace(input, pos);
+  string word;
+  while (pos < input.size() && (isalnum((unsigned char) input[pos]) || input[pos] == '_')) {
+    word += (char) tolower((unsigned char) input[pos++]);
+  }
+  return word;
+}
+
+// The integer or 'quoted string' literal at pos in input; pos moves past it
+static Value nextLiteral(const string &input, size_t &pos) {
+  skipSpace(input, pos);
+  if (pos < input.size() && input[pos] == '\'') {
+    string text;
+    while (++pos < input.size()) {
+      if (input[pos] == '\'') {
+        if (pos + 1 < input.size() && input[pos + 1] == '\'') {
+          pos++;    // '' is a quote
+        } else {
+          pos++;
+          return Value(text);
+        }
+      }
+      text += input[pos];
+    }
+    throw DbRelationError("unterminated string parameter");
+  }
+  size_t start = pos;
+  if (pos < input.size() && (input[pos] == '-' || input[pos] == '+')) {
+    pos++;
+  }
+  while (pos < input.size() && isdigit((unsigned char) input[pos])) {
+    pos++;
+  }
+  if (pos == start || !isdigit((unsigned char) input[pos - 1])) {
+    throw DbRelationError("parameters must be integers or 'strings'");
+  }
+  long long n;
+  try {
+    n = stoll(input.substr(start, pos - start));
+  } catch (out_of_range const&) {
+    throw DbRelationError("integer parameter out of range");
+  }
+  if (n < INT32_MIN || n > INT32_MAX) {
+    throw DbRelationError("integer parameter out of range");
+  }
+  return Value((int32_t) n);
+}
+
+// Function to execute each statement of a parse in turn and return their output; any output
+// already gathered goes out through stream before a statement that may stream its own
+string executeAll(const SQLParserResult *parse, const Bindings *bindings, const ResultStream &stream) {
+  string result;
+  try {
+    for (uint i = 0; i < parse->size(); i++) {
+      if (stream && !result.empty()) {
+        stream(result);
+        result.clear();
+      }
+      if (!result.empty()) {
+        result += "\n";
+      }
+      result += execute(parse->getStatement(i), bindings, stream);
+    }
+  } catch (DbRelationError const& e) {
+    result += string(result.empty() ? "" : "\n") + "ERROR: " + e.what();
+  } catch (DbException const& e) {
+    result += string(result.empty() ? "" : "\n") + "ERROR: " + e.what();
+  }
+  return result;
+}
+
+// Function to execute PREPARE, EXECUTE, or DEALLOCATE, which are handled here rather than
+// by the parser so that EXECUTE never has to parse anything; returns false if input is
+// none of them. The forms are:
+//   PREPARE name FROM|AS statement      (the statement may be in single quotes)
+//   EXECUTE name [(] [value, ...] [)]   (or EXECUTE name USING value, ...)
+//   DEALLOCATE [PREPARE] name
+bool executePrepared(const string &input, PreparedStatements &prepared, const ResultStream &stream, string &result) {
+  size_t pos = 0;
+  string command = nextWord(input, pos);
+  if (command != "prepare" && command != "execute" && command != "deallocate") {
+    return false;
+  }
+
+  try {
+    string name = nextWord(input, pos);
+    if (command == "deallocate" && name == "prepare") {
+      name = nextWord(input, pos);
+    }
+    if (name.empty()) {
+      throw DbRelationError("missing statement name");
+    }
+
+    if (command == "prepare") {
+      string keyword = nextWord(input, pos);
+      if (keyword != "from" && keyword != "as") {
+        throw DbRelationError("expected FROM or AS after PREPARE " + name);
+      }
+      skipSpace(input, pos);
+      string sql = input.substr(pos);
+      if (!sql.empty() && sql[0] == '\'') {
+        Value quoted = nextLiteral(input, pos);
+        sql = quoted.s;
+      }
+      auto statement = statementCache.get(sql);
+      if (!statement->is_valid()) {
+        throw DbRelationError("invalid SQL");
+      }
+      prepared[name] = statement;
+      uint parameters = statement->get_num_parameters();
+      result = "PREPARE " + name + " (" + to_string(parameters) + (parameters == 1 ? " parameter)" : " parameters)");
+
+    } else if (command == "deallocate") {
+      if (prepared.erase(name) == 0) {
+        throw DbRelationError("no prepared statement " + name);
+      }
+      result = "DEALLOCATE " + name;
+
+    } else {
+      auto found = prepared.find(name);
+      if (found == prepared.end()) {
+        throw DbRelationError("no prepared statement " + name);
+      }
+      size_t after_name = pos;
+      bool parenthesized = false;
+      skipSpace(input, pos);
+      if (pos < input.size() && input[pos] == '(') {
+        parenthesized = true;
+        pos++;
+      } else if (nextWord(input, pos) != "using") {
+        pos = after_name;
+      }
+      vector<Value> values;
+      skipSpace(input, pos);
+      while (pos < input.size() && input[pos] != ')' && input[pos] != ';') {
+        if (!values.empty()) {
+          if (input[pos] != ',') {
+            throw DbRelationError("expected , between parameters");
+          }
+          pos++;
+        }
+        values.push_back(nextLiteral(input, pos));
+        skipSpace(input, pos);
+      }
+      if (parenthesized && (pos >= input.size() || input[pos] != ')')) {
+        throw DbRelationError("expected ) after parameters");
+      }
+      const CachedStatement &statement = *found->second;
+      Bindings bindings = statement.bind(values);
+      result = executeAll(statement.get_parse(), &bindings, stream);
+    }
+  } catch (DbRelationError const& e) {
+    result = string("ERROR: ") + e.what();
+  }
+  return true;
+}
+
+// Function to execute one line of input (STATS, a transaction command, a prepared statement
+// command, or SQL statements) and return its output, for the REPL and for server sessions alike
+string executeInput(const string &userInput, PreparedStatements &prepared, const ResultStream &stream) {
+  if (userInput == "stats") {
+    lock_guard<mutex> guard(dataLock);  // schema is counting lookups under it
+    return "buffer pool: " + to_string(_BUFFER_POOL->get_num_frames()) + " frames, "
+           + to_string(_BUFFER_POOL->get_hits()) + " hits, " + to_string(_BUFFER_POOL->get_misses()) + " misses, "
+           + to_string(_BUFFER_POOL->get_evictions()) + " evictions, " + to_string(_BUFFER_POOL->get_writes()) + " writes\n"
+           + "transactions: " + to_string(_TXN_MANAGER->get_commits()) + " commits, "
+           + to_string(_TXN_MANAGER->get_flushes()) + " log flushes\n"
+           + "statement cache: " + to_string(statementCache.get_capacity()) + " statements, "
+           + to_string(statementCache.get_hits()) + " hits, " + to_string(statementCache.get_misses()) + " misses\n"
+           + "schema cache: " + to_string(schema->get_num_open()) + " tables open, "
+           + to_string(schema->get_hits()) + " hits, " + to_string(schema->get_misses()) + " misses\n"
+           + "sort: " + to_string(ExternalSort::get_total_sorts()) + " sorts, "
+           + to_string(ExternalSort::get_total_runs()) + " runs, "
+           + to_string(ExternalSort::get_total_spill_bytes()) + " bytes spilled";
+  }
+
+  string result;
+  if (executeTransaction(userInput, result) || executePrepared(userInput, prepared, stream, result)) {
+    return result;
+  }
+
+  auto statement = statementCache.get(userInput);
+  if (statement->is_valid()) {
+    result = executeAll(statement->get_parse(), nullptr, stream);
+  }
+  else {
+    result = "ERROR: Invalid SQL";
+  }
+  return result;
+}
+
 DbEnv *_DB_ENV;
+BufferPool *_BUFFER_POOL;
+TransactionManager *_TXN_MANAGER;
+
+static SqlServer *server = nullptr;
+
+// SIGINT/SIGTERM in server mode: stop accepting and shut down cleanly
+static void stopServer(int) {
+  if (server != nullptr) {
+    server->stop();
+  }
+}
 
 int main(int argc, char* argv[]){
   const string QUIT = "quit";
   const string TEST = "test";
   string userInput = "";
+  PreparedStatements prepared;
+  ResultStream printLines = [](const string &lines) { cout << lines << endl; };
   char *location;
-  SQLParserResult* parsedResult;
 
-  if (argc != 2) {
-    cerr << "Usage: ./sql5300 dbenvpath" << endl;
+  if (argc < 2 || argc > 4) {
+    cerr << "Usage: ./sql5300 dbenvpath [buffer_frames [port]]" << endl;
     return 1;
   }
 
@@ -262,34 +680,64 @@ int main(int argc, char* argv[]){
   DbEnv myEnv(0U);
   myEnv.set_message_stream(&cout);
   myEnv.set_error_stream(&cerr);
-  myEnv.open(location, DB_CREATE | DB_INIT_MPOOL, 0);
+  myEnv.open(location, DB_CREATE | DB_INIT_MPOOL | DB_THREAD | TransactionManager::ENV_FLAGS, 0);
 
   _DB_ENV = &myEnv;
+  TransactionManager txnManager(myEnv);
+  txnManager.set_statement_lock(&dataLock);
+  _TXN_MANAGER = &txnManager;
+
+  uint frames = argc >= 3 ? (uint) atoi(argv[2]) : BufferPool::DEFAULT_FRAMES;
+  BufferPool bufferPool(frames);
+  _BUFFER_POOL = &bufferPool;
+
+  // closed (flushing its tables) before the buffer pool goes
+  unique_ptr<SchemaCache> schemaCache(new SchemaCache());
+  schema = schemaCache.get();
+
+  if (argc == 4) {
+    SqlServer sqlServer((u_int16_t) atoi(argv[3]), executeInput);
+    server = &sqlServer;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    cout << "(sql5300: serving on 127.0.0.1:" << sqlServer.get_port() << ")" << endl;
+    sqlServer.run();
+    cout << "(sql5300: " << sqlServer.get_sessions() << " sessions, "
+         << sqlServer.get_statements() << " statements)" << endl;
+    server = nullptr;
+    return 0;
+  }
 
   while (true) {
     cout << "SQL> ";
     getline(cin, userInput);
 
     if (userInput == QUIT) {
+      if (txnManager.in_transaction()) {
+        txnManager.rollback();
+      }
       break;
     }
 
     if (userInput == TEST) {
       cout << "testing_heap_storage: " << (test_heap_storage() ? "ok" : "failed") << endl;
+      cout << "testing_btree: " << (test_btree() ? "ok" : "failed") << endl;
+      cout << "testing_hash_index: " << (test_hash_index() ? "ok" : "failed") << endl;
+      cout << "testing_transactions: " << (test_transactions() ? "ok" : "failed") << endl;
+      cout << "testing_statement_cache: " << (test_statement_cache() ? "ok" : "failed") << endl;
+      cout << "testing_executor: " << (test_executor() ? "ok" : "failed") << endl;
+      cout << "testing_vector_executor: " << (test_vector_executor() ? "ok" : "failed") << endl;
+      cout << "testing_hash_join: " << (test_hash_join() ? "ok" : "failed") << endl;
+      cout << "testing_external_sort: " << (test_external_sort() ? "ok" : "failed") << endl;
+      cout << "testing_hash_aggregate: " << (test_hash_aggregate() ? "ok" : "failed") << endl;
+      // the test opens the catalog itself, so ours is closed while it runs
+      schemaCache.reset();
+      cout << "testing_schema_tables: " << (test_schema_tables() ? "ok" : "failed") << endl;
+      schemaCache.reset(new SchemaCache());
+      schema = schemaCache.get();
       continue;
     }
-    
-    parsedResult = SQLParser::parseSQLString(userInput);
 
-    if (parsedResult->isValid()) {
-      for (uint i = 0; i < parsedResult->size(); i++) {
-        cout << execute(parsedResult->getStatement(i)) << endl;
-      }
-    }
-    else {
-      cout << "ERROR: Invalid SQL" << endl;
-    }
-
-    delete parsedResult;
+    cout << executeInput(userInput, prepared, printLines) << endl;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,131 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+//
+// sql5300load - load driver for sql5300's server mode.
+// Usage: ./sql5300load port [statements [pipeline]]
+// For 1, 2, 4, ... 64 clients, each client sends statements statements, pipeline at a
+// time before reading their results, and the total queries/sec is reported.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Seconds elapsed since start
+static double since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static int connect_to(u_int16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (connect(fd, (sockaddr *) &address, sizeof(address)) < 0) {
+    close(fd);
+    return -1;
+  }
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  return fd;
+}
+
+static bool send_all(int fd, const string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    sent += n;
+  }
+  return true;
+}
+
+// Read until count results (each ending in a "." line) have come back; false on error or ERROR results
+static bool read_results(int fd, uint count, string &pending) {
+  bool ok = true;
+  char buffer[16 * 1024];
+  while (count > 0) {
+    size_t end_of_line;
+    while (count > 0 && (end_of_line = pending.find('\n')) != string::npos) {
+      if (end_of_line == 1 && pending[0] == '.')
+        count--;
+      else if (pending.compare(0, 6, "ERROR:") == 0)
+        ok = false;
+      pending.erase(0, end_of_line + 1);
+    }
+    if (count == 0)
+      break;
+    ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+    if (got <= 0)
+      return false;
+    pending.append(buffer, got);
+  }
+  return ok;
+}
+
+// One client's run; returns the number of statements that came back without error
+static uint client(u_int16_t port, uint statements, uint pipeline, uint seed) {
+  int fd = connect_to(port);
+  if (fd < 0)
+    return 0;
+  uint done = 0;
+  string pending;
+  for (uint i = 0; i < statements; i += pipeline) {
+    uint batch = min(pipeline, statements - i);
+    string requests;
+    for (uint j = 0; j < batch; j++)
+      requests += "SELECT a, b FROM foo WHERE a = " + to_string((seed * 7919u + i + j) % 100000) + "\n";
+    if (!send_all(fd, requests) || !read_results(fd, batch, pending))
+      break;
+    done += batch;
+  }
+  send_all(fd, "quit\n");
+  close(fd);
+  return done;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 4) {
+    cerr << "Usage: ./sql5300load port [statements [pipeline]]" << endl;
+    return 1;
+  }
+  u_int16_t port = (u_int16_t) atoi(argv[1]);
+  uint statements = argc >= 3 ? (uint) atoi(argv[2]) : 10000;
+  uint pipeline = argc == 4 ? (uint) max(1, atoi(argv[3])) : 1;
+
+  cout << statements << " statements per client, " << pipeline << " per round trip" << endl;
+  cout << setw(10) << "clients" << setw(16) << "queries/s" << endl;
+  for (uint clients = 1; clients <= 64; clients *= 2) {
+    vector<thread> threads;
+    vector<uint> done(clients);
+    auto start = chrono::steady_clock::now();
+    for (uint c = 0; c < clients; c++)
+      threads.push_back(thread([&, c] { done[c] = client(port, statements, pipeline, c); }));
+    for (auto &t: threads)
+      t.join();
+    double secs = since(start);
+    u_int64_t total = 0;
+    for (auto n: done)
+      total += n;
+    if (total != (u_int64_t) clients * statements)
+      cerr << "only " << total << " of " << (u_int64_t) clients * statements << " statements succeeded" << endl;
+    cout << setw(10) << clients << setw(16) << (u_int64_t) (total / secs) << endl;
+  }
+  return 0;
+}
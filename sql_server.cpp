@@ -0,0 +1,267 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "sql_server.h"
+#include "transaction.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static void check(int result, const char *what) {
+  if (result < 0)
+    throw std::runtime_error(std::string(what) + ": " + strerror(errno));
+}
+
+SqlServer::SqlServer(u_int16_t port, Handler handler, uint num_workers)
+        : port(port), handler(handler), listen_fd(-1), epoll_fd(-1), stop_fd(-1), sessions_served(0), statements(0),
+          workers(num_workers)
+{
+  try
+    {
+      this->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      check(this->listen_fd, "socket");
+      int on = 1;
+      setsockopt(this->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      sockaddr_in address;
+      memset(&address, 0, sizeof(address));
+      address.sin_family = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      address.sin_port = htons(port);
+      check(bind(this->listen_fd, (sockaddr *) &address, sizeof(address)), "bind");
+      check(listen(this->listen_fd, SOMAXCONN), "listen");
+      socklen_t length = sizeof(address);
+      check(getsockname(this->listen_fd, (sockaddr *) &address, &length), "getsockname");
+      this->port = ntohs(address.sin_port);
+
+      this->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      check(this->stop_fd, "eventfd");
+      this->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+      check(this->epoll_fd, "epoll_create1");
+      // the listener is known by a null pointer, the stop event by stop_fd's address
+      epoll_event event;
+      event.events = EPOLLIN;
+      event.data.ptr = nullptr;
+      check(epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->listen_fd, &event), "epoll_ctl");
+      event.data.ptr = &this->stop_fd;
+      check(epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->stop_fd, &event), "epoll_ctl");
+    }
+  catch(...)
+    {
+      for (int fd: {this->listen_fd, this->stop_fd, this->epoll_fd})
+        if (fd >= 0)
+          close(fd);
+      throw;
+    }
+}
+
+SqlServer::~SqlServer() {
+  this->workers.wait();
+  std::vector<Session *> left(this->sessions.begin(), this->sessions.end());
+  for (auto session: left)
+    end(session);
+  close(this->listen_fd);
+  close(this->stop_fd);
+  close(this->epoll_fd);
+}
+
+void SqlServer::run() {
+  const int MAX_EVENTS = 64;
+  epoll_event events[MAX_EVENTS];
+  while (true) {
+    int ready = epoll_wait(this->epoll_fd, events, MAX_EVENTS, -1);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    check(ready, "epoll_wait");
+    for (int i = 0; i < ready; i++) {
+      void *source = events[i].data.ptr;
+      if (source == nullptr) {
+        accept_all();
+      } else if (source == &this->stop_fd) {
+        return;
+      } else {
+        Session *session = (Session *) source;
+        this->workers.submit([this, session] { serve(session); });
+      }
+    }
+  }
+}
+
+void SqlServer::stop() {
+  u_int64_t one = 1;
+  ssize_t written = write(this->stop_fd, &one, sizeof(one));
+  (void) written;
+}
+
+void SqlServer::accept_all() {
+  while (true) {
+    int fd = accept4(this->listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;  // EAGAIN: none left (anything else: try again on the next wakeup)
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    Session *session = new Session();
+    session->fd = fd;
+    session->txn = nullptr;
+    session->closing = false;
+    {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->sessions.insert(session);
+    }
+    this->sessions_served++;
+    // one-shot: the session is off the list until its worker is done with it
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    event.data.ptr = session;
+    if (epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+      end(session);
+  }
+}
+
+// On a worker: send what is left from last time, take in everything the client has sent, run
+// each complete line (until results back up), send the results.
+void SqlServer::serve(Session *session) {
+  if (!send_output(session)) {
+    end(session);
+    return;
+  }
+  if (!session->output.empty()) {
+    wait_for(session);  // the client still hasn't read the last of it
+    return;
+  }
+  char buffer[16 * 1024];
+  while (!session->closing) {
+    ssize_t got = recv(session->fd, buffer, sizeof(buffer), 0);
+    if (got > 0) {
+      session->input.append(buffer, got);
+    } else if (got < 0 && errno == EINTR) {
+      continue;
+    } else {
+      session->closing = got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+      break;
+    }
+  }
+
+  TransactionManager::resume(session->txn);
+  bool gone = false;    // the client stopped taking results
+  size_t start = 0;
+  size_t end_of_line;
+  // a client that hangs up partway through a long result ends it (and the session)
+  ResultStream stream = [this, session, &gone](const std::string &lines) {
+    append_output(session, lines);
+    if (session->output.size() >= STREAM_BYTES && !send_output(session)) {
+      gone = true;
+      throw std::runtime_error("client is gone");
+    }
+  };
+  while (!gone && session->output.size() < STREAM_BYTES
+         && (end_of_line = session->input.find('\n', start)) != std::string::npos) {
+    std::string line = session->input.substr(start, end_of_line - start);
+    start = end_of_line + 1;
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line == "quit") {
+      session->closing = true;
+      start = session->input.size();
+      break;
+    }
+
+    std::string result;
+    try
+      {
+        result = this->handler(line, session->prepared, stream);
+      }
+    catch(std::exception const& e)
+      {
+        result = std::string("ERROR: ") + e.what();
+      }
+    this->statements++;
+    if (!result.empty())
+      append_output(session, result);
+    session->output += ".\n";
+    if (session->output.size() >= STREAM_BYTES && !send_output(session))
+      gone = true;
+  }
+  session->input.erase(0, start);
+  if (!gone && !send_output(session))
+    gone = true;
+  session->txn = TransactionManager::suspend();
+
+  if (gone || (session->closing && session->output.empty() && session->input.find('\n') == std::string::npos)) {
+    end(session);
+    return;
+  }
+  wait_for(session);
+}
+
+// add lines to session's pending output, with a "." in front of any that starts with one
+void SqlServer::append_output(Session *session, const std::string &lines) {
+  size_t line_start = 0;
+  do {
+    size_t line_end = lines.find('\n', line_start);
+    if (line_end == std::string::npos)
+      line_end = lines.size();
+    if (line_start < lines.size() && lines[line_start] == '.')
+      session->output += '.';
+    session->output.append(lines, line_start, line_end - line_start);
+    session->output += '\n';
+    line_start = line_end + 1;
+  } while (line_start <= lines.size());
+}
+
+// send as much of session's pending output as the socket takes without waiting; false if the client is gone
+bool SqlServer::send_output(Session *session) {
+  size_t sent = 0;
+  bool ok = true;
+  while (sent < session->output.size()) {
+    ssize_t n = send(session->fd, session->output.data() + sent, session->output.size() - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else {
+      ok = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+      break;
+    }
+  }
+  session->output.erase(0, sent);
+  return ok;
+}
+
+// Hand session back to the epoll thread: to wait for room for its pending results (or just
+// to run the lines it already has) if there is more to do now, otherwise for more input.
+void SqlServer::wait_for(Session *session) {
+  bool more = !session->output.empty() || session->input.find('\n') != std::string::npos;
+  epoll_event event;
+  event.events = (more ? EPOLLOUT : EPOLLIN | EPOLLRDHUP) | EPOLLONESHOT;
+  event.data.ptr = session;
+  if (epoll_ctl(this->epoll_fd, EPOLL_CTL_MOD, session->fd, &event) < 0)
+    end(session);
+}
+
+void SqlServer::end(Session *session) {
+  // as if the client had sent ROLLBACK: rollback() takes the statement lock itself
+  if (session->txn != nullptr && _TXN_MANAGER != nullptr) {
+    TransactionManager::resume(session->txn);
+    try
+      {
+        _TXN_MANAGER->rollback();
+      }
+    catch(std::exception const&)
+      {
+      }
+  }
+  close(session->fd);
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->sessions.erase(session);
+  }
+  delete session;
+}
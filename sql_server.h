@@ -0,0 +1,138 @@
+/**
+ * @file sql_server.h - Multi-client network front end for the SQL shell.
+ * SqlServer
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include "db_cxx.h"
+#include "statement_cache.h"
+#include "thread_pool.h"
+
+// Hands part of a statement's result (whole lines, without the last newline) to the
+// client ahead of the rest, so a long result goes out as it is produced
+typedef std::function<void(const std::string &lines)> ResultStream;
+
+/**
+ * @class SqlServer - serves the SQL shell to many clients over loopback TCP
+ *
+ * Protocol: a client sends lines, each one what would be typed at the SQL> prompt, and
+ * may send any number before reading any results (pipelining). For each line the
+ * server sends back the handler's output lines followed by a line holding just ".";
+ * an output line that starts with "." gets another "." in front. "quit" ends the
+ * session.
+ *
+ * One thread waits on all the sockets (epoll); when a session has input, it is handed
+ * to the fixed pool of worker threads, which reads everything available, runs each
+ * complete line through the handler, and writes the results back as they pile up
+ * (every STREAM_BYTES, even partway through one statement's result, and at the end
+ * of the input). A worker never waits on a client: whatever the socket won't take
+ * stays with the session, which then waits (off any worker) until the client has
+ * read enough, and runs no more of its lines until its results have all gone out.
+ * A session is with at most one
+ * worker at a time, so many sessions share a few workers, and each session's open
+ * transaction and its PREPAREd statements travel with it (see TransactionManager::suspend).
+ * A session that ends with a transaction open is rolled back, through the same
+ * TransactionManager::rollback as a ROLLBACK line (so under the statement lock).
+ *
+ * The workers overlap only in reading lines, parsing, and sending results: sql5300's
+ * handler runs every statement under one lock (its dataLock), so two statements,
+ * even two SELECTs, never run at the same time, however many workers there are.
+ *
+ * Methods:
+ * 	run()
+ * 	stop()
+ * 	get_port()
+ * 	get_sessions()
+ * 	get_statements()
+ */
+class SqlServer {
+public:
+    typedef std::function<std::string(const std::string &line, PreparedStatements &prepared,
+                                      const ResultStream &stream)> Handler;
+
+    /**
+     * Results are written back whenever this many bytes are waiting to go.
+     */
+    static const size_t STREAM_BYTES = 64 * 1024;
+
+    /**
+     * Start listening on 127.0.0.1.
+     * @param port         TCP port; 0 for any free one (see get_port)
+     * @param handler      runs one line for a session (given the session's PREPAREd
+     *                     statements) and returns its output, or the rest of it if
+     *                     some went out early through the stream
+     * @param num_workers  worker threads; 0 for one per hardware thread
+     * @throws             std::runtime_error if the socket can't be set up
+     */
+    SqlServer(u_int16_t port, Handler handler, uint num_workers = 0);
+
+    /**
+     * Finishes the work in hand, then closes every session.
+     */
+    virtual ~SqlServer();
+
+    SqlServer(const SqlServer &other) = delete;
+
+    SqlServer(SqlServer &&temp) = delete;
+
+    SqlServer &operator=(const SqlServer &other) = delete;
+
+    SqlServer &operator=(SqlServer &&temp) = delete;
+
+    /**
+     * Accept and serve clients until stop().
+     */
+    virtual void run();
+
+    /**
+     * Make run() return. Safe to call from another thread or a signal handler.
+     */
+    virtual void stop();
+
+    virtual u_int16_t get_port() const { return port; }
+
+    virtual u_int64_t get_sessions() const { return sessions_served; }
+
+    virtual u_int64_t get_statements() const { return statements; }
+
+protected:
+    struct Session {
+        int fd;
+        std::string input;      // received, not yet a complete line
+        std::string output;     // results not yet sent
+        bool closing;           // quit or end of input: end once output is sent
+        DbTxn *txn;             // open transaction, between lines
+        PreparedStatements prepared;
+    };
+
+    u_int16_t port;
+    Handler handler;
+    int listen_fd;
+    int epoll_fd;
+    int stop_fd;
+    std::mutex lock;            // guards sessions
+    std::unordered_set<Session *> sessions;
+    std::atomic<u_int64_t> sessions_served;
+    std::atomic<u_int64_t> statements;
+    ThreadPool workers;
+
+    virtual void accept_all();
+
+    virtual void serve(Session *session);
+
+    virtual void append_output(Session *session, const std::string &lines);
+
+    virtual bool send_output(Session *session);
+
+    virtual void wait_for(Session *session);
+
+    virtual void end(Session *session);
+};
@@ -0,0 +1,205 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "statement_cache.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+using namespace hsql;
+
+static void find_placeholders(const SelectStatement *select, std::vector<const Expr *> &found);
+
+static void find_placeholders(const Expr *expr, std::vector<const Expr *> &found) {
+  if (expr == nullptr)
+    return;
+  if (expr->type == kExprPlaceholder)
+    found.push_back(expr);
+  find_placeholders(expr->expr, found);
+  find_placeholders(expr->expr2, found);
+  if (expr->exprList != nullptr)
+    for (auto const& item: *expr->exprList)
+      find_placeholders(item, found);
+  find_placeholders(expr->select, found);
+}
+
+static void find_placeholders(const TableRef *table, std::vector<const Expr *> &found) {
+  if (table == nullptr)
+    return;
+  find_placeholders(table->select, found);
+  if (table->list != nullptr)
+    for (auto const& item: *table->list)
+      find_placeholders(item, found);
+  if (table->join != nullptr) {
+    find_placeholders(table->join->left, found);
+    find_placeholders(table->join->right, found);
+    find_placeholders(table->join->condition, found);
+  }
+}
+
+static void find_placeholders(const SelectStatement *select, std::vector<const Expr *> &found) {
+  if (select == nullptr)
+    return;
+  if (select->selectList != nullptr)
+    for (auto const& item: *select->selectList)
+      find_placeholders(item, found);
+  find_placeholders(select->fromTable, found);
+  find_placeholders(select->whereClause, found);
+  if (select->groupBy != nullptr) {
+    if (select->groupBy->columns != nullptr)
+      for (auto const& item: *select->groupBy->columns)
+        find_placeholders(item, found);
+    find_placeholders(select->groupBy->having, found);
+  }
+  if (select->order != nullptr)
+    for (auto const& item: *select->order)
+      find_placeholders(item->expr, found);
+  find_placeholders(select->unionSelect, found);
+}
+
+CachedStatement::CachedStatement(const std::string &sql) : sql(sql), parse(SQLParser::parseSQLString(sql))
+{
+  if (!this->parse->isValid())
+    return;
+  for (uint i = 0; i < this->parse->size(); i++) {
+    const SQLStatement *statement = this->parse->getStatement(i);
+    switch (statement->type()) {
+      case kStmtSelect:
+        find_placeholders((const SelectStatement *) statement, this->placeholders);
+        break;
+      case kStmtInsert: {
+        const InsertStatement *insert = (const InsertStatement *) statement;
+        if (insert->values != nullptr)
+          for (auto const& value: *insert->values)
+            find_placeholders(value, this->placeholders);
+        find_placeholders(insert->select, this->placeholders);
+        break;
+      }
+      case kStmtDelete:
+        find_placeholders(((const DeleteStatement *) statement)->expr, this->placeholders);
+        break;
+      default:
+        break;
+    }
+  }
+  // the parser numbers placeholders by where they are in the text
+  std::stable_sort(this->placeholders.begin(), this->placeholders.end(), [](const Expr *a, const Expr *b) {
+    return a->ival < b->ival;
+  });
+}
+
+CachedStatement::~CachedStatement() {
+  delete this->parse;
+}
+
+Bindings CachedStatement::bind(const std::vector<Value> &values) const {
+  if (values.size() != this->placeholders.size())
+    throw DbRelationError("statement takes " + std::to_string(this->placeholders.size()) + " parameters, not "
+                          + std::to_string(values.size()));
+  Bindings bindings;
+  for (size_t i = 0; i < values.size(); i++)
+    bindings[this->placeholders[i]] = values[i];
+  return bindings;
+}
+
+
+StatementCache::StatementCache(uint capacity) : capacity(capacity), hits(0), misses(0)
+{
+  if (capacity == 0)
+    throw std::invalid_argument("statement cache needs room for at least one statement");
+}
+
+std::shared_ptr<const CachedStatement> StatementCache::get(const std::string &sql) {
+  std::string key = normalize(sql);
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    auto found = this->entries.find(key);
+    if (found != this->entries.end()) {
+      this->hits++;
+      this->recent.splice(this->recent.begin(), this->recent, found->second);
+      return found->second->second;
+    }
+    this->misses++;
+  }
+
+  // parse without the lock; if two sessions race on the same text, the second parse wins
+  std::shared_ptr<const CachedStatement> statement(new CachedStatement(key));
+  if (!statement->is_valid())
+    return statement;
+  std::lock_guard<std::mutex> guard(this->lock);
+  auto found = this->entries.find(key);
+  if (found != this->entries.end()) {
+    this->recent.erase(found->second);
+    this->entries.erase(found);
+  }
+  this->recent.push_front(Entry(key, statement));
+  this->entries[key] = this->recent.begin();
+  if (this->recent.size() > this->capacity) {
+    this->entries.erase(this->recent.back().first);
+    this->recent.pop_back();
+  }
+  return statement;
+}
+
+std::string StatementCache::normalize(const std::string &sql) {
+  std::string normal;
+  normal.reserve(sql.size());
+  char quote = 0;
+  bool space = false;
+  for (char c: sql) {
+    if (quote == 0 && isspace((unsigned char) c)) {
+      space = true;
+      continue;
+    }
+    if (space && !normal.empty())
+      normal += ' ';
+    space = false;
+    normal += c;
+    if (quote == 0 && (c == '\'' || c == '"'))
+      quote = c;
+    else if (c == quote)
+      quote = 0;  // a doubled quote just closes and reopens
+  }
+  while (!normal.empty() && (normal.back() == ';' || normal.back() == ' '))
+    normal.pop_back();
+  return normal;
+}
+
+
+// test function -- returns true if all tests pass
+bool test_statement_cache() {
+    if (StatementCache::normalize("  SELECT  a,\tb FROM foo\n WHERE b = 'x  y' ;; ") != "SELECT a, b FROM foo WHERE b = 'x  y'")
+        return false;
+    std::cout << "normalize ok" << std::endl;
+
+    StatementCache cache(2);
+    auto first = cache.get("SELECT a FROM foo WHERE a = ? AND b = ?");
+    if (!first->is_valid() || first->get_num_parameters() != 2)
+        return false;
+    auto again = cache.get("SELECT a FROM foo  WHERE a = ? AND b = ?;");
+    if (again != first || cache.get_hits() != 1 || cache.get_misses() != 1)
+        return false;
+    Bindings bindings = first->bind({Value(1), Value("two")});
+    if (bindings.size() != 2)
+        return false;
+    try {
+        first->bind({Value(1)});
+        return false;
+    } catch (DbRelationError const&) {
+    }
+    std::cout << "parameters ok" << std::endl;
+
+    // least recently used goes first; invalid SQL is not kept
+    cache.get("SELECT b FROM foo");
+    cache.get("SELECT a FROM foo WHERE a = ? AND b = ?");
+    cache.get("SELECT c FROM foo");
+    cache.get("SELECT b FROM foo");
+    if (cache.get_hits() != 2 || cache.get_misses() != 4)
+        return false;
+    auto bad = cache.get("SELEKT nonsense");
+    bad = cache.get("SELEKT nonsense");
+    if (bad->is_valid() || cache.get_misses() != 6)
+        return false;
+    std::cout << "lru ok" << std::endl;
+    return true;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file statement_cache.h - Parsed SQL statements, kept for reuse.
+ * CachedStatement
+ * StatementCache
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SQLParser.h"
+#include "storage_engine.h"
+
+// Values of a statement's ? parameters, by placeholder expression
+typedef std::unordered_map<const hsql::Expr *, Value> Bindings;
+
+/**
+ * @class CachedStatement - the parse of one SQL string, ready to run any number of times
+ *
+ * The string may hold ? placeholders (numbered 0, 1, ... in the order they appear);
+ * bind() pairs them with values for one run. The parse is never changed after
+ * construction, so one CachedStatement can be shared by several sessions at once.
+ *
+ * Methods:
+ * 	is_valid()
+ * 	get_parse()
+ * 	get_sql()
+ * 	get_num_parameters()
+ * 	bind(values)
+ */
+class CachedStatement {
+public:
+    /**
+     * Parse sql.
+     * @param sql  one or more SQL statements
+     */
+    CachedStatement(const std::string &sql);
+
+    virtual ~CachedStatement();
+
+    CachedStatement(const CachedStatement &other) = delete;
+
+    CachedStatement(CachedStatement &&temp) = delete;
+
+    CachedStatement &operator=(const CachedStatement &other) = delete;
+
+    CachedStatement &operator=(CachedStatement &&temp) = delete;
+
+    virtual bool is_valid() const { return parse->isValid(); }
+
+    virtual const hsql::SQLParserResult *get_parse() const { return parse; }
+
+    virtual const std::string &get_sql() const { return sql; }
+
+    virtual uint get_num_parameters() const { return (uint) placeholders.size(); }
+
+    /**
+     * Pair each placeholder with its value.
+     * @param values  one per placeholder, in order
+     * @returns       the bindings for execute()
+     * @throws        DbRelationError if the number of values is wrong
+     */
+    virtual Bindings bind(const std::vector<Value> &values) const;
+
+protected:
+    std::string sql;
+    hsql::SQLParserResult *parse;
+    std::vector<const hsql::Expr *> placeholders;   // in the order they appear in sql
+};
+
+// A session's PREPAREd statements, by name
+typedef std::map<std::string, std::shared_ptr<const CachedStatement>> PreparedStatements;
+
+/**
+ * @class StatementCache - LRU cache of CachedStatements, keyed by normalized SQL text
+ *
+ * Statements that arrive as the same text apart from spacing (and a trailing ";")
+ * are parsed once. Entries are handed out as shared pointers, so one evicted while
+ * a session is still running it stays alive until that session is done. Only
+ * statements that parse are kept. All methods are safe to call from several threads.
+ *
+ * Methods:
+ * 	get(sql)
+ * 	normalize(sql)
+ * Accessors for sizing the cache:
+ * 	get_capacity()
+ * 	get_hits()
+ * 	get_misses()
+ */
+class StatementCache {
+public:
+    /**
+     * number of statements kept when none is specified
+     */
+    static const uint DEFAULT_CAPACITY = 256;
+
+    StatementCache(uint capacity = DEFAULT_CAPACITY);
+
+    virtual ~StatementCache() {}
+
+    StatementCache(const StatementCache &other) = delete;
+
+    StatementCache(StatementCache &&temp) = delete;
+
+    StatementCache &operator=(const StatementCache &other) = delete;
+
+    StatementCache &operator=(StatementCache &&temp) = delete;
+
+    /**
+     * The parse of sql, from the cache if it has been seen recently.
+     * @param sql  SQL text
+     * @returns    its CachedStatement (check is_valid())
+     */
+    virtual std::shared_ptr<const CachedStatement> get(const std::string &sql);
+
+    /**
+     * sql with runs of white space outside quotes squeezed to one space, and leading
+     * and trailing space and ";" dropped.
+     */
+    static std::string normalize(const std::string &sql);
+
+    virtual uint get_capacity() const { return capacity; }
+
+    virtual u_int64_t get_hits() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return hits;
+    }
+
+    virtual u_int64_t get_misses() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return misses;
+    }
+
+protected:
+    typedef std::pair<std::string, std::shared_ptr<const CachedStatement>> Entry;
+
+    uint capacity;
+    mutable std::mutex lock;
+    std::list<Entry> recent;    // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries;
+    u_int64_t hits;
+    u_int64_t misses;
+};
+
+bool test_statement_cache();
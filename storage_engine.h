@@ -3,14 +3,19 @@
  * DbBlock
  * DbFile
  * DbRelation
+ * DbIndex
+ * Row
+ * RowBatch
  *
  * @author Kevin Lundeen, Dhruv Patel
  * @see "Seattle University, CPSC5300, Winter Quarter 2024"
  */
 #pragma once
 
+#include <cstring>
 #include <exception>
 #include <map>
+#include <string>
 #include <utility>
 #include <vector>
 #include "db_cxx.h"
@@ -28,6 +33,22 @@ typedef u_int32_t BlockID;
 typedef std::vector<RecordID> RecordIDs;
 typedef std::length_error DbBlockNoRoomError;
 
+/**
+ * @class RecordView - non-owning view of a record's bytes inside a block
+ *
+ * Just a pointer and a length into the block's memory; it is only valid
+ * while the block it came from is alive and the record is unchanged.
+ */
+class RecordView {
+public:
+    const char *data;
+    u_int32_t size;
+
+    RecordView() : data(nullptr), size(0) {}
+
+    RecordView(const void *data, u_int32_t size) : data((const char *) data), size(size) {}
+};
+
 /**
  * @class DbBlock - abstract base class for blocks in our database files 
  * (DbBlock's belong to DbFile's.)
@@ -36,9 +57,11 @@ typedef std::length_error DbBlockNoRoomError;
  * 	initialize_new()
  * 	add(data)
  * 	get(record_id)
+ * 	view(record_id, record)
  * 	put(record_id, data)
  * 	del(record_id)
  * 	ids()
+ * 	free_space()
  * Accessors:
  * 	get_block()
  * 	get_data()
@@ -47,10 +70,16 @@ typedef std::length_error DbBlockNoRoomError;
 class DbBlock {
 public:
     /**
-     * our blocks are 4kB
+     * our blocks are 4kB unless a file is created with another size
      */
     static const uint BLOCK_SZ = 4096;
 
+    /**
+     * range of block sizes a file can be created with (powers of two only)
+     */
+    static const uint MIN_BLOCK_SZ = 1024;
+    static const uint MAX_BLOCK_SZ = 1024 * 1024;
+
     /**
      * ctor/dtor (subclasses should handle the big-5)
      */
@@ -78,6 +107,14 @@ public:
      */
     virtual Dbt *get(RecordID record_id) = 0;
 
+    /**
+     * Borrow a record's bytes from this block without copying or allocating.
+     * @param record_id  which record to look at
+     * @param record     set to point at the record within this block's memory
+     * @returns          false if there is no such record (e.g., it was deleted)
+     */
+    virtual bool view(RecordID record_id, RecordView &record) = 0;
+
     /**
      * Change the data stored for a record in this block.
      * @param record_id  which record to update
@@ -99,6 +136,12 @@ public:
      */
     virtual RecordIDs *ids() = 0;
 
+    /**
+     * How large a record this block could take right now.
+     * @returns  the largest data size add() would currently accept
+     */
+    virtual u_int32_t free_space() = 0;
+
     /**
      * Access the whole block's memory as a BerkeleyDB Dbt pointer.
      * @returns  Dbt used by this block
@@ -122,8 +165,30 @@ protected:
     BlockID block_id;
 };
 
-// convenience type alias
-typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an iterator at some point
+/**
+ * @class BlockIDCursor - forward-only cursor over the valid BlockIDs of a DbFile
+ * 	next(block_id)
+ * 	close()
+ *
+ * Only the current position is held, so memory use is constant no matter
+ * how many blocks the file has.
+ */
+class BlockIDCursor {
+public:
+    virtual ~BlockIDCursor() {}
+
+    /**
+     * Advance to the next block in the file.
+     * @param block_id  set to the next BlockID when one is available
+     * @returns         false once the file is exhausted
+     */
+    virtual bool next(BlockID &block_id) = 0;
+
+    /**
+     * Release the underlying resources early (also done by the destructor).
+     */
+    virtual void close() = 0;
+};
 
 /**
  * @class DbFile - abstract base class which represents a disk-based collection of DbBlocks
@@ -134,6 +199,7 @@ typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an
  * 	get_new()
  *	get(block_id)
  *	put(block)
+ *	release(block)
  *	block_ids()
  */
 class DbFile {
@@ -165,14 +231,14 @@ public:
 
     /**
      * Add a new block for this file.
-     * @returns  the newly appended block
+     * @returns  the newly appended block (handed back with release)
      */
     virtual DbBlock *get_new() = 0;
 
     /**
      * Get a specific block in this file.
      * @param block_id  which block to get
-     * @returns         pointer to the DbBlock (freed by caller)
+     * @returns         pointer to the DbBlock (handed back with release)
      */
     virtual DbBlock *get(BlockID block_id) = 0;
 
@@ -183,11 +249,18 @@ public:
     virtual void put(DbBlock *block) = 0;
 
     /**
-     * Get a list of all the valid BlockID's in the file
-     * FIXME - not a good long-term approach, but we'll do this until we put in iterators
-     * @returns  a pointer to vector of BlockIDs (freed by caller)
+     * Tell the file the caller is done with a block from get or get_new.
+     * The block must not be used afterwards.
+     * @param block  block to release
+     */
+    virtual void release(DbBlock *block) = 0;
+
+    /**
+     * Get a cursor over all the valid BlockID's in the file, in order.
+     * The cursor must be closed (or freed) before the file is closed.
+     * @returns  a pointer to a BlockIDCursor (freed by caller)
      */
-    virtual BlockIDs *block_ids() = 0;
+    virtual BlockIDCursor *block_ids() = 0;
 
 protected:
     std::string name;  // filename (or part of it)
@@ -239,6 +312,215 @@ typedef std::vector<ColumnAttribute> ColumnAttributes;
 typedef std::pair<BlockID, RecordID> Handle;
 typedef std::vector<Handle> Handles;  // FIXME: will need to turn this into an iterator at some point
 typedef std::map<Identifier, Value> ValueDict;
+typedef std::vector<ValueDict> ValueDicts;
+
+
+/**
+ * @class Field - one column's value in a Row
+ *
+ * A tagged union: n for an INT, or a TEXT as a pointer and length into bytes
+ * the Field does not own (a block, a ValueDict's string, or its Row's storage).
+ */
+class Field {
+public:
+    ColumnAttribute::DataType data_type;
+    union {
+        int32_t n;
+        u_int32_t size;   // TEXT length
+    };
+    const char *text;
+
+    Field() : data_type(ColumnAttribute::INT), n(0), text(nullptr) {}
+};
+
+/**
+ * @class Row - a row's values indexed by column ordinal
+ *
+ * The engine-side counterpart of ValueDict: one flat vector of Fields, no
+ * per-column allocations and no lookups by name. TEXT Fields start out
+ * borrowing their bytes; own() copies them into the Row so it can outlive
+ * whatever they were borrowed from.
+ *
+ * Methods:
+ * 	size()
+ * 	resize(num_columns)
+ * 	operator[](column)
+ * 	set_int(column, n)
+ * 	set_text(column, data, size)
+ * 	own()
+ * 	swap(other)
+ * 	value(column)
+ */
+class Row {
+public:
+    Row(uint num_columns = 0) : fields(num_columns) {}
+
+    virtual ~Row() {}
+
+    Row(const Row &other) : fields(other.fields) { own(); }
+
+    Row &operator=(const Row &other) {
+        if (this != &other) {
+            fields = other.fields;
+            own();
+        }
+        return *this;
+    }
+
+    uint size() const { return (uint) fields.size(); }
+
+    void resize(uint num_columns) { fields.resize(num_columns); }
+
+    Field &operator[](uint column) { return fields[column]; }
+
+    const Field &operator[](uint column) const { return fields[column]; }
+
+    void set_int(uint column, int32_t n) {
+        fields[column].data_type = ColumnAttribute::INT;
+        fields[column].n = n;
+        fields[column].text = nullptr;
+    }
+
+    /**
+     * Point a column at TEXT bytes; they must stay put until own() or the Row is done with.
+     */
+    void set_text(uint column, const char *data, u_int32_t size) {
+        fields[column].data_type = ColumnAttribute::TEXT;
+        fields[column].size = size;
+        fields[column].text = data;
+    }
+
+    /**
+     * Copy all borrowed TEXT into the Row's own storage (one allocation at most).
+     */
+    void own() {
+        size_t total = 0;
+        for (auto const &field: fields)
+            if (field.data_type == ColumnAttribute::TEXT)
+                total += field.size;
+        std::vector<char> copy(total);
+        size_t at = 0;
+        for (auto &field: fields) {
+            if (field.data_type == ColumnAttribute::TEXT) {
+                if (field.size > 0)
+                    std::memcpy(copy.data() + at, field.text, field.size);
+                field.text = copy.data() + at;
+                at += field.size;
+            }
+        }
+        storage.swap(copy);  // vector swap keeps the buffer, so the pointers stay good
+    }
+
+    /**
+     * Exchange contents with another Row without copying any TEXT.
+     */
+    void swap(Row &other) {
+        fields.swap(other.fields);
+        storage.swap(other.storage);
+    }
+
+    /**
+     * A column as a Value, for handing back through the ValueDict API.
+     */
+    Value value(uint column) const {
+        const Field &field = fields[column];
+        if (field.data_type == ColumnAttribute::INT)
+            return Value(field.n);
+        return Value(std::string(field.text, field.size));
+    }
+
+protected:
+    std::vector<Field> fields;
+    std::vector<char> storage;
+};
+
+
+/**
+ * @class RowBatch - a run of Rows handed between query operators in one call
+ *
+ * Holds about CAPACITY rows (a producer that works a block at a time may go over).
+ * The Rows are kept when the batch is cleared, so refilling it reuses their
+ * memory rather than allocating again.
+ *
+ * Methods:
+ * 	size()
+ * 	empty()
+ * 	full()
+ * 	operator[](i)
+ * 	add()
+ * 	truncate(size)
+ * 	clear()
+ */
+class RowBatch {
+public:
+    /**
+     * rows a producer aims to put in a batch
+     */
+    static const uint CAPACITY = 1024;
+
+    RowBatch() : count(0) {}
+
+    virtual ~RowBatch() {}
+
+    uint size() const { return count; }
+
+    bool empty() const { return count == 0; }
+
+    bool full() const { return count >= CAPACITY; }
+
+    Row &operator[](uint i) { return rows[i]; }
+
+    const Row &operator[](uint i) const { return rows[i]; }
+
+    /**
+     * Append a row (holding whatever it last held) and return it for filling in.
+     */
+    Row &add() {
+        if (count == rows.size())
+            rows.emplace_back();
+        return rows[count++];
+    }
+
+    /**
+     * Keep only the first size rows.
+     */
+    void truncate(uint size) {
+        if (size < count)
+            count = size;
+    }
+
+    void clear() { count = 0; }
+
+protected:
+    std::vector<Row> rows;
+    uint count;
+};
+
+
+/**
+ * @class HandleCursor - forward-only cursor over the qualifying rows of a DbRelation
+ * 	next(handle)
+ * 	close()
+ *
+ * Rows are produced incrementally, so a caller can start consuming them right
+ * away and stop early without the whole result ever being materialized.
+ */
+class HandleCursor {
+public:
+    virtual ~HandleCursor() {}
+
+    /**
+     * Advance to the next qualifying row.
+     * @param handle  set to the next row's handle when one is available
+     * @returns       false once the scan is exhausted
+     */
+    virtual bool next(Handle &handle) = 0;
+
+    /**
+     * Stop the scan and release its resources (also done by the destructor).
+     */
+    virtual void close() = 0;
+};
 
 
 /**
@@ -262,10 +544,13 @@ public:
  * 	close()
  * 	
  *	insert(row)
+ *	insert_batch(rows)
  *	update(handle, new_values)
  *	del(handle)
  *	select()
  *	select(where)
+ *	cursor()
+ *	cursor(where)
  *	project(handle)
  *	project(handle, column_names)
  */
@@ -313,6 +598,15 @@ public:
      */
     virtual Handle insert(const ValueDict *row) = 0;
 
+    /**
+     * Execute: INSERT INTO <table_name> ( <row_keys> ) VALUES ( <row_values> ), ...
+     * Same as calling insert for each row, but packs rows into blocks as it goes
+     * so each block is fetched and written once rather than once per row.
+     * @param rows  dictionaries keyed by column names
+     * @returns     a pointer to a list of handles to the new rows, in order (freed by caller)
+     */
+    virtual Handles *insert_batch(const ValueDicts *rows) = 0;
+
     /**
      * Conceptually, execute: UPDATE INTO <table_name> SET <new_values> WHERE <handle>
      * where handle is sufficient to identify one specific record (e.g., returned
@@ -343,6 +637,19 @@ public:
      */
     virtual Handles *select(const ValueDict *where) = 0;
 
+    /**
+     * Streaming form of select(): SELECT <handle> FROM <table_name> WHERE 1
+     * @returns  a pointer to a cursor over all rows (freed by caller)
+     */
+    virtual HandleCursor *cursor() = 0;
+
+    /**
+     * Streaming form of select(where): SELECT <handle> FROM <table_name> WHERE <where>
+     * @param where  where-clause predicates (must outlive the cursor)
+     * @returns      a pointer to a cursor over the qualifying rows (freed by caller)
+     */
+    virtual HandleCursor *cursor(const ValueDict *where) = 0;
+
     /**
      * Return a sequence of all values for handle (SELECT *).
      * @param handle  row to get values from
@@ -359,6 +666,12 @@ public:
      */
     virtual ValueDict *project(Handle handle, const ColumnNames *column_names) = 0;
 
+    virtual Identifier get_table_name() const { return table_name; }
+
+    virtual const ColumnNames &get_column_names() const { return column_names; }
+
+    virtual const ColumnAttributes &get_column_attributes() const { return column_attributes; }
+
 protected:
     Identifier table_name;
     ColumnNames column_names;
@@ -366,3 +679,103 @@ protected:
 };
 
 
+// Key values for an index, in the index's key column order
+typedef std::vector<Value> KeyValue;
+
+
+/**
+ * @class DbIndex - secondary index on one or more columns of a DbRelation
+ *
+ * Maps key column values to the Handles of the rows that have them.
+ * The relation keeps its indices in sync as rows are inserted, updated, and deleted.
+ *
+ * Methods:
+ * 	create()
+ * 	drop()
+ * 	open()
+ * 	close()
+ * 	lookup(key_values)
+ * 	range(min_key, max_key)
+ * 	insert(handle)
+ * 	del(handle)
+ */
+class DbIndex {
+public:
+    /**
+     * Maximum number of columns in a composite index
+     */
+    static const uint MAX_COMPOSITE = 32U;
+
+    // ctor/dtor
+    DbIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique)
+            : relation(relation), name(name), key_columns(key_columns), unique(unique) {}
+
+    virtual ~DbIndex() {}
+
+    /**
+     * Create this index and fill it from the rows already in the relation.
+     */
+    virtual void create() = 0;
+
+    /**
+     * Drop this index.
+     */
+    virtual void drop() = 0;
+
+    /**
+     * Open this index.
+     */
+    virtual void open() = 0;
+
+    /**
+     * Close this index.
+     */
+    virtual void close() = 0;
+
+    /**
+     * Lookup a specific search key.
+     * @param key_values  dictionary of values for search keys
+     * @returns           a pointer to a list of handles for qualifying rows (caller frees)
+     */
+    virtual Handles *lookup(const ValueDict *key_values) = 0;
+
+    /**
+     * Lookup a range of search keys, inclusive at both ends.
+     * @param min_key  dictionary of values for the smallest key (nullptr for no lower bound)
+     * @param max_key  dictionary of values for the largest key (nullptr for no upper bound)
+     * @returns        a pointer to a list of handles for qualifying rows, in key order (caller frees)
+     */
+    virtual Handles *range(const ValueDict *min_key, const ValueDict *max_key) {
+        throw DbRelationError("range not supported by index " + name);
+    }
+
+    /**
+     * Insert the index entry for the given handle of the underlying relation.
+     * @param handle  the row to add to the index
+     */
+    virtual void insert(Handle handle) = 0;
+
+    /**
+     * Delete the index entry for the given handle of the underlying relation.
+     * Must be called while the row is still in the relation.
+     * @param handle  the row to remove from the index
+     */
+    virtual void del(Handle handle) = 0;
+
+    virtual Identifier get_name() const { return name; }
+
+    virtual const ColumnNames &get_key_columns() const { return key_columns; }
+
+    virtual bool is_unique() const { return unique; }
+
+    /**
+     * Whether this index keeps its keys in order (so range() works).
+     */
+    virtual bool is_ordered() const { return true; }
+
+protected:
+    DbRelation &relation;
+    Identifier name;
+    ColumnNames key_columns;
+    bool unique;
+};
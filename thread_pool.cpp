@@ -0,0 +1,126 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "thread_pool.h"
+
+// which pool and worker the current thread is, so submits from a task stay local
+static thread_local ThreadPool *current_pool = nullptr;
+static thread_local uint current_worker = 0;
+
+ThreadPool::ThreadPool(uint num_threads): queued(0), pending(0), next_queue(0), sleeping(0), stopping(false)
+{
+  if (num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+    if (num_threads == 0)
+      num_threads = 1;
+  }
+  for (uint i = 0; i < num_threads; i++) {
+    this->queues.push_back(std::unique_ptr<Queue>(new Queue()));
+  }
+  for (uint i = 0; i < num_threads; i++) {
+    this->threads.push_back(std::thread(&ThreadPool::work, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> guard(this->lock);
+    this->all_done.wait(guard, [this] { return this->pending == 0; });
+    this->stopping = true;
+  }
+  this->work_ready.notify_all();
+  for (auto &thread: this->threads) {
+    thread.join();
+  }
+}
+
+ThreadPool &ThreadPool::shared() {
+  static ThreadPool pool;
+  return pool;
+}
+
+// Counted before the push, so a worker's take() can never count a task out before it is counted
+// in; a worker that sees the count first may look once or twice before the task is there
+void ThreadPool::submit(Task task) {
+  uint target = current_pool == this ? current_worker : this->next_queue++ % (uint) this->queues.size();
+  this->pending++;
+  this->queued++;
+  {
+    std::lock_guard<std::mutex> guard(this->queues[target]->lock);
+    this->queues[target]->tasks.push_back(std::move(task));
+  }
+  // a worker counts itself sleeping before it checks queued, so one of us sees the other
+  if (this->sleeping > 0) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->work_ready.notify_one();
+  }
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> guard(this->lock);
+  this->all_done.wait(guard, [this] { return this->pending == 0; });
+  if (this->error) {
+    std::exception_ptr error = this->error;
+    this->error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::work(uint me) {
+  current_pool = this;
+  current_worker = me;
+  while (true) {
+    Task task;
+    if (take(me, task)) {
+      std::exception_ptr failure;
+      try
+        {
+          task();
+        }
+      catch(...)
+        {
+          failure = std::current_exception();
+        }
+      if (failure) {
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (!this->error)
+          this->error = failure;
+      }
+      if (--this->pending == 0) {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->all_done.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(this->lock);
+    this->sleeping++;
+    this->work_ready.wait(guard, [this] { return this->stopping || this->queued > 0; });
+    this->sleeping--;
+    if (this->stopping && this->queued == 0)
+      return;
+  }
+}
+
+// newest of our own tasks first (its data is likely still in cache), else steal the oldest of someone else's
+bool ThreadPool::take(uint me, Task &task) {
+  uint num_queues = (uint) this->queues.size();
+  for (uint i = 0; i < num_queues; i++) {
+    Queue &queue = *this->queues[(me + i) % num_queues];
+    {
+      std::lock_guard<std::mutex> guard(queue.lock);
+      if (queue.tasks.empty())
+        continue;
+      if (i == 0) {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      } else {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      }
+    }
+    this->queued--;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file thread_pool.h - Work-stealing pool of worker threads.
+ * ThreadPool
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool - fixed set of worker threads running submitted tasks
+ *
+ * Each worker has its own deque of tasks. Tasks submitted from outside the pool
+ * are dealt round-robin across the deques; a task submitted by a worker goes on
+ * that worker's own deque. A worker takes its newest task first and, when its
+ * deque is empty, steals the oldest task from another worker's, so uneven tasks
+ * (e.g., scan morsels over blocks with very different numbers of matches) even
+ * out. The pool-wide counts of tasks queued and unfinished are atomics, so submit
+ * and take lock only the deque they use; the pool's own mutex is taken just to put
+ * an idle worker to sleep or wake one, and to tell wait() the last task is done.
+ *
+ * Methods:
+ * 	submit(task)
+ * 	wait()
+ * 	size()
+ * 	shared()
+ */
+class ThreadPool {
+public:
+    typedef std::function<void()> Task;
+
+    /**
+     * @param num_threads  number of workers; 0 for one per hardware thread
+     */
+    ThreadPool(uint num_threads = 0);
+
+    /**
+     * Finishes the tasks already submitted, then stops the workers.
+     */
+    virtual ~ThreadPool();
+
+    ThreadPool(const ThreadPool &other) = delete;
+
+    ThreadPool(ThreadPool &&temp) = delete;
+
+    ThreadPool &operator=(const ThreadPool &other) = delete;
+
+    ThreadPool &operator=(ThreadPool &&temp) = delete;
+
+    /**
+     * Queue a task to be run by some worker.
+     */
+    virtual void submit(Task task);
+
+    /**
+     * Block until every task submitted so far has finished.
+     * @throws  the first exception any of those tasks threw (the rest still ran)
+     */
+    virtual void wait();
+
+    /**
+     * Number of worker threads.
+     */
+    virtual uint size() const { return (uint) threads.size(); }
+
+    /**
+     * The process's long-lived pool (one worker per hardware thread), started on first
+     * use, for operators that would otherwise start threads of their own on every open().
+     * Its tasks may come from several callers at once, so rather than wait() a caller
+     * waits for its own tasks (e.g., through std::packaged_task).
+     */
+    static ThreadPool &shared();
+
+protected:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<size_t> queued;           // tasks in some queue, or about to be (counted before the push)
+    std::atomic<size_t> pending;          // tasks submitted but not yet finished
+    std::atomic<uint> next_queue;         // round-robin for submits from outside
+    std::atomic<uint> sleeping;           // workers waiting for work_ready
+    std::mutex lock;                      // guards everything below, and sleeping and waking
+    std::condition_variable work_ready;
+    std::condition_variable all_done;
+    bool stopping;
+    std::exception_ptr error;
+
+    virtual void work(uint me);
+
+    virtual bool take(uint me, Task &task);
+};
@@ -0,0 +1,332 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "transaction.h"
+#include "buffer_pool.h"
+#include "hash_index.h"
+#include <iostream>
+#include <thread>
+
+// this thread's open transaction
+static thread_local DbTxn *current_txn = nullptr;
+
+TransactionManager::TransactionManager(DbEnv &env, std::chrono::microseconds commit_delay, uint max_batch)
+        : env(env), commit_delay(commit_delay), max_batch(max_batch), statement_lock(nullptr), flushing(false), commits(0), flushed_through(0), flushes(0)
+{
+  // commits only reach the log buffer; wait_for_log does the flushing
+  this->env.set_flags(DB_TXN_NOSYNC, 1);
+  this->env.set_lk_detect(DB_LOCK_DEFAULT);
+}
+
+TransactionManager::~TransactionManager() {
+  try
+    {
+      checkpoint();
+    }
+  catch(DbException const&)
+    {
+    }
+}
+
+void TransactionManager::begin() {
+  std::unique_lock<std::mutex> statements = this->lock_statements();
+  if (current_txn != nullptr)
+    throw TransactionError("a transaction is already in progress");
+  this->env.txn_begin(nullptr, &current_txn, 0);
+}
+
+void TransactionManager::commit() {
+  std::unique_lock<std::mutex> statements = this->lock_statements();
+  DbTxn *txn = current_txn;
+  if (txn == nullptr)
+    throw TransactionError("no transaction in progress");
+  try
+    {
+      _BUFFER_POOL->flush_transaction(txn);
+    }
+  catch(...)
+    {
+      undo();
+      throw;
+    }
+  current_txn = nullptr;
+  // the blocks are written: statements may go on while the commit reaches the log
+  if (statements.owns_lock())
+    statements.unlock();
+  if (this->max_batch == 0) {
+    txn->commit(DB_TXN_SYNC);
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->commits++;
+    this->flushed_through = this->commits;
+    this->flushes++;
+    return;
+  }
+
+  txn->commit(DB_TXN_NOSYNC);
+  u_int64_t ticket;
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    ticket = ++this->commits;
+  }
+  wait_for_log(ticket);
+}
+
+void TransactionManager::rollback() {
+  std::unique_lock<std::mutex> statements = this->lock_statements();
+  undo();
+}
+
+// Hold the statement lock, if there is one
+std::unique_lock<std::mutex> TransactionManager::lock_statements() {
+  if (this->statement_lock == nullptr)
+    return std::unique_lock<std::mutex>();
+  return std::unique_lock<std::mutex>(*this->statement_lock);
+}
+
+// Roll back this thread's transaction (under the statement lock, if there is one)
+void TransactionManager::undo() {
+  DbTxn *txn = current_txn;
+  if (txn == nullptr)
+    throw TransactionError("no transaction in progress");
+  current_txn = nullptr;
+  std::vector<std::pair<HeapFile*, BlockID>> blocks = _BUFFER_POOL->discard_transaction(txn);
+  txn->abort();
+  // the blocks are back to what the log says; let their files catch up
+  for (auto const& block: blocks)
+    block.first->rolled_back(block.second);
+}
+
+void TransactionManager::checkpoint() {
+  this->env.txn_checkpoint(0, 0, 0);
+}
+
+DbTxn* TransactionManager::current() {
+  return current_txn;
+}
+
+DbTxn* TransactionManager::suspend() {
+  DbTxn *txn = current_txn;
+  current_txn = nullptr;
+  return txn;
+}
+
+void TransactionManager::resume(DbTxn *txn) {
+  if (current_txn != nullptr && txn != nullptr)
+    throw TransactionError("a transaction is already in progress");
+  if (txn != nullptr)
+    current_txn = txn;
+}
+
+// Return once the log has been flushed through commit number ticket, leading a flush if none is running.
+void TransactionManager::wait_for_log(u_int64_t ticket) {
+  std::unique_lock<std::mutex> guard(this->lock);
+  if (this->commits - this->flushed_through >= this->max_batch)
+    this->joined.notify_one();
+  while (this->flushed_through < ticket) {
+    if (this->flushing) {
+      this->flushed.wait(guard);
+      continue;
+    }
+
+    this->flushing = true;
+    if (this->commit_delay.count() > 0) {
+      u_int64_t max_batch = this->max_batch;
+      this->joined.wait_for(guard, this->commit_delay, [this, max_batch] {
+        return this->commits - this->flushed_through >= max_batch;
+      });
+    }
+    u_int64_t through = this->commits;
+    guard.unlock();
+    try
+      {
+        this->env.log_flush(nullptr);
+      }
+    catch(...)
+      {
+        guard.lock();
+        this->flushing = false;
+        this->flushed.notify_all();
+        throw;
+      }
+    guard.lock();
+    this->flushing = false;
+    this->flushed_through = through;
+    this->flushes++;
+    this->flushed.notify_all();
+  }
+}
+
+
+// test function -- returns true if all tests pass (needs _TXN_MANAGER)
+bool test_transactions() {
+    if (_TXN_MANAGER == nullptr)
+        return false;
+    ColumnNames column_names = {"a", "b"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+    HeapTable table("_test_txn_cpp", column_names, column_attributes);
+    table.create();
+    HashIndex index(table, "fooindex", ColumnNames{"a"}, true);
+    index.create();
+    table.add_index(&index);
+
+    // enough rows to split buckets and fill several blocks
+    ValueDicts rows;
+    for (int i = 0; i < 2000; i++) {
+        ValueDict row;
+        row["a"] = Value(i);
+        row["b"] = Value("row " + std::to_string(i));
+        rows.push_back(row);
+    }
+    _TXN_MANAGER->begin();
+    delete table.insert_batch(&rows);
+    _TXN_MANAGER->rollback();
+    Handles *handles = table.select();
+    bool empty = handles->empty();
+    delete handles;
+    ValueDict key;
+    key["a"] = Value(7);
+    handles = table.select(&key);
+    empty = empty && handles->empty() && index.get_num_buckets() == HashIndex::INITIAL_BUCKETS;
+    delete handles;
+    if (!empty)
+        return false;
+    std::cout << "rollback ok" << std::endl;
+
+    _TXN_MANAGER->begin();
+    delete table.insert_batch(&rows);
+    _TXN_MANAGER->commit();
+    handles = table.select();
+    bool committed = handles->size() == rows.size();
+    delete handles;
+    handles = table.select(&key);
+    committed = committed && handles->size() == 1;
+    delete handles;
+    if (!committed)
+        return false;
+    std::cout << "commit ok" << std::endl;
+
+    // while one transaction has changes to the table pending, no one else may change it
+    ValueDict extra;
+    extra["a"] = Value(-1);
+    extra["b"] = Value("extra");
+    _TXN_MANAGER->begin();
+    table.insert(&extra);
+    bool refused = false;
+    {
+        NoTransaction outside;
+        extra["a"] = Value(-2);
+        try {
+            table.insert(&extra);
+        } catch (DbRelationError const&) {
+            refused = true;
+        }
+        _TXN_MANAGER->begin();
+        try {
+            table.insert(&extra);
+            refused = false;
+        } catch (DbRelationError const&) {
+        }
+        _TXN_MANAGER->rollback();
+    }
+    _TXN_MANAGER->rollback();
+    table.insert(&extra);   // free again once the transaction is done
+    handles = table.select();
+    refused = refused && handles->size() == rows.size() + 1;
+    delete handles;
+    if (!refused)
+        return false;
+    std::cout << "write claim ok" << std::endl;
+
+    // a block a rollback throws away stays readable by whoever still has it pinned
+    HeapFile file("_test_txn_pinned_cpp");
+    file.create();
+    SlottedPage *page = file.get_new();
+    BlockID block_id = page->get_block_id();
+    file.release(page);
+    _TXN_MANAGER->begin();
+    page = file.get(block_id);
+    char text[] = "changed";
+    Dbt record(text, sizeof(text));
+    page->add(&record);
+    file.put(page);
+    SlottedPage *reader;
+    {
+        NoTransaction outside;
+        reader = file.get(block_id);
+    }
+    file.release(page);
+    _TXN_MANAGER->rollback();
+    bool pinned = reader->get_num_records() == 1;
+    file.release(reader);
+    page = file.get(block_id);
+    pinned = pinned && page->get_num_records() == 0;
+    file.release(page);
+    file.drop();
+    if (!pinned)
+        return false;
+    std::cout << "pinned rollback ok" << std::endl;
+
+    // a transaction may change more blocks than the buffer pool has frames
+    HeapTable big("_test_txn_big_cpp", column_names, column_attributes);
+    big.create();
+    ValueDicts wide;
+    for (uint i = 0; i < 8 * _BUFFER_POOL->get_num_frames(); i++) {
+        ValueDict row;
+        row["a"] = Value((int) i);
+        row["b"] = Value(std::string(1000, 'a' + i % 26));
+        wide.push_back(row);
+    }
+    _TXN_MANAGER->begin();
+    delete big.insert_batch(&wide);
+    _TXN_MANAGER->rollback();
+    handles = big.select();
+    bool larger = handles->empty() && big.get_num_blocks() > _BUFFER_POOL->get_num_frames();
+    delete handles;
+    BlockID num_blocks = big.get_num_blocks();
+    _TXN_MANAGER->begin();
+    delete big.insert_batch(&wide);
+    _TXN_MANAGER->commit();
+    handles = big.select();
+    larger = larger && handles->size() == wide.size() && big.get_num_blocks() == num_blocks;
+    delete handles;
+    big.drop();
+    if (!larger)
+        return false;
+    std::cout << "larger than the pool ok" << std::endl;
+
+    // concurrent committers (each with its own table) share log flushes
+    u_int64_t commits = _TXN_MANAGER->get_commits();
+    std::vector<std::thread> committers;
+    std::vector<uint> counts(4);
+    for (uint t = 0; t < counts.size(); t++) {
+        committers.push_back(std::thread([&counts, &column_names, &column_attributes, t] {
+            HeapTable own("_test_txn_cpp_" + std::to_string(t), column_names, column_attributes);
+            own.create();
+            for (int i = 0; i < 50; i++) {
+                ValueDict row;
+                row["a"] = Value(i);
+                row["b"] = Value("committer " + std::to_string(t));
+                _TXN_MANAGER->begin();
+                own.insert(&row);
+                _TXN_MANAGER->commit();
+            }
+            Handles *own_handles = own.select();
+            counts[t] = (uint) own_handles->size();
+            delete own_handles;
+            own.drop();
+        }));
+    }
+    for (auto &committer: committers)
+        committer.join();
+    bool all = _TXN_MANAGER->get_commits() == commits + 200;
+    for (auto count: counts)
+        all = all && count == 50;
+    if (!all)
+        return false;
+    std::cout << "group commit ok" << std::endl;
+
+    table.remove_index(&index);
+    index.drop();
+    table.drop();
+    return true;
+}
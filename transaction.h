@@ -0,0 +1,206 @@
+/**
+ * @file transaction.h - Berkeley DB transactions with group commit.
+ * TransactionError
+ * TransactionManager
+ * NoTransaction
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include "db_cxx.h"
+
+/**
+ * @class TransactionError - misuse of BEGIN/COMMIT/ROLLBACK, or a failed commit
+ */
+class TransactionError : public std::runtime_error {
+public:
+    explicit TransactionError(std::string s) : runtime_error(s) {}
+};
+
+/**
+ * @class TransactionManager - BEGIN/COMMIT/ROLLBACK over a transactional DbEnv
+ *
+ * Each thread has at most one open transaction. A client session that moves between
+ * worker threads carries its transaction along with suspend() and resume().
+ * Blocks changed while it is open stay in the buffer pool, tied to the transaction and
+ * never evicted; commit() writes them to Berkeley DB under the transaction, whose log
+ * records make the change durable, and rollback() just throws them away (see
+ * BufferPool::flush_transaction and discard_transaction). A transaction's first change
+ * to a table claims it (see BufferPool::claim): until the transaction commits or rolls
+ * back, any other transaction's (or autocommit statement's) change to that table fails
+ * with DbRelationError rather than landing in blocks the transaction may throw away.
+ * Given the lock statements run under (set_statement_lock), begin, commit, and rollback
+ * hold it too, so a rollback never throws away a block a statement is using.
+ *
+ * Group commit: the environment is set to DB_TXN_NOSYNC, so a commit only appends its
+ * record to the log buffer. The committer then waits for a log flush that covers it.
+ * The first waiter leads: it waits up to commit_delay for more committers (or until
+ * max_batch are waiting), flushes the log once for all of them, and wakes them. While
+ * one flush is running, the next batch gathers behind it. With commit_delay 0 a batch
+ * is whoever arrived during the previous flush; sync mode skips all this and syncs
+ * each commit itself.
+ *
+ * Methods:
+ * 	begin()
+ * 	commit()
+ * 	rollback()
+ * 	in_transaction()
+ * 	checkpoint()
+ * 	current()
+ * 	suspend()
+ * 	resume(txn)
+ * 	set_statement_lock(lock)
+ * Accessors for tuning group commit:
+ * 	get_commits()
+ * 	get_flushes()
+ */
+class TransactionManager {
+public:
+    /**
+     * Open flags a DbEnv needs, on top of DB_CREATE | DB_INIT_MPOOL | DB_THREAD, for
+     * this manager (DB_RECOVER replays the log after a crash).
+     */
+    static const u_int32_t ENV_FLAGS = DB_INIT_TXN | DB_INIT_LOG | DB_INIT_LOCK | DB_RECOVER;
+
+    /**
+     * @param env           environment opened with ENV_FLAGS
+     * @param commit_delay  how long a group commit's leader waits for company
+     * @param max_batch     number of waiting committers that ends the leader's wait early;
+     *                      0 to sync every commit on its own (no group commit)
+     */
+    TransactionManager(DbEnv &env, std::chrono::microseconds commit_delay = std::chrono::microseconds(0),
+                       uint max_batch = 64);
+
+    /**
+     * Checkpoints the environment.
+     */
+    virtual ~TransactionManager();
+
+    TransactionManager(const TransactionManager &other) = delete;
+
+    TransactionManager(TransactionManager &&temp) = delete;
+
+    TransactionManager &operator=(const TransactionManager &other) = delete;
+
+    TransactionManager &operator=(TransactionManager &&temp) = delete;
+
+    /**
+     * Start this thread's transaction.
+     * @throws  TransactionError if one is already open
+     */
+    virtual void begin();
+
+    /**
+     * Make this thread's transaction's changes durable, returning once they are.
+     * @throws  TransactionError if none is open; the transaction is rolled back if
+     *          its blocks can't be written
+     */
+    virtual void commit();
+
+    /**
+     * Undo this thread's transaction's changes.
+     * @throws  TransactionError if none is open
+     */
+    virtual void rollback();
+
+    virtual bool in_transaction() const { return current() != nullptr; }
+
+    /**
+     * Write Berkeley DB's cache out and mark the log, so recovery starts from here.
+     */
+    virtual void checkpoint();
+
+    /**
+     * @returns  this thread's open transaction, or nullptr
+     */
+    static DbTxn *current();
+
+    /**
+     * Detach this thread's open transaction, so another thread can resume it.
+     * @returns  the transaction, or nullptr if none was open
+     */
+    static DbTxn *suspend();
+
+    /**
+     * Make a suspended transaction this thread's open transaction.
+     * @param txn  from suspend() (nullptr is allowed and leaves none open)
+     * @throws     TransactionError if this thread already has one open
+     */
+    static void resume(DbTxn *txn);
+
+    /**
+     * Have begin, commit, and rollback hold lock while they change what statements see;
+     * commit lets go of it before waiting for the log, so commits still group.
+     * @param lock  the lock statements run under, or nullptr for none
+     */
+    virtual void set_statement_lock(std::mutex *lock) { statement_lock = lock; }
+
+    virtual u_int64_t get_commits() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return commits;
+    }
+
+    virtual u_int64_t get_flushes() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return flushes;
+    }
+
+protected:
+    DbEnv &env;
+    std::chrono::microseconds commit_delay;
+    uint max_batch;
+    std::mutex *statement_lock;
+
+    mutable std::mutex lock;
+    std::condition_variable joined;  // a committer has started waiting for the log
+    std::condition_variable flushed; // the log has been flushed through flushed_through
+    bool flushing;
+    u_int64_t commits;               // commits made so far; commit n is durable once flushed_through >= n
+    u_int64_t flushed_through;
+    u_int64_t flushes;
+
+    virtual std::unique_lock<std::mutex> lock_statements();
+
+    virtual void undo();
+
+    virtual void wait_for_log(u_int64_t ticket);
+};
+
+/**
+ * @class NoTransaction - detaches this thread's open transaction (if any) while in scope
+ *
+ * For scratch files (a join's partitions, a sort's runs): what is written to them
+ * isn't part of what the transaction changes, so it goes straight through.
+ */
+class NoTransaction {
+public:
+    NoTransaction() : txn(TransactionManager::suspend()) {}
+
+    virtual ~NoTransaction() { TransactionManager::resume(txn); }
+
+    NoTransaction(const NoTransaction &other) = delete;
+
+    NoTransaction(NoTransaction &&temp) = delete;
+
+    NoTransaction &operator=(const NoTransaction &other) = delete;
+
+    NoTransaction &operator=(NoTransaction &&temp) = delete;
+
+protected:
+    DbTxn *txn;
+};
+
+/**
+ * Global transaction manager, when the environment is transactional (set up alongside
+ * _DB_ENV); nullptr otherwise.
+ */
+extern TransactionManager *_TXN_MANAGER;
+
+bool test_transactions();
@@ -0,0 +1,361 @@
+// Authors: Dhruv Patel
+// Course: CPSC5300, Seattle University, WQ'24
+
+#include "vector_executor.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+// VECTOR SCAN code
+
+static ColumnNames names_of(HeapTable &table, const std::vector<uint> &columns) {
+  ColumnNames column_names;
+  for (auto const& column: columns)
+    column_names.push_back(table.get_column_names().at(column));
+  return column_names;
+}
+
+static ColumnAttributes attributes_of(HeapTable &table, const std::vector<uint> &columns) {
+  ColumnAttributes column_attributes;
+  for (auto const& column: columns)
+    column_attributes.push_back(table.get_column_attributes().at(column));
+  return column_attributes;
+}
+
+VectorScan::VectorScan(HeapTable &table, const std::vector<uint> &columns, const Comparisons &where)
+        : VectorOperator(names_of(table, columns), attributes_of(table, columns)), table(table), where(where),
+          decoder(table.decoder(columns)), filter(nullptr), block_id(1), last(0), batch_rows(ColumnBatch::CAPACITY)
+{}
+
+VectorScan::~VectorScan() {
+  close();
+  delete this->decoder;
+}
+
+void VectorScan::open() {
+  close();
+  this->last = this->table.get_num_blocks();
+  if (!this->where.empty())
+    this->filter = this->table.compile(this->where);
+  this->block_id = 1;
+}
+
+bool VectorScan::next(ColumnBatch &batch) {
+  batch.reset(this->column_attributes);
+  while (batch.size() < this->batch_rows && this->block_id <= this->last)
+    this->table.scan_block(this->block_id++, this->filter, *this->decoder, batch);
+  return !batch.empty();
+}
+
+void VectorScan::close() {
+  delete this->filter;
+  this->filter = nullptr;
+  this->block_id = this->last + 1;
+}
+
+void VectorScan::set_row_goal(u_int64_t rows) {
+  this->batch_rows = (uint) std::max<u_int64_t>(1, std::min<u_int64_t>(rows, ColumnBatch::CAPACITY));
+}
+
+
+// VECTOR FILTER code
+
+// Append to out the position of each selected row of batch that passes test.
+// Written without a branch so the loop compiles to straight-line code.
+template<typename Test>
+static void select_rows(const ColumnBatch &batch, Test test, std::vector<u_int32_t> &out) {
+  uint n = batch.num_selected();
+  out.resize(n);
+  u_int32_t *to = out.data();
+  uint kept = 0;
+  if (batch.is_selective()) {
+    const u_int32_t *selection = batch.get_selection().data();
+    for (uint i = 0; i < n; i++) {
+      u_int32_t row = selection[i];
+      to[kept] = row;
+      kept += test(row) ? 1 : 0;
+    }
+  } else {
+    for (uint i = 0; i < n; i++) {
+      to[kept] = i;
+      kept += test(i) ? 1 : 0;
+    }
+  }
+  out.resize(kept);
+}
+
+// select_rows for left(row) op right(row)
+template<typename Left, typename Right>
+static void select_compare(const ColumnBatch &batch, Comparison::Op op, Left left, Right right,
+                           std::vector<u_int32_t> &out) {
+  switch (op) {
+    case Comparison::EQ: select_rows(batch, [&](u_int32_t row) { return left(row) == right(row); }, out); break;
+    case Comparison::NE: select_rows(batch, [&](u_int32_t row) { return left(row) != right(row); }, out); break;
+    case Comparison::LT: select_rows(batch, [&](u_int32_t row) { return left(row) < right(row); }, out); break;
+    case Comparison::LE: select_rows(batch, [&](u_int32_t row) { return left(row) <= right(row); }, out); break;
+    case Comparison::GT: select_rows(batch, [&](u_int32_t row) { return left(row) > right(row); }, out); break;
+    case Comparison::GE: select_rows(batch, [&](u_int32_t row) { return left(row) >= right(row); }, out); break;
+  }
+}
+
+// memcmp order, shorter first on a tie (as Expression compares TEXT)
+static int compare_text(const RecordView &a, const char *b, u_int32_t b_size) {
+  int cmp = std::memcmp(a.data, b, std::min(a.size, b_size));
+  if (cmp == 0)
+    cmp = a.size < b_size ? -1 : (a.size > b_size ? 1 : 0);
+  return cmp;
+}
+
+VectorFilter::VectorFilter(VectorOperator *input, const VectorComparisons &terms)
+        : VectorOperator(input->get_column_names(), input->get_column_attributes()), input(input), terms(terms)
+{}
+
+bool VectorFilter::next(ColumnBatch &batch) {
+  while (this->input->next(batch)) {
+    for (auto const& term: this->terms) {
+      const ColumnVector &column = batch.column(term.column);
+      if (column.data_type == ColumnAttribute::INT) {
+        const int32_t *values = column.ints.data();
+        if (term.with_column) {
+          const int32_t *others = batch.column(term.other).ints.data();
+          select_compare(batch, term.op, [values](u_int32_t row) { return values[row]; },
+                         [others](u_int32_t row) { return others[row]; }, this->selection);
+        } else {
+          int32_t n = term.value.n;
+          select_compare(batch, term.op, [values](u_int32_t row) { return values[row]; },
+                         [n](u_int32_t) { return n; }, this->selection);
+        }
+      } else {
+        if (term.with_column) {
+          const ColumnVector &other = batch.column(term.other);
+          select_compare(batch, term.op, [&](u_int32_t row) {
+                           RecordView text = other.get_text(row);
+                           return compare_text(column.get_text(row), text.data, (u_int32_t) text.size);
+                         }, [](u_int32_t) { return 0; }, this->selection);
+        } else {
+          const std::string &s = term.value.s;
+          select_compare(batch, term.op, [&](u_int32_t row) {
+                           return compare_text(column.get_text(row), s.data(), (u_int32_t) s.size());
+                         }, [](u_int32_t) { return 0; }, this->selection);
+        }
+      }
+      batch.set_selection(this->selection);
+      if (batch.empty())
+        break;
+    }
+    if (!batch.empty())
+      return true;
+  }
+  return false;
+}
+
+
+// VECTOR PROJECT code
+
+static ColumnAttributes attributes_of(VectorOperator *input, const std::vector<uint> &columns) {
+  ColumnAttributes column_attributes;
+  for (auto const& column: columns)
+    column_attributes.push_back(input->get_column_attributes().at(column));
+  return column_attributes;
+}
+
+VectorProject::VectorProject(VectorOperator *input, const std::vector<uint> &columns, const ColumnNames &names)
+        : VectorOperator(names, attributes_of(input, columns)), input(input), columns(columns)
+{}
+
+bool VectorProject::next(ColumnBatch &batch) {
+  if (!this->input->next(this->input_rows)) {
+    batch.reset(this->column_attributes);
+    return false;
+  }
+  batch.take_columns(this->input_rows, this->columns);
+  return true;
+}
+
+
+// VECTOR AGGREGATE code
+
+static ColumnAttributes ints(size_t n) {
+  return ColumnAttributes(n, ColumnAttribute(ColumnAttribute::INT));
+}
+
+VectorAggregate::VectorAggregate(VectorOperator *input, const Aggregates &aggregates, const ColumnNames &names)
+        : VectorOperator(names, ints(aggregates.size())), input(input), aggregates(aggregates), done(false)
+{}
+
+void VectorAggregate::open() {
+  this->done = false;
+  this->input->open();
+}
+
+bool VectorAggregate::next(ColumnBatch &batch) {
+  batch.reset(this->column_attributes);
+  if (this->done)
+    return false;
+
+  size_t num_aggregates = this->aggregates.size();
+  std::vector<int64_t> sums(num_aggregates, 0);
+  std::vector<int32_t> mins(num_aggregates, INT_MAX);
+  std::vector<int32_t> maxes(num_aggregates, INT_MIN);
+  int64_t count = 0;
+  while (this->input->next(this->input_rows)) {
+    uint n = this->input_rows.num_selected();
+    count += n;
+    for (size_t a = 0; a < num_aggregates; a++) {
+      const Aggregate &aggregate = this->aggregates[a];
+      if (aggregate.function == COUNT)
+        continue;
+      const int32_t *values = this->input_rows.column((uint) aggregate.column).ints.data();
+      int64_t sum = 0;
+      int32_t lo = mins[a];
+      int32_t hi = maxes[a];
+      if (this->input_rows.is_selective()) {
+        const u_int32_t *selection = this->input_rows.get_selection().data();
+        for (uint i = 0; i < n; i++) {
+          int32_t value = values[selection[i]];
+          sum += value;
+          lo = std::min(lo, value);
+          hi = std::max(hi, value);
+        }
+      } else {
+        for (uint i = 0; i < n; i++) {
+          sum += values[i];
+          lo = std::min(lo, values[i]);
+          hi = std::max(hi, values[i]);
+        }
+      }
+      sums[a] += sum;
+      mins[a] = lo;
+      maxes[a] = hi;
+    }
+  }
+
+  for (size_t a = 0; a < num_aggregates; a++) {
+    int64_t result = 0;
+    if (count > 0) {
+      switch (this->aggregates[a].function) {
+        case COUNT: result = count; break;
+        case SUM: result = sums[a]; break;
+        case MIN: result = mins[a]; break;
+        case MAX: result = maxes[a]; break;
+        case AVG: result = sums[a] / count; break;
+      }
+    }
+    if (result < INT_MIN || result > INT_MAX)
+      throw DbRelationError(this->column_names[a] + " is out of range for an INT");
+    batch.column((uint) a).append_int((int32_t) result);
+  }
+  batch.add_rows(1);
+  this->done = true;
+  return true;
+}
+
+
+// VECTOR ROWS code
+
+VectorRows::VectorRows(VectorOperator *input)
+        : QueryOperator(input->get_column_names(), input->get_column_attributes()), input(input)
+{}
+
+bool VectorRows::next(RowBatch &batch) {
+  batch.clear();
+  if (!this->input->next(this->columns))
+    return false;
+  uint num_columns = this->columns.num_columns();
+  for (uint i = 0; i < this->columns.num_selected(); i++) {
+    uint position = this->columns.selected(i);
+    Row &row = batch.add();
+    row.resize(num_columns);
+    for (uint column = 0; column < num_columns; column++) {
+      const ColumnVector &vector = this->columns.column(column);
+      if (vector.data_type == ColumnAttribute::INT) {
+        row.set_int(column, vector.ints[position]);
+      } else {
+        RecordView text = vector.get_text(position);
+        row.set_text(column, text.data, text.size);
+      }
+    }
+  }
+  return true;
+}
+
+
+// test function -- returns true if all tests pass
+bool test_vector_executor() {
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                                          ColumnAttribute(ColumnAttribute::INT)};
+    HeapTable table("_test_vector_executor", column_names, column_attributes);
+    table.create();
+    ValueDicts rows;
+    for (int i = 0; i < 5000; i++) {
+        ValueDict row;
+        row["a"] = Value(i);
+        row["b"] = Value(i % 2 == 0 ? "even" : "odd");
+        row["c"] = Value(5000 - i);
+        rows.push_back(row);
+    }
+    delete table.insert_batch(&rows);
+
+    // every row of columns c and a, a batch at a time
+    bool ok = true;
+    ColumnBatch batch;
+    VectorScan scan(table, {2, 0});
+    uint count = 0;
+    scan.open();
+    while (scan.next(batch)) {
+        ok = ok && batch.size() > 0 && !batch.is_selective();
+        for (uint i = 0; i < batch.size(); i++)
+            ok = ok && batch.column(1).ints[i] == (int32_t) (count + i) &&
+                 batch.column(0).ints[i] == (int32_t) (5000 - count - i);
+        count += batch.size();
+    }
+    scan.close();
+    if (!ok || count != 5000)
+        return false;
+    std::cout << "vector scan ok" << std::endl;
+
+    // SELECT b, a FROM _test_vector_executor WHERE a >= 100 AND a < c AND b = 'odd'
+    VectorOperator *plan = new VectorScan(table, {0, 1, 2}, {Comparison("a", Comparison::GE, Value(100))});
+    plan = new VectorFilter(plan, {VectorComparison(0, Comparison::LT, 2U),
+                                   VectorComparison(1, Comparison::EQ, Value("odd"))});
+    plan = new VectorProject(plan, {1, 0}, {"b", "a"});
+    QueryOperator *rows_plan = new VectorRows(plan);
+    RowBatch row_batch;
+    std::vector<int32_t> found;
+    rows_plan->open();
+    while (rows_plan->next(row_batch)) {
+        for (uint i = 0; i < row_batch.size(); i++) {
+            ok = ok && row_batch[i].value(0).s == "odd";
+            found.push_back(row_batch[i][1].n);
+        }
+    }
+    rows_plan->close();
+    delete rows_plan;
+    // a from 100 to 2499, odd
+    for (uint i = 0; i < found.size(); i++)
+        ok = ok && found[i] == (int32_t) (101 + 2 * i);
+    if (!ok || found.size() != 1200)
+        return false;
+    std::cout << "vector filter, project ok" << std::endl;
+
+    // SELECT COUNT(*), SUM(a), MIN(c), MAX(a), AVG(a) FROM _test_vector_executor WHERE b = 'even'
+    plan = new VectorFilter(new VectorScan(table, {0, 1, 2}), {VectorComparison(1, Comparison::EQ, Value("even"))});
+    plan = new VectorAggregate(plan, {{VectorAggregate::COUNT, -1}, {VectorAggregate::SUM, 0},
+                                      {VectorAggregate::MIN, 2}, {VectorAggregate::MAX, 0},
+                                      {VectorAggregate::AVG, 0}},
+                               {"count", "sum", "min", "max", "avg"});
+    plan->open();
+    ok = plan->next(batch) && batch.num_selected() == 1 &&
+         batch.column(0).ints[0] == 2500 && batch.column(1).ints[0] == 2500 * 4998 / 2 &&
+         batch.column(2).ints[0] == 2 && batch.column(3).ints[0] == 4998 && batch.column(4).ints[0] == 2499 &&
+         !plan->next(batch);
+    plan->close();
+    delete plan;
+    if (!ok)
+        return false;
+    std::cout << "vector aggregate ok" << std::endl;
+    table.drop();
+    return true;
+}
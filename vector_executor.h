@@ -0,0 +1,279 @@
+/**
+ * @file vector_executor.h - Physical query operators over column vectors.
+ * VectorComparison
+ * VectorOperator
+ * VectorScan: VectorOperator
+ * VectorFilter: VectorOperator
+ * VectorProject: VectorOperator
+ * VectorAggregate: VectorOperator
+ * VectorRows: QueryOperator
+ *
+ * @author Kevin Lundeen, Dhruv Patel
+ * @see "Seattle University, CPSC5300, Winter Quarter 2024"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "column_batch.h"
+#include "executor.h"
+#include "heap_storage.h"
+#include "predicate.h"
+
+/**
+ * @class VectorComparison - one term of a VectorFilter
+ *
+ * A column compared with a constant of its type, or with another column of its type.
+ */
+class VectorComparison {
+public:
+    uint column;
+    Comparison::Op op;
+    bool with_column;   // compared with column other rather than value
+    uint other;
+    Value value;
+
+    VectorComparison(uint column, Comparison::Op op, const Value &value)
+            : column(column), op(op), with_column(false), other(0), value(value) {}
+
+    VectorComparison(uint column, Comparison::Op op, uint other)
+            : column(column), op(op), with_column(true), other(other) {}
+};
+typedef std::vector<VectorComparison> VectorComparisons;
+
+
+/**
+ * @class VectorOperator - one node of a vectorized query plan
+ *
+ * Like a QueryOperator, but rows move as ColumnBatches: each operator's inner loop
+ * runs down one column's array, with no per-row virtual calls or type dispatch.
+ * A filter narrows the batch's selection vector instead of moving values, so
+ * consumers must visit just the selected rows. An operator owns its inputs, and a
+ * batch it fills is only good until its next call to next().
+ *
+ * Methods:
+ * 	open()
+ * 	next(batch)
+ * 	close()
+ * Accessors:
+ * 	get_column_names()
+ * 	get_column_attributes()
+ */
+class VectorOperator {
+public:
+    VectorOperator(ColumnNames column_names, ColumnAttributes column_attributes)
+            : column_names(column_names), column_attributes(column_attributes) {}
+
+    virtual ~VectorOperator() {}
+
+    VectorOperator(const VectorOperator &other) = delete;
+
+    VectorOperator(VectorOperator &&temp) = delete;
+
+    VectorOperator &operator=(const VectorOperator &other) = delete;
+
+    VectorOperator &operator=(VectorOperator &&temp) = delete;
+
+    /**
+     * Get ready to produce rows (opening inputs).
+     */
+    virtual void open() = 0;
+
+    /**
+     * Produce the next rows.
+     * @param batch  emptied, then filled with at least one selected row
+     * @returns      false once there are no more rows
+     */
+    virtual bool next(ColumnBatch &batch) = 0;
+
+    /**
+     * Release whatever open() took (closing inputs). Safe to call early.
+     */
+    virtual void close() = 0;
+
+    /**
+     * The consumer will likely stop after about this many rows; size batches to match.
+     * Operators that must read all their input first ignore it.
+     */
+    virtual void set_row_goal(u_int64_t rows) {}
+
+    virtual const ColumnNames &get_column_names() const { return column_names; }
+
+    virtual const ColumnAttributes &get_column_attributes() const { return column_attributes; }
+
+protected:
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+};
+
+
+/**
+ * @class VectorScan - some columns of every row of a HeapTable that passes a where clause
+ *
+ * The where clause is applied to the records in place, as for TableScan; only
+ * the columns asked for are decoded, a column at a time. A batch is filled a
+ * block at a time up to about ColumnBatch::CAPACITY rows or the row goal,
+ * whichever is less.
+ */
+class VectorScan : public VectorOperator {
+public:
+    /**
+     * @param table    table to read (must outlive the scan)
+     * @param columns  ordinals of the columns to produce, in order
+     * @param where    terms that must all hold
+     */
+    VectorScan(HeapTable &table, const std::vector<uint> &columns, const Comparisons &where = Comparisons());
+
+    virtual ~VectorScan();
+
+    virtual void open();
+
+    virtual bool next(ColumnBatch &batch);
+
+    virtual void close();
+
+    virtual void set_row_goal(u_int64_t rows);
+
+protected:
+    HeapTable &table;
+    Comparisons where;
+    ColumnDecoder *decoder;
+    RowFilter *filter;
+    BlockID block_id;
+    BlockID last;
+    uint batch_rows;
+};
+
+/**
+ * @class VectorFilter - the input's rows for which every term holds
+ *
+ * Each term is one pass over its column(s) for the rows still selected,
+ * writing the survivors' positions to a new selection vector without branching.
+ */
+class VectorFilter : public VectorOperator {
+public:
+    /**
+     * @param input  rows to filter (owned)
+     * @param terms  over input's columns, each of matching types
+     */
+    VectorFilter(VectorOperator *input, const VectorComparisons &terms);
+
+    virtual ~VectorFilter() { delete input; }
+
+    virtual void open() { input->open(); }
+
+    virtual bool next(ColumnBatch &batch);
+
+    virtual void close() { input->close(); }
+
+    virtual void set_row_goal(u_int64_t rows) { input->set_row_goal(rows); }
+
+protected:
+    VectorOperator *input;
+    VectorComparisons terms;
+    std::vector<u_int32_t> selection;
+};
+
+/**
+ * @class VectorProject - some of the input's columns, renamed
+ *
+ * Column vectors are handed up as they are (swapped, not copied).
+ */
+class VectorProject : public VectorOperator {
+public:
+    /**
+     * @param input    rows to project (owned)
+     * @param columns  ordinals of input's columns to keep, in order
+     * @param names    one per column kept
+     */
+    VectorProject(VectorOperator *input, const std::vector<uint> &columns, const ColumnNames &names);
+
+    virtual ~VectorProject() { delete input; }
+
+    virtual void open() { input->open(); }
+
+    virtual bool next(ColumnBatch &batch);
+
+    virtual void close() { input->close(); }
+
+    virtual void set_row_goal(u_int64_t rows) { input->set_row_goal(rows); }
+
+protected:
+    VectorOperator *input;
+    std::vector<uint> columns;
+    ColumnBatch input_rows;
+};
+
+/**
+ * @class VectorAggregate - COUNT, SUM, MIN, MAX, and AVG over all the input's rows
+ *
+ * Produces one row of INTs. Each aggregate is one loop over its column per batch,
+ * summing into 64 bits. AVG is the SUM divided by the COUNT (an INT, truncated).
+ * Over no rows every aggregate gives 0, as there are no NULLs yet.
+ */
+class VectorAggregate : public VectorOperator {
+public:
+    enum Function {
+        COUNT, SUM, MIN, MAX, AVG
+    };
+
+    // One aggregate: COUNT(*) has column -1; the others need an INT column.
+    struct Aggregate {
+        Function function;
+        int column;
+    };
+    typedef std::vector<Aggregate> Aggregates;
+
+    /**
+     * @param input       rows to aggregate (owned)
+     * @param aggregates  over input's columns
+     * @param names       one per aggregate
+     */
+    VectorAggregate(VectorOperator *input, const Aggregates &aggregates, const ColumnNames &names);
+
+    virtual ~VectorAggregate() { delete input; }
+
+    virtual void open();
+
+    /**
+     * @throws  DbRelationError if a result doesn't fit in an INT
+     */
+    virtual bool next(ColumnBatch &batch);
+
+    virtual void close() { input->close(); }
+
+protected:
+    VectorOperator *input;
+    Aggregates aggregates;
+    ColumnBatch input_rows;
+    bool done;
+};
+
+/**
+ * @class VectorRows - a vectorized plan's rows as a QueryOperator, for row-at-a-time consumers
+ *
+ * TEXT in the rows points into the input's column vectors.
+ */
+class VectorRows : public QueryOperator {
+public:
+    /**
+     * @param input  the vectorized plan (owned)
+     */
+    VectorRows(VectorOperator *input);
+
+    virtual ~VectorRows() { delete input; }
+
+    virtual void open() { input->open(); }
+
+    virtual bool next(RowBatch &batch);
+
+    virtual void close() { input->close(); }
+
+    virtual void set_row_goal(u_int64_t rows) { input->set_row_goal(rows); }
+
+protected:
+    VectorOperator *input;
+    ColumnBatch columns;
+};
+
+bool test_vector_executor();